@@ -1,6 +1,7 @@
 #pragma once
 
 #include "SubstanceInstanceFactory.h"
+#include "SubstanceTexture2D.h"
 #include "SubstanceSettings.generated.h"
 
 #if ANDROID || IPHONE
@@ -27,9 +28,63 @@ class SUBSTANCECORE_API USubstanceSettings : public UObject
 	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "1", ClampMax = "12"))
 	int32 CPUCores;
 
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "1", ClampMax = "16", DisplayName = "Renderers sharing the memory budget and cores."))
+	int32 RendererShardCount;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (DisplayName = "Keep the instances of a package on the same renderer to share its link data."))
+	bool bShardRenderingByPackage;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "10", ClampMax = "5000", DisplayName = "Estimated render time of a runtime batch of instances (ms)."))
+	int32 RuntimeBatchTargetMs;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "0", ClampMax = "100", DisplayName = "Time spent uploading rendered outputs per frame (ms)."))
+	int32 OutputDeliveryBudgetMs;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "1", ClampMax = "1024", DisplayName = "Rendered outputs uploaded per frame (MB)."))
+	int32 OutputDeliveryBudgetMb;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "0", ClampMax = "4096", DisplayName = "Rendered outputs waiting for upload before rendering is held, 0 for no limit (MB)."))
+	int32 OutputBacklogBudgetMb;
+
 	UPROPERTY(EditAnywhere, Config, Category = "Cooking", meta = (ClampMin = "1", ClampMax = "5", DisplayName = "Mip levels count removed during cooking."))
 	int32 AsyncLoadMipClip;
 
 	UPROPERTY(EditAnywhere, Config, Category = "Cooking", meta = (DisplayName = "Default generation mode for Substances."))
 	TEnumAsByte<ESubstanceGenerationMode> DefaultGenerationMode;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Output Compression", meta = (DisplayName = "Block compression of the uncompressed outputs, unless set by the texture."))
+	TEnumAsByte<ESubstanceOutputCompression> DefaultOutputCompression;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (DisplayName = "Read cached outputs through memory-mapped files."))
+	bool bMemoryMappedCacheReads;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (ClampMin = "1", ClampMax = "2048", DisplayName = "Memory held by cache reads waiting for upload (Mb)."))
+	int32 AsyncCacheReadBudgetMb;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (DisplayName = "Store cached outputs in pack files instead of one file per output."))
+	bool bPackedCache;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (DisplayName = "Compress cached outputs, trading CPU time for disk bandwidth."))
+	bool bCompressedCache;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (DisplayName = "Show the small mips of cached outputs first, then stream in the larger ones."))
+	bool bProgressiveCacheReads;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (ClampMin = "1", ClampMax = "4096", DisplayName = "Largest mip shown first by progressive cache reads."))
+	int32 ProgressiveCacheTailSize;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (ClampMin = "1", ClampMax = "1024", DisplayName = "Cached outputs streamed in per frame by progressive cache reads (Mb)."))
+	int32 ProgressiveCacheFrameBudgetMb;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (ClampMin = "0", ClampMax = "4096", DisplayName = "Memory keeping recent outputs for recreated instances (Mb), 0 disables it."))
+	int32 MemoryCacheBudgetMb;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (ClampMin = "64", DisplayName = "Disk space used by cached outputs (Mb), least recently used outputs are removed first."))
+	int32 CacheBudgetMb;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (ClampMin = "0", ClampMax = "1024", DisplayName = "Memory keeping linked graphs for the next renderers (Mb), 0 disables it."))
+	int32 LinkerCacheBudgetMb;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (DisplayName = "Save linked graphs on disk to skip linking at next launch."))
+	bool bLinkerCacheOnDisk;
 };
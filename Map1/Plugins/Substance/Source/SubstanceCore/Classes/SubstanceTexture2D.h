@@ -5,6 +5,17 @@
 #include "SubstanceCoreTypedefs.h"
 #include "SubstanceTexture2D.generated.h"
 
+UENUM(BlueprintType)
+enum ESubstanceOutputCompression
+{
+	SOC_Default =0,
+	SOC_None    =1,
+	SOC_Fast    =2,
+	SOC_High    =3,
+
+	SOC_MAX     =4
+};
+
 UCLASS(hideCategories=Object, MinimalAPI)
 class USubstanceTexture2D : public UTexture2DDynamic
 {
@@ -25,8 +36,24 @@ class USubstanceTexture2D : public UTexture2DDynamic
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Texture, meta = (DisplayName = "Y-axis Tiling Method"), AssetRegistrySearchable, AdvancedDisplay)
 	TEnumAsByte<enum TextureAddress> AddressY;
 
+	/** Block compression of the uncompressed results on the CPU, default uses the project setting. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Substance", AdvancedDisplay)
+	TEnumAsByte<enum ESubstanceOutputCompression> OutputCompression;
+
+	/** Format of the results before their compression, PF_Unknown when they were not compressed. */
+	EPixelFormat EncodedFromFormat;
+
 	TIndirectArray<struct FTexture2DMipMap> Mips;
 
+	/** Mip storage adopted from the last render result, the mips bulk data are empty when set. */
+	TSharedPtr<struct FSubstanceMipBuffer, ESPMode::ThreadSafe> MipBuffer;
+
+	/** Fence on the upload of the mips bulk data, waited for before changing the mips. */
+	FRenderCommandFence MipsFence;
+
+	/** Upload the mip buffer without recreating the resource, nor waiting for the rendering thread. */
+	void UpdateMips();
+
 	// Begin UObject interface.
 	virtual void Serialize( FArchive& Ar ) override;
 	virtual void BeginDestroy() override;
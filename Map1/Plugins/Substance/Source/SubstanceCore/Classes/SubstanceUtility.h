@@ -48,4 +48,20 @@ class USubstanceUtility : public UBlueprintFunctionLibrary
 	/* Start the synchronous rendering of a Substance */
 	UFUNCTION(BlueprintCallable, Category="Substance|Render")
 	static void SyncRendering(USubstanceGraphInstance* InstancesToRender);
+
+	/* Cancel the rendering of a Substance Graph Instance, the other instances keep rendering. Textures computed but not uploaded yet are dropped */
+	UFUNCTION(BlueprintCallable, Category = "Substance|Render")
+	static void CancelRendering(USubstanceGraphInstance* GraphInstance);
+
+	/* Cancel the rendering of one texture of a Substance Graph Instance, rendered again with its instance. A result computed but not uploaded yet is dropped */
+	UFUNCTION(BlueprintCallable, Category = "Substance|Render")
+	static void CancelTextureRendering(class USubstanceTexture2D* Texture);
+
+	/* Get the rendering progress of a Substance Graph Instance's textures ([0, 1.0]) */
+	UFUNCTION(BlueprintCallable, Category = "Substance|Render")
+	static float GetRenderingProgress(USubstanceGraphInstance* GraphInstance);
+
+	/* Get the rendering progress of a texture of a Substance Graph Instance ([0, 1.0]) */
+	UFUNCTION(BlueprintCallable, Category = "Substance|Render")
+	static float GetTextureRenderingProgress(class USubstanceTexture2D* Texture);
 };
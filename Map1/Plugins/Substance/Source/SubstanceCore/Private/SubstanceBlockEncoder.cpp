@@ -0,0 +1,834 @@
+//! @file SubstanceBlockEncoder.cpp
+//! @brief Implementation of the BC1, BC3, BC4 and BC5 encoders
+//! @copyright Allegorithmic. All rights reserved.
+
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceBlockEncoder.h"
+#include "SubstanceCoreHelpers.h"
+
+// x86 CPUs running the engine support SSE2
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SUBSTANCE_ENCODER_SSE2 1
+#include <emmintrin.h>
+#else
+#define SUBSTANCE_ENCODER_SSE2 0
+#endif
+
+DEFINE_LOG_CATEGORY_STATIC(LogSubstanceEncoder, Log, All);
+
+namespace Substance
+{
+namespace BlockEncoder
+{
+
+//! @brief Weight of the first endpoint for each index of a color block
+static const float ColorWeights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+//! @brief Weight of the first endpoint for each index of an 8 values block
+static const float ValueWeights[8] = { 1.0f, 0.0f, 6.0f / 7.0f, 5.0f / 7.0f, 4.0f / 7.0f, 3.0f / 7.0f, 2.0f / 7.0f, 1.0f / 7.0f };
+
+
+//! @brief Gather the rgba8 pixels of a block, repeating the last row and column
+static void LoadColorBlock(const uint8* Src, uint32 SizeX, uint32 SizeY, uint32 BlockX, uint32 BlockY, uint8 (&Pixels)[16][4])
+{
+	for (uint32 Y = 0; Y < 4; ++Y)
+	{
+		const uint32 SrcY = FMath::Min(BlockY * 4 + Y, SizeY - 1);
+
+		if (BlockX * 4 + 4 <= SizeX)
+		{
+			FMemory::Memcpy(Pixels[Y * 4], Src + (SrcY * SizeX + BlockX * 4) * 4, 16);
+			continue;
+		}
+
+		for (uint32 X = 0; X < 4; ++X)
+		{
+			const uint32 SrcX = FMath::Min(BlockX * 4 + X, SizeX - 1);
+			FMemory::Memcpy(Pixels[Y * 4 + X], Src + (SrcY * SizeX + SrcX) * 4, 4);
+		}
+	}
+}
+
+
+//! @brief Gather the 8 bits pixels of a block, repeating the last row and column
+static void LoadValueBlock(const uint8* Src, uint32 SizeX, uint32 SizeY, uint32 BlockX, uint32 BlockY, uint8 (&Values)[16])
+{
+	for (uint32 Y = 0; Y < 4; ++Y)
+	{
+		const uint32 SrcY = FMath::Min(BlockY * 4 + Y, SizeY - 1);
+
+		for (uint32 X = 0; X < 4; ++X)
+		{
+			Values[Y * 4 + X] = Src[SrcY * SizeX + FMath::Min(BlockX * 4 + X, SizeX - 1)];
+		}
+	}
+}
+
+
+//! @brief Minimum and maximum of each channel of the pixels of a block
+static void GetColorBounds(const uint8 (&Pixels)[16][4], uint8 (&Min)[4], uint8 (&Max)[4])
+{
+#if SUBSTANCE_ENCODER_SSE2
+	const __m128i* Rows = (const __m128i*)Pixels;
+
+	__m128i Lo = _mm_loadu_si128(Rows);
+	__m128i Hi = Lo;
+
+	for (int32 Row = 1; Row < 4; ++Row)
+	{
+		const __m128i Four = _mm_loadu_si128(Rows + Row);
+		Lo = _mm_min_epu8(Lo, Four);
+		Hi = _mm_max_epu8(Hi, Four);
+	}
+
+	// fold the 4 pixels of the registers
+	Lo = _mm_min_epu8(Lo, _mm_srli_si128(Lo, 8));
+	Lo = _mm_min_epu8(Lo, _mm_srli_si128(Lo, 4));
+	Hi = _mm_max_epu8(Hi, _mm_srli_si128(Hi, 8));
+	Hi = _mm_max_epu8(Hi, _mm_srli_si128(Hi, 4));
+
+	const int32 LoPixel = _mm_cvtsi128_si32(Lo);
+	const int32 HiPixel = _mm_cvtsi128_si32(Hi);
+	FMemory::Memcpy(Min, &LoPixel, 4);
+	FMemory::Memcpy(Max, &HiPixel, 4);
+#else
+	FMemory::Memcpy(Min, Pixels[0], 4);
+	FMemory::Memcpy(Max, Pixels[0], 4);
+
+	for (int32 Idx = 1; Idx < 16; ++Idx)
+	{
+		for (int32 Channel = 0; Channel < 4; ++Channel)
+		{
+			Min[Channel] = FMath::Min(Min[Channel], Pixels[Idx][Channel]);
+			Max[Channel] = FMath::Max(Max[Channel], Pixels[Idx][Channel]);
+		}
+	}
+#endif
+}
+
+
+//! @brief Minimum and maximum of the values of a block
+static void GetValueBounds(const uint8 (&Values)[16], uint8& Min, uint8& Max)
+{
+#if SUBSTANCE_ENCODER_SSE2
+	__m128i Lo = _mm_loadu_si128((const __m128i*)Values);
+	__m128i Hi = Lo;
+
+	// fold the 16 values of the registers
+	Lo = _mm_min_epu8(Lo, _mm_srli_si128(Lo, 8));
+	Lo = _mm_min_epu8(Lo, _mm_srli_si128(Lo, 4));
+	Lo = _mm_min_epu8(Lo, _mm_srli_si128(Lo, 2));
+	Lo = _mm_min_epu8(Lo, _mm_srli_si128(Lo, 1));
+	Hi = _mm_max_epu8(Hi, _mm_srli_si128(Hi, 8));
+	Hi = _mm_max_epu8(Hi, _mm_srli_si128(Hi, 4));
+	Hi = _mm_max_epu8(Hi, _mm_srli_si128(Hi, 2));
+	Hi = _mm_max_epu8(Hi, _mm_srli_si128(Hi, 1));
+
+	Min = (uint8)_mm_cvtsi128_si32(Lo);
+	Max = (uint8)_mm_cvtsi128_si32(Hi);
+#else
+	Min = Max = Values[0];
+
+	for (int32 Idx = 1; Idx < 16; ++Idx)
+	{
+		Min = FMath::Min(Min, Values[Idx]);
+		Max = FMath::Max(Max, Values[Idx]);
+	}
+#endif
+}
+
+
+static uint16 PackColor(const int32 (&Color)[3])
+{
+	return (uint16)(
+		((Color[0] * 31 + 127) / 255) << 11 |
+		((Color[1] * 63 + 127) / 255) << 5 |
+		((Color[2] * 31 + 127) / 255));
+}
+
+
+static void UnpackColor(uint16 Packed, int32 (&Color)[3])
+{
+	const int32 Red = Packed >> 11;
+	const int32 Green = (Packed >> 5) & 63;
+	const int32 Blue = Packed & 31;
+
+	Color[0] = (Red << 3) | (Red >> 2);
+	Color[1] = (Green << 2) | (Green >> 4);
+	Color[2] = (Blue << 3) | (Blue >> 2);
+}
+
+
+//! @brief Colors of a 4 colors block
+static void GetColorPalette(uint16 Color0, uint16 Color1, int32 (&Palette)[4][3])
+{
+	UnpackColor(Color0, Palette[0]);
+	UnpackColor(Color1, Palette[1]);
+
+	for (int32 Channel = 0; Channel < 3; ++Channel)
+	{
+		Palette[2][Channel] = (2 * Palette[0][Channel] + Palette[1][Channel] + 1) / 3;
+		Palette[3][Channel] = (Palette[0][Channel] + 2 * Palette[1][Channel] + 1) / 3;
+	}
+}
+
+
+//! @brief Quantize the endpoints and pick the closest color of each pixel
+//! @return Return the squared error of the block
+static int32 FitColorBlock(const uint8 (&Pixels)[16][4], const int32 (&End0)[3], const int32 (&End1)[3], uint16& Color0, uint16& Color1, uint32& Indices)
+{
+	Color0 = PackColor(End0);
+	Color1 = PackColor(End1);
+
+	// the first color is the largest in 4 colors blocks
+	if (Color0 < Color1)
+	{
+		Swap(Color0, Color1);
+	}
+
+	int32 Palette[4][3];
+	GetColorPalette(Color0, Color1, Palette);
+
+	// equal colors decode as a 3 colors block, whose first color is the same
+	const int32 PaletteCount = Color0 == Color1 ? 1 : 4;
+
+	int32 Error = 0;
+	Indices = 0;
+
+	for (int32 Idx = 0; Idx < 16; ++Idx)
+	{
+		int32 Best = 0;
+		int32 BestDistance = MAX_int32;
+
+		for (int32 Entry = 0; Entry < PaletteCount; ++Entry)
+		{
+			const int32 Red = Pixels[Idx][0] - Palette[Entry][0];
+			const int32 Green = Pixels[Idx][1] - Palette[Entry][1];
+			const int32 Blue = Pixels[Idx][2] - Palette[Entry][2];
+			const int32 Distance = Red * Red + Green * Green + Blue * Blue;
+
+			if (Distance < BestDistance)
+			{
+				Best = Entry;
+				BestDistance = Distance;
+			}
+		}
+
+		Indices |= (uint32)Best << (Idx * 2);
+		Error += BestDistance;
+	}
+
+	return Error;
+}
+
+
+//! @brief Endpoints at the extremes of the principal axis of the colors
+//! @return Return false if the colors have no principal axis
+static bool GetPrincipalEndpoints(const uint8 (&Pixels)[16][4], const uint8 (&Min)[4], const uint8 (&Max)[4], int32 (&End0)[3], int32 (&End1)[3])
+{
+	float Mean[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (int32 Idx = 0; Idx < 16; ++Idx)
+	{
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			Mean[Channel] += Pixels[Idx][Channel] / 16.0f;
+		}
+	}
+
+	// covariance: rr, rg, rb, gg, gb, bb
+	float Covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+	for (int32 Idx = 0; Idx < 16; ++Idx)
+	{
+		const float Red = Pixels[Idx][0] - Mean[0];
+		const float Green = Pixels[Idx][1] - Mean[1];
+		const float Blue = Pixels[Idx][2] - Mean[2];
+
+		Covariance[0] += Red * Red;
+		Covariance[1] += Red * Green;
+		Covariance[2] += Red * Blue;
+		Covariance[3] += Green * Green;
+		Covariance[4] += Green * Blue;
+		Covariance[5] += Blue * Blue;
+	}
+
+	// power iterations from the bounding box diagonal
+	float Axis[3] = { (float)(Max[0] - Min[0]), (float)(Max[1] - Min[1]), (float)(Max[2] - Min[2]) };
+
+	for (int32 Iteration = 0; Iteration < 8; ++Iteration)
+	{
+		const float Next[3] =
+		{
+			Axis[0] * Covariance[0] + Axis[1] * Covariance[1] + Axis[2] * Covariance[2],
+			Axis[0] * Covariance[1] + Axis[1] * Covariance[3] + Axis[2] * Covariance[4],
+			Axis[0] * Covariance[2] + Axis[1] * Covariance[4] + Axis[2] * Covariance[5]
+		};
+
+		const float Scale = FMath::Max3(FMath::Abs(Next[0]), FMath::Abs(Next[1]), FMath::Abs(Next[2]));
+
+		if (Scale < KINDA_SMALL_NUMBER)
+		{
+			return false;
+		}
+
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			Axis[Channel] = Next[Channel] / Scale;
+		}
+	}
+
+	const float Length = FMath::Sqrt(Axis[0] * Axis[0] + Axis[1] * Axis[1] + Axis[2] * Axis[2]);
+
+	float MinProjection = MAX_flt;
+	float MaxProjection = -MAX_flt;
+
+	for (int32 Idx = 0; Idx < 16; ++Idx)
+	{
+		const float Projection =
+			((Pixels[Idx][0] - Mean[0]) * Axis[0] +
+			(Pixels[Idx][1] - Mean[1]) * Axis[1] +
+			(Pixels[Idx][2] - Mean[2]) * Axis[2]) / Length;
+
+		MinProjection = FMath::Min(MinProjection, Projection);
+		MaxProjection = FMath::Max(MaxProjection, Projection);
+	}
+
+	for (int32 Channel = 0; Channel < 3; ++Channel)
+	{
+		End0[Channel] = FMath::Clamp(FMath::RoundToInt(Mean[Channel] + MaxProjection * Axis[Channel] / Length), 0, 255);
+		End1[Channel] = FMath::Clamp(FMath::RoundToInt(Mean[Channel] + MinProjection * Axis[Channel] / Length), 0, 255);
+	}
+
+	return true;
+}
+
+
+//! @brief Least squares endpoints of the colors for the given indices
+//! @return Return false if the indices do not constrain both endpoints
+static bool RefineColorEndpoints(const uint8 (&Pixels)[16][4], uint32 Indices, int32 (&End0)[3], int32 (&End1)[3])
+{
+	float AA = 0.0f;
+	float AB = 0.0f;
+	float BB = 0.0f;
+	float AX[3] = { 0.0f, 0.0f, 0.0f };
+	float BX[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (int32 Idx = 0; Idx < 16; ++Idx)
+	{
+		const float A = ColorWeights[(Indices >> (Idx * 2)) & 3];
+		const float B = 1.0f - A;
+
+		AA += A * A;
+		AB += A * B;
+		BB += B * B;
+
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			AX[Channel] += A * Pixels[Idx][Channel];
+			BX[Channel] += B * Pixels[Idx][Channel];
+		}
+	}
+
+	const float Determinant = AA * BB - AB * AB;
+
+	if (FMath::Abs(Determinant) < KINDA_SMALL_NUMBER)
+	{
+		return false;
+	}
+
+	for (int32 Channel = 0; Channel < 3; ++Channel)
+	{
+		End0[Channel] = FMath::Clamp(FMath::RoundToInt((BB * AX[Channel] - AB * BX[Channel]) / Determinant), 0, 255);
+		End1[Channel] = FMath::Clamp(FMath::RoundToInt((AA * BX[Channel] - AB * AX[Channel]) / Determinant), 0, 255);
+	}
+
+	return true;
+}
+
+
+//! @brief Encode the rgb of a block as a 4 colors BC1 block
+static void EncodeColorBlock(const uint8 (&Pixels)[16][4], bool bHighQuality, uint8* Block)
+{
+	uint8 Min[4];
+	uint8 Max[4];
+	GetColorBounds(Pixels, Min, Max);
+
+	int32 End0[3];
+	int32 End1[3];
+
+	if (!bHighQuality || !GetPrincipalEndpoints(Pixels, Min, Max, End0, End1))
+	{
+		// bounding box, inset by a 16th to reduce the error at its corners
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			const int32 Inset = (Max[Channel] - Min[Channel]) >> 4;
+			End0[Channel] = Max[Channel] - Inset;
+			End1[Channel] = Min[Channel] + Inset;
+		}
+	}
+
+	uint16 Color0;
+	uint16 Color1;
+	uint32 Indices;
+	int32 Error = FitColorBlock(Pixels, End0, End1, Color0, Color1, Indices);
+
+	if (bHighQuality && Error > 0 && RefineColorEndpoints(Pixels, Indices, End0, End1))
+	{
+		uint16 RefinedColor0;
+		uint16 RefinedColor1;
+		uint32 RefinedIndices;
+
+		if (FitColorBlock(Pixels, End0, End1, RefinedColor0, RefinedColor1, RefinedIndices) < Error)
+		{
+			Color0 = RefinedColor0;
+			Color1 = RefinedColor1;
+			Indices = RefinedIndices;
+		}
+	}
+
+	Block[0] = Color0 & 0xff;
+	Block[1] = Color0 >> 8;
+	Block[2] = Color1 & 0xff;
+	Block[3] = Color1 >> 8;
+	Block[4] = Indices & 0xff;
+	Block[5] = (Indices >> 8) & 0xff;
+	Block[6] = (Indices >> 16) & 0xff;
+	Block[7] = Indices >> 24;
+}
+
+
+//! @brief Values of a BC4 block, 8 interpolated if Value0 > Value1,
+//! 6 interpolated plus 0 and 255 otherwise
+static void GetValuePalette(int32 Value0, int32 Value1, int32 (&Palette)[8])
+{
+	Palette[0] = Value0;
+	Palette[1] = Value1;
+
+	if (Value0 > Value1)
+	{
+		for (int32 Step = 1; Step < 7; ++Step)
+		{
+			Palette[Step + 1] = ((7 - Step) * Value0 + Step * Value1 + 3) / 7;
+		}
+	}
+	else
+	{
+		for (int32 Step = 1; Step < 5; ++Step)
+		{
+			Palette[Step + 1] = ((5 - Step) * Value0 + Step * Value1 + 2) / 5;
+		}
+
+		Palette[6] = 0;
+		Palette[7] = 255;
+	}
+}
+
+
+//! @brief Pick the closest value of each pixel
+//! @return Return the squared error of the block
+static int32 FitValueBlock(const uint8 (&Values)[16], int32 Value0, int32 Value1, uint64& Indices)
+{
+	int32 Palette[8];
+	GetValuePalette(Value0, Value1, Palette);
+
+	int32 Error = 0;
+	Indices = 0;
+
+	for (int32 Idx = 0; Idx < 16; ++Idx)
+	{
+		int32 Best = 0;
+		int32 BestDistance = MAX_int32;
+
+		for (int32 Entry = 0; Entry < 8; ++Entry)
+		{
+			const int32 Distance = FMath::Abs(Values[Idx] - Palette[Entry]);
+
+			if (Distance < BestDistance)
+			{
+				Best = Entry;
+				BestDistance = Distance;
+			}
+		}
+
+		Indices |= (uint64)Best << (Idx * 3);
+		Error += BestDistance * BestDistance;
+	}
+
+	return Error;
+}
+
+
+//! @brief Encode 8 bits values as a BC4 block, the alpha block of BC3
+static void EncodeValueBlock(const uint8 (&Values)[16], bool bHighQuality, uint8* Block)
+{
+	uint8 Min;
+	uint8 Max;
+	GetValueBounds(Values, Min, Max);
+
+	int32 Value0 = Max;
+	int32 Value1 = Min;
+	uint64 Indices = 0;
+	int32 Error = Min == Max ? 0 : FitValueBlock(Values, Value0, Value1, Indices);
+
+	if (bHighQuality && Error > 0)
+	{
+		// least squares endpoints of the 8 values block
+		float AA = 0.0f;
+		float AB = 0.0f;
+		float BB = 0.0f;
+		float AX = 0.0f;
+		float BX = 0.0f;
+
+		for (int32 Idx = 0; Idx < 16; ++Idx)
+		{
+			const float A = ValueWeights[(Indices >> (Idx * 3)) & 7];
+			const float B = 1.0f - A;
+
+			AA += A * A;
+			AB += A * B;
+			BB += B * B;
+			AX += A * Values[Idx];
+			BX += B * Values[Idx];
+		}
+
+		const float Determinant = AA * BB - AB * AB;
+
+		if (FMath::Abs(Determinant) > KINDA_SMALL_NUMBER)
+		{
+			const int32 Refined0 = FMath::Clamp(FMath::RoundToInt((BB * AX - AB * BX) / Determinant), 0, 255);
+			const int32 Refined1 = FMath::Clamp(FMath::RoundToInt((AA * BX - AB * AX) / Determinant), 0, 255);
+
+			uint64 RefinedIndices;
+			const int32 RefinedError = Refined0 > Refined1 ? FitValueBlock(Values, Refined0, Refined1, RefinedIndices) : MAX_int32;
+
+			if (RefinedError < Error)
+			{
+				Value0 = Refined0;
+				Value1 = Refined1;
+				Indices = RefinedIndices;
+				Error = RefinedError;
+			}
+		}
+
+		// 6 values between the extremes of the other values, plus 0 and 255
+		int32 InnerMin = 255;
+		int32 InnerMax = 0;
+
+		for (int32 Idx = 0; Idx < 16; ++Idx)
+		{
+			if (Values[Idx] != 0 && Values[Idx] != 255)
+			{
+				InnerMin = FMath::Min<int32>(InnerMin, Values[Idx]);
+				InnerMax = FMath::Max<int32>(InnerMax, Values[Idx]);
+			}
+		}
+
+		if (InnerMin <= InnerMax)
+		{
+			uint64 InnerIndices;
+			const int32 InnerError = FitValueBlock(Values, InnerMin, InnerMax, InnerIndices);
+
+			if (InnerError < Error)
+			{
+				Value0 = InnerMin;
+				Value1 = InnerMax;
+				Indices = InnerIndices;
+			}
+		}
+	}
+
+	Block[0] = (uint8)Value0;
+	Block[1] = (uint8)Value1;
+
+	for (int32 Byte = 0; Byte < 6; ++Byte)
+	{
+		Block[2 + Byte] = (uint8)(Indices >> (Byte * 8));
+	}
+}
+
+
+//! @brief Encode a row of blocks
+static void EncodeBlockRow(const uint8* Src, uint32 SizeX, uint32 SizeY, EBlockFormat Format, bool bHighQuality, uint32 BlockY, uint8* Dest)
+{
+	const uint32 BlocksX = (SizeX + 3) / 4;
+
+	uint8 Pixels[16][4];
+	uint8 Values[16];
+
+	for (uint32 BlockX = 0; BlockX < BlocksX; ++BlockX)
+	{
+		if (Format == BF_BC4)
+		{
+			LoadValueBlock(Src, SizeX, SizeY, BlockX, BlockY, Values);
+			EncodeValueBlock(Values, bHighQuality, Dest);
+			Dest += 8;
+			continue;
+		}
+
+		LoadColorBlock(Src, SizeX, SizeY, BlockX, BlockY, Pixels);
+
+		switch (Format)
+		{
+		case BF_BC1:
+			EncodeColorBlock(Pixels, bHighQuality, Dest);
+			Dest += 8;
+			break;
+
+		case BF_BC3:
+			for (int32 Idx = 0; Idx < 16; ++Idx)
+			{
+				Values[Idx] = Pixels[Idx][3];
+			}
+			EncodeValueBlock(Values, bHighQuality, Dest);
+			EncodeColorBlock(Pixels, bHighQuality, Dest + 8);
+			Dest += 16;
+			break;
+
+		case BF_BC5:
+			for (int32 Channel = 0; Channel < 2; ++Channel)
+			{
+				for (int32 Idx = 0; Idx < 16; ++Idx)
+				{
+					Values[Idx] = Pixels[Idx][Channel];
+				}
+				EncodeValueBlock(Values, bHighQuality, Dest);
+				Dest += 8;
+			}
+			break;
+
+		default:
+			check(0);
+			break;
+		}
+	}
+}
+
+
+uint32 GetBlockBytes(EBlockFormat Format)
+{
+	return Format == BF_BC1 || Format == BF_BC4 ? 8 : 16;
+}
+
+
+uint32 GetSourcePixelBytes(EBlockFormat Format)
+{
+	return Format == BF_BC4 ? 1 : 4;
+}
+
+
+void EncodeImage(const uint8* Src, uint32 SizeX, uint32 SizeY, EBlockFormat Format, bool bHighQuality, uint8* Dest, bool bParallel)
+{
+	const uint32 BlocksX = (SizeX + 3) / 4;
+	const uint32 BlocksY = (SizeY + 3) / 4;
+	const uint32 BlockRowBytes = BlocksX * GetBlockBytes(Format);
+
+	auto EncodeRows = [=](int32 FirstRow, int32 RowCount)
+	{
+		for (int32 BlockY = FirstRow; BlockY < FirstRow + RowCount; ++BlockY)
+		{
+			EncodeBlockRow(Src, SizeX, SizeY, Format, bHighQuality, BlockY, Dest + BlockY * BlockRowBytes);
+		}
+	};
+
+	if (!bParallel)
+	{
+		EncodeRows(0, BlocksY);
+		return;
+	}
+
+	// encoding costs more than copying, rows of blocks count 4 times their bytes
+	const SIZE_T SrcBlockRowBytes = (SIZE_T)SizeX * 4 * GetSourcePixelBytes(Format) * 4;
+
+	Substance::Helpers::ParallelForRows(BlocksY, SrcBlockRowBytes, EncodeRows);
+}
+
+
+//! @brief Decode a BC1 color block, for the benchmark
+static void DecodeColorBlock(const uint8* Block, uint8 (&Pixels)[16][4])
+{
+	const uint16 Color0 = Block[0] | (Block[1] << 8);
+	const uint16 Color1 = Block[2] | (Block[3] << 8);
+	const uint32 Indices = Block[4] | (Block[5] << 8) | (Block[6] << 16) | ((uint32)Block[7] << 24);
+
+	int32 Palette[4][3];
+	GetColorPalette(Color0, Color1, Palette);
+
+	// 3 colors block
+	if (Color0 <= Color1)
+	{
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			Palette[2][Channel] = (Palette[0][Channel] + Palette[1][Channel]) / 2;
+			Palette[3][Channel] = 0;
+		}
+	}
+
+	for (int32 Idx = 0; Idx < 16; ++Idx)
+	{
+		const int32 Entry = (Indices >> (Idx * 2)) & 3;
+
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			Pixels[Idx][Channel] = (uint8)Palette[Entry][Channel];
+		}
+	}
+}
+
+
+//! @brief Decode a BC4 block, for the benchmark
+static void DecodeValueBlock(const uint8* Block, uint8 (&Values)[16])
+{
+	int32 Palette[8];
+	GetValuePalette(Block[0], Block[1], Palette);
+
+	uint64 Indices = 0;
+	for (int32 Byte = 0; Byte < 6; ++Byte)
+	{
+		Indices |= (uint64)Block[2 + Byte] << (Byte * 8);
+	}
+
+	for (int32 Idx = 0; Idx < 16; ++Idx)
+	{
+		Values[Idx] = (uint8)Palette[(Indices >> (Idx * 3)) & 7];
+	}
+}
+
+
+//! @brief Root mean square error of the encoded channels of an image
+static double GetEncodingError(const uint8* Src, uint32 SizeX, uint32 SizeY, EBlockFormat Format, const uint8* Encoded)
+{
+	const uint32 BlocksX = SizeX / 4;
+	const uint32 BlocksY = SizeY / 4;
+	const int32 ChannelsCount[] = { 3, 4, 1, 2 };
+
+	double SquaredError = 0.0;
+
+	for (uint32 BlockY = 0; BlockY < BlocksY; ++BlockY)
+	{
+		for (uint32 BlockX = 0; BlockX < BlocksX; ++BlockX)
+		{
+			uint8 Pixels[16][4];
+			uint8 Decoded[16][4];
+			uint8 Values[16];
+
+			if (Format == BF_BC4)
+			{
+				LoadValueBlock(Src, SizeX, SizeY, BlockX, BlockY, Values);
+				for (int32 Idx = 0; Idx < 16; ++Idx)
+				{
+					Pixels[Idx][0] = Values[Idx];
+				}
+			}
+			else
+			{
+				LoadColorBlock(Src, SizeX, SizeY, BlockX, BlockY, Pixels);
+			}
+
+			switch (Format)
+			{
+			case BF_BC1:
+				DecodeColorBlock(Encoded, Decoded);
+				break;
+			case BF_BC3:
+				DecodeColorBlock(Encoded + 8, Decoded);
+				DecodeValueBlock(Encoded, Values);
+				for (int32 Idx = 0; Idx < 16; ++Idx)
+				{
+					Decoded[Idx][3] = Values[Idx];
+				}
+				break;
+			default:
+				for (int32 Channel = 0; Channel < (Format == BF_BC5 ? 2 : 1); ++Channel)
+				{
+					DecodeValueBlock(Encoded + Channel * 8, Values);
+					for (int32 Idx = 0; Idx < 16; ++Idx)
+					{
+						Decoded[Idx][Channel] = Values[Idx];
+					}
+				}
+				break;
+			}
+
+			for (int32 Idx = 0; Idx < 16; ++Idx)
+			{
+				for (int32 Channel = 0; Channel < ChannelsCount[Format]; ++Channel)
+				{
+					const double Difference = (double)Pixels[Idx][Channel] - Decoded[Idx][Channel];
+					SquaredError += Difference * Difference;
+				}
+			}
+
+			Encoded += GetBlockBytes(Format);
+		}
+	}
+
+	return FMath::Sqrt(SquaredError / ((double)SizeX * SizeY * ChannelsCount[Format]));
+}
+
+
+//! @brief Encode a synthetic 2048x2048 image in each format and quality,
+//! log the throughput, the error and the memory saved
+static void BenchmarkEncoder()
+{
+	const uint32 Size = 2048;
+	const TCHAR* FormatNames[] = { TEXT("BC1"), TEXT("BC3"), TEXT("BC4"), TEXT("BC5") };
+
+	// smooth gradients w/ noise, alpha in rings
+	TArray<uint8> Rgba;
+	TArray<uint8> Grey;
+	Rgba.AddUninitialized(Size * Size * 4);
+	Grey.AddUninitialized(Size * Size);
+
+	FRandomStream Random(0x5b5);
+
+	for (uint32 Y = 0; Y < Size; ++Y)
+	{
+		for (uint32 X = 0; X < Size; ++X)
+		{
+			uint8* Pixel = &Rgba[(Y * Size + X) * 4];
+			const int32 Noise = Random.RandRange(-8, 8);
+
+			Pixel[0] = (uint8)FMath::Clamp((int32)(X * 255 / Size) + Noise, 0, 255);
+			Pixel[1] = (uint8)FMath::Clamp((int32)(Y * 255 / Size) - Noise, 0, 255);
+			Pixel[2] = (uint8)FMath::Clamp(128 + (int32)(127.0f * FMath::Sin(X * 0.01f + Y * 0.02f)), 0, 255);
+			Pixel[3] = (uint8)(((X - Size / 2) * (X - Size / 2) + (Y - Size / 2) * (Y - Size / 2)) / 2048);
+
+			Grey[Y * Size + X] = Pixel[0];
+		}
+	}
+
+	for (int32 Format = BF_BC1; Format <= BF_BC5; ++Format)
+	{
+		const uint8* Src = Format == BF_BC4 ? Grey.GetData() : Rgba.GetData();
+		const SIZE_T SrcBytes = (SIZE_T)Size * Size * GetSourcePixelBytes((EBlockFormat)Format);
+		const SIZE_T EncodedBytes = (SIZE_T)(Size / 4) * (Size / 4) * GetBlockBytes((EBlockFormat)Format);
+
+		TArray<uint8> Encoded;
+		Encoded.AddUninitialized(EncodedBytes);
+
+		for (int32 bHighQuality = 0; bHighQuality < 2; ++bHighQuality)
+		{
+			const double Start = FPlatformTime::Seconds();
+			EncodeImage(Src, Size, Size, (EBlockFormat)Format, bHighQuality != 0, Encoded.GetData());
+			const double Seconds = FMath::Max(FPlatformTime::Seconds() - Start, 1e-6);
+
+			UE_LOG(LogSubstanceEncoder, Log, TEXT("%s %s: %.1f ms, %.1f Mpixels/s, RMSE %.2f, %.1f MB -> %.1f MB"),
+				FormatNames[Format],
+				bHighQuality ? TEXT("high") : TEXT("fast"),
+				Seconds * 1000.0,
+				Size * Size / Seconds / 1e6,
+				GetEncodingError(Src, Size, Size, (EBlockFormat)Format, Encoded.GetData()),
+				SrcBytes / (1024.0 * 1024.0),
+				EncodedBytes / (1024.0 * 1024.0));
+		}
+	}
+}
+
+static FAutoConsoleCommand SubstanceEncodeBenchmarkCommand(
+	TEXT("Substance.Encode.Benchmark"),
+	TEXT("Encodes a 2048x2048 image in BC1, BC3, BC4 and BC5 w/ each quality and logs the throughput and the error."),
+	FConsoleCommandDelegate::CreateStatic(&BenchmarkEncoder));
+
+} // namespace BlockEncoder
+} // namespace Substance
@@ -4,22 +4,118 @@
 //! @copyright Allegorithmic. All rights reserved.
 #include "SubstanceCorePrivatePCH.h"
 #include "SubstanceCache.h"
+#include "SubstanceCacheReader.h"
+#include "SubstanceCacheStorage.h"
+#include "SubstanceCacheWriter.h"
 #include "SubstanceCoreHelpers.h"
+#include "SubstanceCoreStats.h"
 #include "SubstanceTexture2D.h"
 #include "SubstanceFGraph.h"
+#include "SubstanceFPackage.h"
+#include "SubstanceInput.h"
+#include "SubstanceSettings.h"
+#include "framework/details/detailslinkdata.h"
 
-#include "Paths.h"
+//! @brief Entries removed per tick at most while over budget
+#define SUBSTANCECACHE_EVICT_PER_TICK 32
 
-#define SUBSTANCECACHE_VERSION 1
+//! @brief Eviction stops once the cache is back under this share of the budget
+#define SUBSTANCECACHE_EVICT_TARGET_PERCENT 90
 
 DEFINE_LOG_CATEGORY_STATIC(LogSubstanceCache, Log, All);
 
+DECLARE_MEMORY_STAT(TEXT("Cache Size"), STAT_SubstanceCacheSize, STATGROUP_Substance);
+DECLARE_MEMORY_STAT(TEXT("Cache Memory Tier Size"), STAT_SubstanceCacheMemoryTierSize, STATGROUP_Substance);
+
 using namespace Substance;
 
 TSharedPtr<SubstanceCache> SubstanceCache::SbsCache;
 
+SubstanceCache::SubstanceCache()
+	: bIndexBuilt(false)
+	, NextEvictionCandidate(0)
+{
+	FMemory::MemZero(Stats);
+
+	const USubstanceSettings* settings = GetDefault<USubstanceSettings>();
+
+	if (settings->bPackedCache)
+	{
+		Storage = MakeShareable(new SubstanceCachePackStorage(settings->bCompressedCache));
+	}
+	else
+	{
+		Storage = MakeShareable(new SubstanceCacheFileStorage(settings->bCompressedCache));
+	}
+}
+
+SubstanceCache::~SubstanceCache()
+{
+	EndManifest(ManifestPath);
+
+	// stops the threads, queued entries are written first
+	Writer.Reset();
+	Reader.Reset();
+	Storage.Reset();
+}
+
+void SubstanceCache::BuildIndex()
+{
+	if (bIndexBuilt)
+	{
+		return;
+	}
+
+	Storage->LoadIndex(Entries);
+
+	for (auto itEntry = Entries.CreateConstIterator(); itEntry; ++itEntry)
+	{
+		Stats.TotalBytes += itEntry.Value().Size;
+	}
+
+	bIndexBuilt = true;
+}
+
+void SubstanceCache::UpdateIndex()
+{
+	if (!Writer.IsValid())
+	{
+		return;
+	}
+
+	TArray<SubstanceCacheWriter::FWrittenEntry> written;
+	Writer->GetWritten(written);
+
+	for (int32 idx = 0; idx < written.Num(); ++idx)
+	{
+		const FCacheEntryInfo* previous = Entries.Find(written[idx].Key);
+		if (previous)
+		{
+			Stats.TotalBytes -= previous->Size;
+		}
+
+		FCacheEntryInfo info;
+		info.Size = written[idx].Size;
+		info.LastAccess = FDateTime::UtcNow();
+
+		Entries.Add(written[idx].Key, info);
+		Stats.TotalBytes += info.Size;
+	}
+}
+
 bool SubstanceCache::CanReadFromCache(FGraphInstance* graph)
 {
+	return HasEntries(graph, true) || HasEntries(graph, false);
+}
+
+bool SubstanceCache::HasEntries(FGraphInstance* graph, bool bMemory)
+{
+	if (!bMemory)
+	{
+		BuildIndex();
+		UpdateIndex();
+	}
+
 	bool canReadFromCache = false;
 	//make sure all enabled outputs have a cached file
 	{
@@ -28,9 +124,9 @@ bool SubstanceCache::CanReadFromCache(FGraphInstance* graph)
 		{
 			if ((*iter).bIsEnabled)
 			{
-				FString path = GetPathForGuid((*iter).OutputGuid);
+				const FString key = GetKeyForOutput(*iter);
 
-				if (IFileManager::Get().FileSize(*path) == INDEX_NONE)
+				if (bMemory ? !MemoryEntries.Contains(key) : !Entries.Contains(key))
 				{
 					return false;
 				}
@@ -47,103 +143,937 @@ bool SubstanceCache::CanReadFromCache(FGraphInstance* graph)
 	return canReadFromCache;
 }
 
-bool SubstanceCache::ReadFromCache(FGraphInstance* graph)
+bool SubstanceCache::ReadFromMemory(FGraphInstance* graph)
 {
-	if (!CanReadFromCache(graph))
+	if (!HasEntries(graph, true))
 	{
 		return false;
 	}
 
-	//read in cached data and upload
+	FMemoryRead read;
+	read.Graph = graph;
+
+	for (auto iter = graph->Outputs.itfront(); iter; ++iter)
+	{
+		if ((*iter).bIsEnabled)
+		{
+			const FString key = GetKeyForOutput(*iter);
+			RecordUse(key);
+
+			FMemoryEntry& entry = MemoryEntries.FindChecked(key);
+			entry.LastUse = GFrameCounter;
+
+			read.OutputUids.Add((*iter).Uid);
+			read.Textures.Add(entry.Texture);
+		}
+	}
+
+	MemoryReads.Add(read);
+
+	return true;
+}
+
+void SubstanceCache::AddToMemory(const FString& key, const FCachedTexturePtr& texture)
+{
+	if (GetDefault<USubstanceSettings>()->MemoryCacheBudgetMb <= 0)
+	{
+		return;
+	}
+
+	FMemoryEntry* previous = MemoryEntries.Find(key);
+	if (previous)
+	{
+		Stats.MemoryBytes -= previous->Texture->Bytes;
+	}
+
+	FMemoryEntry entry;
+	entry.Texture = texture;
+	entry.LastUse = GFrameCounter;
+
+	MemoryEntries.Add(key, entry);
+	Stats.MemoryBytes += texture->Bytes;
+}
+
+void SubstanceCache::EvictMemory()
+{
+	if (MemoryEntries.Num() == 0)
+	{
+		return;
+	}
+
+	int64 budget = (int64)GetDefault<USubstanceSettings>()->MemoryCacheBudgetMb * 1024 * 1024;
+
+	// the results can be read from disk again, give the memory back
+	if (FPlatformMemory::GetStats().AvailablePhysical < (uint64)budget)
+	{
+		budget = 0;
+	}
+
+	if (Stats.MemoryBytes <= budget)
+	{
+		return;
+	}
+
+	TArray<FString> keys;
+	MemoryEntries.GenerateKeyArray(keys);
+
+	const TMap<FString, FMemoryEntry>& entries = MemoryEntries;
+	keys.Sort([&entries](const FString& A, const FString& B)
+	{
+		return entries.FindChecked(A).LastUse < entries.FindChecked(B).LastUse;
+	});
+
+	// results still referenced by an upload or the writer are freed
+	// once those release them
+	for (int32 idx = 0; idx < keys.Num() && Stats.MemoryBytes > budget; ++idx)
+	{
+		Stats.MemoryBytes -= MemoryEntries.FindChecked(keys[idx]).Texture->Bytes;
+		MemoryEntries.Remove(keys[idx]);
+	}
+}
+
+bool SubstanceCache::RequestRead(FGraphInstance* graph, bool bProgressive)
+{
+	// superseded by this read
+	DetailQueue.Remove(graph);
+
+	if (ReadFromMemory(graph))
+	{
+		return true;
+	}
+
+	// the read is already in flight
+	if (IsPrefetching(graph))
+	{
+		PrefetchWaiters.AddUnique(graph);
+		return true;
+	}
+
+	if (!HasEntries(graph, false))
+	{
+		++Stats.Misses;
+		return false;
+	}
+
+	const USubstanceSettings* settings = GetDefault<USubstanceSettings>();
+	const bool bTailFirst = bProgressive && settings->bProgressiveCacheReads;
+
+	EnqueueRead(graph, bTailFirst ? settings->ProgressiveCacheTailSize : 0);
+
+	return true;
+}
+
+void SubstanceCache::EnqueueRead(FGraphInstance* graph, int32 maxMipSize)
+{
+	FCacheReadRequest* request = new FCacheReadRequest(graph, GetDefault<USubstanceSettings>()->bMemoryMappedCacheReads);
+	request->MaxMipSize = maxMipSize;
+
 	auto iter = graph->Outputs.itfront();
 	while (iter)
 	{
 		if ((*iter).bIsEnabled)
 		{
-			FOutputInstance& outputInstance = *(iter);
-			FString path = GetPathForGuid(outputInstance.OutputGuid);
-			FArchive* Ar = IFileManager::Get().CreateFileReader(*path);
+			request->OutputUids.Add((*iter).Uid);
+			request->Keys.Add(GetKeyForOutput(*iter));
+
+			RecordUse(request->Keys.Last());
+		}
 
-			if (Ar)
+		iter++;
+	}
+
+	GetReader().Enqueue(request);
+}
+
+bool SubstanceCache::IsPrefetching(FGraphInstance* graph)
+{
+	if (PrefetchKeys.Num() == 0)
+	{
+		return false;
+	}
+
+	bool bPrefetching = false;
+
+	for (auto iter = graph->Outputs.itfront(); iter; ++iter)
+	{
+		if ((*iter).bIsEnabled)
+		{
+			if (!PrefetchKeys.Contains(GetKeyForOutput(*iter)))
 			{
-				SubstanceTexture output;
-				FMemory::MemZero(output);
+				return false;
+			}
 
-				if (SerializeTexture(*Ar, output))
-				{
-					delete Ar;
+			bPrefetching = true;
+		}
+	}
+
+	return bPrefetching;
+}
+
+void SubstanceCache::Prefetch(const TArray<FString>& keys)
+{
+	const int64 budget = (int64)GetDefault<USubstanceSettings>()->MemoryCacheBudgetMb * 1024 * 1024;
+
+	// prefetched entries are kept by the memory tier
+	if (budget <= 0 || PrefetchKeys.Num() > 0)
+	{
+		return;
+	}
+
+	BuildIndex();
+	UpdateIndex();
+
+	TArray<FString> selected;
+	int64 size = 0;
+
+	// keys are listed in first use order, keep the earliest ones
+	for (int32 idx = 0; idx < keys.Num(); ++idx)
+	{
+		const FCacheEntryInfo* info = Entries.Find(keys[idx]);
+		if (NULL == info || MemoryEntries.Contains(keys[idx]))
+		{
+			continue;
+		}
+
+		if (size + info->Size > budget)
+		{
+			break;
+		}
+
+		selected.AddUnique(keys[idx]);
+		size += info->Size;
+	}
+
+	if (selected.Num() == 0)
+	{
+		return;
+	}
+
+	// one pass over the storage instead of a seek per graph
+	Storage->SortByLocation(selected);
+
+	FCacheReadRequest* request = new FCacheReadRequest(NULL, GetDefault<USubstanceSettings>()->bMemoryMappedCacheReads);
+	request->Keys = selected;
+	request->bPrefetch = true;
+
+	PrefetchKeys.Append(selected);
+	GetReader().Enqueue(request);
+
+	UE_LOG(LogSubstanceCache, Log, TEXT("Prefetching %d Substance cache entries (%lld bytes)"), selected.Num(), size);
+}
+
+void SubstanceCache::RecordUse(const FString& key)
+{
+	if (ManifestPath.IsEmpty() || ManifestKeySet.Contains(key))
+	{
+		return;
+	}
+
+	ManifestKeySet.Add(key);
+	ManifestKeys.Add(key);
+}
+
+void SubstanceCache::BeginManifest(const FString& manifestPath)
+{
+	EndManifest(ManifestPath);
+
+	ManifestPath = manifestPath;
+
+	FString data;
+	if (FFileHelper::LoadFileToString(data, *manifestPath))
+	{
+		TArray<FString> keys;
+		data.ParseIntoArray(&keys, TEXT("\n"), true);
+
+		Prefetch(keys);
+	}
+}
+
+void SubstanceCache::EndManifest(const FString& manifestPath)
+{
+	if (ManifestPath.IsEmpty() || ManifestPath != manifestPath)
+	{
+		return;
+	}
+
+	if (ManifestKeys.Num() > 0)
+	{
+		FString data;
+		for (int32 idx = 0; idx < ManifestKeys.Num(); ++idx)
+		{
+			data += ManifestKeys[idx];
+			data += TEXT("\n");
+		}
+
+		if (!FFileHelper::SaveStringToFile(data, *ManifestPath))
+		{
+			UE_LOG(LogSubstanceCache, Warning, TEXT("Could not save the Substance cache manifest %s"), *ManifestPath);
+		}
+	}
+
+	ManifestPath.Empty();
+	ManifestKeys.Empty();
+	ManifestKeySet.Empty();
+}
+
+void SubstanceCache::RequestDetailReads()
+{
+	const int64 budget = (int64)GetDefault<USubstanceSettings>()->ProgressiveCacheFrameBudgetMb * 1024 * 1024;
+	int64 issued = 0;
+
+	while (DetailQueue.Num() > 0)
+	{
+		graph_inst_t* graph = DetailQueue[0];
+
+		// entries evicted since the small mips were read make the
+		// read fail, the graph is then rendered
+		int64 size = 0;
+
+		for (auto iter = graph->Outputs.itfront(); iter; ++iter)
+		{
+			if ((*iter).bIsEnabled)
+			{
+				const FCacheEntryInfo* info = Entries.Find(GetKeyForOutput(*iter));
+				size += info ? info->Size : 0;
+			}
+		}
+
+		// at least one graph per frame, whatever its size
+		if (issued > 0 && issued + size > budget)
+		{
+			break;
+		}
+
+		DetailQueue.RemoveAt(0);
+
+		EnqueueRead(graph, 0);
+		DetailReads.AddUnique(graph);
+
+		issued += size;
+	}
+}
+
+void SubstanceCache::CancelReads(FGraphInstance* graph)
+{
+	DetailQueue.Remove(graph);
+	PrefetchWaiters.Remove(graph);
+	DetailReads.Remove(graph);
+
+	for (int32 idx = MemoryReads.Num() - 1; idx >= 0; --idx)
+	{
+		if (MemoryReads[idx].Graph == graph)
+		{
+			MemoryReads.RemoveAt(idx);
+		}
+	}
+
+	if (Reader.IsValid())
+	{
+		Reader->Cancel(graph);
+	}
+}
+
+void SubstanceCache::CancelAllReads()
+{
+	DetailQueue.Empty();
+	DetailReads.Empty();
+	MemoryReads.Empty();
+	PrefetchKeys.Empty();
+	PrefetchWaiters.Empty();
+
+	if (Reader.IsValid())
+	{
+		Reader->CancelAll();
+	}
+}
+
+void SubstanceCache::UploadRead(FCacheReadRequest* request, bool bCheckKeys)
+{
+	graph_inst_t* graph = request->Graph;
+
+	for (int32 idxOut = 0; idxOut < request->OutputUids.Num(); ++idxOut)
+	{
+		output_inst_t* output = graph->GetOutput(request->OutputUids[idxOut]);
+
+		if (NULL == output || !output->bIsEnabled)
+		{
+			continue;
+		}
 
-					USubstanceTexture2D* texture = *((outputInstance.Texture).get());
-					Substance::Helpers::UpdateTexture(output, &outputInstance, false);
+		if (bCheckKeys && GetKeyForOutput(*output) != request->Keys[idxOut])
+		{
+			continue;
+		}
+
+		Substance::Helpers::UpdateTexture(request->Textures[idxOut], output);
+	}
+}
+
+void SubstanceCache::ProcessCompletedReads(Substance::List<graph_inst_t*>& completed, Substance::List<graph_inst_t*>& failed)
+{
+	TArray<FCacheReadRequest*> requests;
+	if (Reader.IsValid())
+	{
+		Reader->GetCompleted(requests);
+	}
+
+	for (int32 idx = 0; idx < requests.Num(); ++idx)
+	{
+		FCacheReadRequest* request = requests[idx];
+		graph_inst_t* graph = request->Graph;
+
+		if (request->Cancelled.GetValue() != 0)
+		{
+			Reader->Release(request);
+			continue;
+		}
 
-					FMemory::Free(output.buffer);
+		if (request->bPrefetch)
+		{
+			// a prefetch stopped early only holds its first textures
+			for (int32 idxKey = 0; idxKey < request->Textures.Num(); ++idxKey)
+			{
+				AddToMemory(request->Keys[idxKey], FCachedTexturePtr(
+					new FCachedTexture(request->Textures[idxKey], request->MappedFiles[idxKey])));
+
+				request->Textures[idxKey].buffer = NULL;
+			}
+
+			PrefetchKeys.Empty();
+			Reader->Release(request);
+
+			// served from memory now, from the disk when the prefetch missed them
+			Substance::List<graph_inst_t*> waiters = PrefetchWaiters;
+			PrefetchWaiters.Empty();
+
+			for (int32 idxWaiter = 0; idxWaiter < waiters.Num(); ++idxWaiter)
+			{
+				if (!RequestRead(waiters[idxWaiter]))
+				{
+					failed.AddUnique(waiters[idxWaiter]);
 				}
-				else
+			}
+
+			continue;
+		}
+
+		const bool bTail = request->MaxMipSize > 0;
+		const bool bDetail = !bTail && DetailReads.Remove(graph) > 0;
+
+		if (request->bSucceeded)
+		{
+			UploadRead(request, bDetail);
+
+			const FDateTime now = FDateTime::UtcNow();
+
+			for (int32 idxKey = 0; idxKey < request->Keys.Num(); ++idxKey)
+			{
+				FCacheEntryInfo* info = Entries.Find(request->Keys[idxKey]);
+				if (info)
 				{
-					delete Ar;
-					return false;
+					info->LastAccess = now;
+					GetWriter().EnqueueTouch(request->Keys[idxKey], now);
 				}
 			}
+
+			// graphs showing their small mips only complete once the
+			// full chains are read, they may still need to be rendered
+			if (bTail)
+			{
+				DetailQueue.AddUnique(graph);
+			}
 			else
 			{
-				return false;
+				// the memory tier takes the buffers and views over
+				for (int32 idxKey = 0; idxKey < request->Keys.Num(); ++idxKey)
+				{
+					AddToMemory(request->Keys[idxKey], FCachedTexturePtr(
+						new FCachedTexture(request->Textures[idxKey], request->MappedFiles[idxKey])));
+
+					request->Textures[idxKey].buffer = NULL;
+				}
+
+				++Stats.Hits;
+				completed.AddUnique(graph);
 			}
 		}
+		else
+		{
+			// the index was wrong about those entries
+			for (int32 idxKey = 0; idxKey < request->Keys.Num(); ++idxKey)
+			{
+				const FCacheEntryInfo* info = Entries.Find(request->Keys[idxKey]);
+				if (info)
+				{
+					Stats.TotalBytes -= info->Size;
+					Entries.Remove(request->Keys[idxKey]);
+				}
 
-		iter++;
+				GetWriter().EnqueueRemove(request->Keys[idxKey]);
+			}
+
+			++Stats.Misses;
+			failed.AddUnique(graph);
+		}
+
+		Reader->Release(request);
 	}
 
-	return true;
+	// after the disk reads, which may have queued some
+	for (int32 idx = 0; idx < MemoryReads.Num(); ++idx)
+	{
+		const FMemoryRead& read = MemoryReads[idx];
+
+		for (int32 idxOut = 0; idxOut < read.OutputUids.Num(); ++idxOut)
+		{
+			output_inst_t* output = read.Graph->GetOutput(read.OutputUids[idxOut]);
+
+			if (output && output->bIsEnabled)
+			{
+				Substance::Helpers::UpdateTexture(read.Textures[idxOut]->Texture, output);
+			}
+		}
+
+		++Stats.MemoryHits;
+		completed.AddUnique(read.Graph);
+	}
+
+	MemoryReads.Empty();
 }
 
-void SubstanceCache::CacheOutput(output_inst_t* output, const SubstanceTexture& result)
+void SubstanceCache::WaitForReads(Substance::List<graph_inst_t*>& completed, Substance::List<graph_inst_t*>& failed)
 {
-	FString filename = GetPathForGuid(output->OutputGuid);
-	FArchive* Ar = IFileManager::Get().CreateFileWriter(*filename, 0);
+	if (!Reader.IsValid())
+	{
+		ProcessCompletedReads(completed, failed);
+		return;
+	}
 
-	if (Ar)
+	// completed reads have to be released for the reader
+	// to go past its in-flight budget
+	for (;;)
 	{
-		SerializeTexture(*Ar, const_cast<SubstanceTexture&>(result));
-		delete Ar;
+		ProcessCompletedReads(completed, failed);
+
+		if (Reader->IsIdle())
+		{
+			break;
+		}
+
+		Reader->WaitForCompleted(10);
 	}
 }
 
-FString SubstanceCache::GetPathForGuid(const FGuid& guid) const
+void SubstanceCache::QueueOutput(const FString& key, const SubstanceTexture& result)
+{
+	FCachedTexturePtr texture(new FCachedTexture(result));
+
+	RecordUse(key);
+	AddToMemory(key, texture);
+	GetWriter().Enqueue(key, texture);
+}
+
+SubstanceCacheReader& SubstanceCache::GetReader()
 {
-	return FString::Printf(TEXT("%s/Substance/%s.cache"), *FPaths::GameSavedDir(), *(guid.ToString()));
+	if (!Reader.IsValid())
+	{
+		const int64 budget = (int64)FMath::Max(GetDefault<USubstanceSettings>()->AsyncCacheReadBudgetMb, 1) * 1024 * 1024;
+		Reader = MakeShareable(new SubstanceCacheReader(*Storage, budget));
+	}
+
+	return *Reader;
 }
 
-bool SubstanceCache::SerializeTexture(FArchive& Ar, SubstanceTexture& result) const
+SubstanceCacheWriter& SubstanceCache::GetWriter()
 {
-	uint32 version = SUBSTANCECACHE_VERSION;
+	if (!Writer.IsValid())
+	{
+		Writer = MakeShareable(new SubstanceCacheWriter(*Storage));
+	}
 
-	Ar << version;
+	return *Writer;
+}
 
-	if (Ar.IsLoading())
+void SubstanceCache::Tick()
+{
+	// nothing to track until the cache is used
+	if (!bIndexBuilt && !Writer.IsValid())
 	{
-		if (version != SUBSTANCECACHE_VERSION)
+		return;
+	}
+
+	BuildIndex();
+	UpdateIndex();
+	Evict();
+	EvictMemory();
+	RequestDetailReads();
+
+	SET_MEMORY_STAT(STAT_SubstanceCacheSize, Stats.TotalBytes);
+	SET_MEMORY_STAT(STAT_SubstanceCacheMemoryTierSize, Stats.MemoryBytes);
+}
+
+void SubstanceCache::Evict()
+{
+	const int64 budget = (int64)GetDefault<USubstanceSettings>()->CacheBudgetMb * 1024 * 1024;
+
+	// once started, go a bit under budget so that every new
+	// entry does not trigger an eviction
+	const int64 limit = EvictionCandidates.Num() > 0 ?
+		budget / 100 * SUBSTANCECACHE_EVICT_TARGET_PERCENT : budget;
+
+	if (Stats.TotalBytes <= limit)
+	{
+		EvictionCandidates.Empty();
+		NextEvictionCandidate = 0;
+		return;
+	}
+
+	// sort once, then consume the candidates over several ticks
+	if (NextEvictionCandidate >= EvictionCandidates.Num())
+	{
+		EvictionCandidates.Empty(Entries.Num());
+		Entries.GenerateKeyArray(EvictionCandidates);
+
+		const TMap<FString, FCacheEntryInfo>& entries = Entries;
+		EvictionCandidates.Sort([&entries](const FString& A, const FString& B)
 		{
-			UE_LOG(LogSubstanceCache, Warning, TEXT("Out of date Substance cache entry, will regenerate"));	
-			return false;
+			return entries.FindChecked(A).LastAccess < entries.FindChecked(B).LastAccess;
+		});
+
+		NextEvictionCandidate = 0;
+		EvictionStartTime = FDateTime::UtcNow();
+	}
+
+	int32 evicted = 0;
+
+	while (Stats.TotalBytes > budget / 100 * SUBSTANCECACHE_EVICT_TARGET_PERCENT &&
+		evicted < SUBSTANCECACHE_EVICT_PER_TICK &&
+		NextEvictionCandidate < EvictionCandidates.Num())
+	{
+		const FString key = EvictionCandidates[NextEvictionCandidate++];
+		const FCacheEntryInfo* info = Entries.Find(key);
+
+		// gone or used since the candidates were sorted
+		if (NULL == info || info->LastAccess > EvictionStartTime)
+		{
+			continue;
 		}
+
+		Stats.TotalBytes -= info->Size;
+		Stats.EvictedBytes += info->Size;
+		++Stats.Evictions;
+
+		Entries.Remove(key);
+		GetWriter().EnqueueRemove(key);
+
+		++evicted;
 	}
+}
 
-	Ar << result.level0Width;
-	Ar << result.level0Height;
-	Ar << result.pixelFormat;
-	Ar << result.channelsOrder;
-	Ar << result.mipmapCount;
+FCacheStats SubstanceCache::GetStats() const
+{
+	FCacheStats stats = Stats;
+	stats.BudgetBytes = (int64)GetDefault<USubstanceSettings>()->CacheBudgetMb * 1024 * 1024;
+	stats.EntryCount = Entries.Num();
+	stats.MemoryEntryCount = MemoryEntries.Num();
+	return stats;
+}
 
-	EPixelFormat pixelFormat = Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)result.pixelFormat);
-	SIZE_T bufferSize = CalcTextureSize(result.level0Width, result.level0Height, pixelFormat, result.mipmapCount);
+int64 SubstanceCache::GetQueuedWriteBytes() const
+{
+	return Writer.IsValid() ? Writer->GetQueuedBytes() : 0;
+}
+
+int64 SubstanceCache::GetWrittenBytes() const
+{
+	return Writer.IsValid() ? Writer->GetWrittenBytes() : 0;
+}
 
-	if (Ar.IsLoading())
+FString SubstanceCache::GetKeyForOutput(const output_inst_t& output) const
+{
+	graph_inst_t* graph = output.ParentInstance ? output.ParentInstance->Instance : NULL;
+
+	if (NULL == graph || NULL == graph->Desc || NULL == graph->Desc->Parent)
 	{
-		check(result.buffer == NULL);
-		result.buffer = FMemory::Malloc(bufferSize);
+		return output.OutputGuid.ToString();
 	}
-	
-	Ar.Serialize(result.buffer, bufferSize);
-	
-	return true;
+
+	// The link data hash is kept once the package releases its link data
+	const package_t* package = graph->Desc->Parent;
+	if (package->getLinkData())
+	{
+		FSHA1 linkSha;
+		package->getLinkData()->hashKey(linkSha);
+		linkSha.Final();
+		linkSha.GetHash(PackageHashes.FindOrAdd(package->Guid).Hash);
+	}
+
+	const FSHAHash* packageHash = PackageHashes.Find(package->Guid);
+	if (NULL == packageHash)
+	{
+		return output.OutputGuid.ToString();
+	}
+
+	FSHA1 sha;
+	sha.Update(packageHash->Hash, sizeof(packageHash->Hash));
+
+	FTCHARToUTF8 urlUtf8(*graph->ParentUrl);
+	sha.Update((const uint8*)urlUtf8.Get(), urlUtf8.Length());
+
+	auto itIn = graph->Inputs.itfrontconst();
+	for (; itIn; ++itIn)
+	{
+		const input_inst_t* input = (*itIn).Get();
+		sha.Update((const uint8*)&input->Uid, sizeof(input->Uid));
+
+		if (input->IsNumerical())
+		{
+			const FNumericalInputInstanceBase* numInput = (const FNumericalInputInstanceBase*)input;
+			sha.Update((const uint8*)numInput->getRawData(), numInput->getRawSize());
+		}
+		else
+		{
+			const FImageInputInstance* imgInput = (const FImageInputInstance*)input;
+			const uint8 hasImage = imgInput->GetImage() ? 1 : 0;
+			sha.Update(&hasImage, sizeof(hasImage));
+
+			if (hasImage)
+			{
+				const FSHAHash& contentHash = imgInput->GetImage()->getContentHash();
+				sha.Update(contentHash.Hash, sizeof(contentHash.Hash));
+			}
+		}
+	}
+
+	sha.Update((const uint8*)&output.Uid, sizeof(output.Uid));
+	sha.Update((const uint8*)&output.Format, sizeof(output.Format));
+	sha.Final();
+
+	uint8 hash[20];
+	sha.GetHash(hash);
+
+	return BytesToHex(hash, sizeof(hash));
+}
+
+void SubstanceCache::Benchmark()
+{
+	BuildIndex();
+	UpdateIndex();
+
+	TArray<FString> keys;
+	Entries.GenerateKeyArray(keys);
+
+	if (keys.Num() == 0)
+	{
+		UE_LOG(LogSubstanceCache, Log, TEXT("No Substance cache entry found"));
+		return;
+	}
+
+	USubstanceTexture2D* texture = ConstructObject<USubstanceTexture2D>(
+		USubstanceTexture2D::StaticClass(), GetTransientPackage(), NAME_None, RF_Transient);
+
+	// the copies are measured, not their encoding
+	texture->OutputCompression = SOC_None;
+
+	double bufferedTotal = 0.0;
+	double mappedTotal = 0.0;
+	int64 bufferedCopied = 0;
+	int64 mappedCopied = 0;
+	int32 count = 0;
+
+	for (int32 idx = 0; idx < keys.Num(); ++idx)
+	{
+		const FString& key = keys[idx];
+
+		double bufferedMs = 0.0;
+		double mappedMs = 0.0;
+		int64 bufferedBytes = 0;
+		int64 mappedBytes = 0;
+		int32 width = 0;
+		int32 height = 0;
+		bool bSuccess = true;
+
+		// the first read of an entry warms the page cache, the order alternates
+		for (int32 pass = 0; pass < 2 && bSuccess; ++pass)
+		{
+			const bool bBuffered = (pass + idx) % 2 == 0;
+			const int64 copiedBefore = SubstanceCacheStorage::GetCopiedBytes() + Substance::Helpers::GetCopiedOutputBytes();
+			const double start = FPlatformTime::Seconds();
+
+			SubstanceTexture result;
+			FMemory::MemZero(result);
+
+			if (bBuffered)
+			{
+				// file -> allocated buffer -> mips
+				bSuccess = Storage->ReadBuffered(key, result);
+
+				if (bSuccess)
+				{
+					Substance::Helpers::UpdateSubstanceOutput(texture, result);
+					FMemory::Free(result.buffer);
+				}
+			}
+			else
+			{
+				// mapped view -> mips
+				FMappedFilePtr view;
+				bSuccess = Storage->ReadMapped(key, view, result);
+
+				if (bSuccess)
+				{
+					Substance::Helpers::UpdateSubstanceOutput(texture, result);
+
+					// compressed entries are not read in place
+					if (!view.IsValid())
+					{
+						FMemory::Free(result.buffer);
+					}
+				}
+			}
+
+			const double ms = (FPlatformTime::Seconds() - start) * 1000.0;
+			const int64 copied = SubstanceCacheStorage::GetCopiedBytes() + Substance::Helpers::GetCopiedOutputBytes() - copiedBefore;
+
+			if (bBuffered)
+			{
+				bufferedMs = ms;
+				bufferedBytes = copied;
+			}
+			else
+			{
+				mappedMs = ms;
+				mappedBytes = copied;
+			}
+
+			width = result.level0Width;
+			height = result.level0Height;
+		}
+
+		if (!bSuccess)
+		{
+			continue;
+		}
+
+		UE_LOG(LogSubstanceCache, Log, TEXT("%s %dx%d: buffered %.3f ms / %lld bytes copied, mapped %.3f ms / %lld bytes copied"),
+			*key, width, height, bufferedMs, bufferedBytes, mappedMs, mappedBytes);
+
+		bufferedTotal += bufferedMs;
+		mappedTotal += mappedMs;
+		bufferedCopied += bufferedBytes;
+		mappedCopied += mappedBytes;
+		++count;
+	}
+
+	UE_LOG(LogSubstanceCache, Log, TEXT("Substance cache benchmark over %d entries: buffered %.3f ms / %lld bytes, mapped %.3f ms / %lld bytes"),
+		count, bufferedTotal, bufferedCopied, mappedTotal, mappedCopied);
+
+	texture->MarkPendingKill();
+}
+
+static void RunSubstanceCacheBenchmark()
+{
+	SubstanceCache::Get()->Benchmark();
 }
+
+void SubstanceCache::BenchmarkCompression()
+{
+	BuildIndex();
+	UpdateIndex();
+
+	TArray<FString> keys;
+	Entries.GenerateKeyArray(keys);
+
+	uint64 rawTotal = 0;
+	uint64 compressedTotal = 0;
+	double compressTotal = 0.0;
+	double decompressTotal = 0.0;
+	int32 count = 0;
+
+	for (int32 idx = 0; idx < keys.Num(); ++idx)
+	{
+		SubstanceTexture raw;
+		FMemory::MemZero(raw);
+
+		if (!Storage->ReadBuffered(keys[idx], raw))
+		{
+			continue;
+		}
+
+		const SIZE_T bufferSize = CalcTextureSize(raw.level0Width, raw.level0Height,
+			Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)raw.pixelFormat), raw.mipmapCount);
+
+		TArray<int32> chunkSizes;
+		TArray<uint8> chunks;
+
+		double start = FPlatformTime::Seconds();
+		SubstanceCacheStorage::CompressMips(raw, chunkSizes, chunks);
+		const double compressMs = (FPlatformTime::Seconds() - start) * 1000.0;
+
+		uint8* decompressed = (uint8*)FMemory::Malloc(bufferSize);
+
+		start = FPlatformTime::Seconds();
+		const bool bDecompressed = SubstanceCacheStorage::DecompressMips(raw, chunkSizes, chunks.GetData(), decompressed);
+		const double decompressMs = (FPlatformTime::Seconds() - start) * 1000.0;
+
+		if (!bDecompressed || FMemory::Memcmp(decompressed, raw.buffer, bufferSize) != 0)
+		{
+			UE_LOG(LogSubstanceCache, Warning, TEXT("%s: compressed mips do not round trip"), *keys[idx]);
+		}
+
+		UE_LOG(LogSubstanceCache, Log, TEXT("%s %dx%d: %llu -> %d bytes (%.2f:1), compress %.3f ms, decompress %.3f ms"),
+			*keys[idx], raw.level0Width, raw.level0Height, (uint64)bufferSize, chunks.Num(),
+			(double)bufferSize / FMath::Max(chunks.Num(), 1), compressMs, decompressMs);
+
+		rawTotal += bufferSize;
+		compressedTotal += chunks.Num();
+		compressTotal += compressMs;
+		decompressTotal += decompressMs;
+		++count;
+
+		FMemory::Free(decompressed);
+		FMemory::Free(raw.buffer);
+	}
+
+	if (count == 0)
+	{
+		UE_LOG(LogSubstanceCache, Log, TEXT("No Substance cache entry found"));
+		return;
+	}
+
+	const double rawMb = rawTotal / (1024.0 * 1024.0);
+
+	UE_LOG(LogSubstanceCache, Log, TEXT("Substance cache compression over %d entries: %llu -> %llu bytes (%.2f:1), compress %.1f MB/s, decompress %.1f MB/s"),
+		count, rawTotal, compressedTotal, (double)rawTotal / FMath::Max<uint64>(compressedTotal, 1),
+		rawMb / FMath::Max(compressTotal / 1000.0, 1e-6), rawMb / FMath::Max(decompressTotal / 1000.0, 1e-6));
+}
+
+static void RunSubstanceCacheCompressionBenchmark()
+{
+	SubstanceCache::Get()->BenchmarkCompression();
+}
+
+static FAutoConsoleCommand SubstanceCacheCompressionBenchmarkCommand(
+	TEXT("Substance.Cache.BenchmarkCompression"),
+	TEXT("Compresses and decompresses every Substance cache entry and logs the ratio and throughput."),
+	FConsoleCommandDelegate::CreateStatic(&RunSubstanceCacheCompressionBenchmark));
+
+static void LogSubstanceCacheStats()
+{
+	const FCacheStats stats = SubstanceCache::Get()->GetStats();
+
+	UE_LOG(LogSubstanceCache, Log, TEXT("Substance cache: %d entries, %lld / %lld bytes, %llu hits, %llu misses, %llu evictions (%llu bytes)"),
+		stats.EntryCount, stats.TotalBytes, stats.BudgetBytes, stats.Hits, stats.Misses, stats.Evictions, stats.EvictedBytes);
+	UE_LOG(LogSubstanceCache, Log, TEXT("Substance cache memory tier: %d entries, %lld bytes, %llu hits"),
+		stats.MemoryEntryCount, stats.MemoryBytes, stats.MemoryHits);
+}
+
+static FAutoConsoleCommand SubstanceCacheStatsCommand(
+	TEXT("Substance.Cache.Stats"),
+	TEXT("Logs the Substance cache size, hits, misses and evictions."),
+	FConsoleCommandDelegate::CreateStatic(&LogSubstanceCacheStats));
+
+static FAutoConsoleCommand SubstanceCacheBenchmarkCommand(
+	TEXT("Substance.Cache.Benchmark"),
+	TEXT("Loads every Substance cache entry with buffered and memory-mapped reads and logs timings."),
+	FConsoleCommandDelegate::CreateStatic(&RunSubstanceCacheBenchmark));
@@ -5,12 +5,41 @@
 #pragma once
 
 #include "substance_public.h"
+#include "SubstanceCacheStorage.h"
 
-class FArchive;
 class USubstanceTexture2D;
 
 namespace Substance
 {
+	class SubstanceCacheReader;
+	class SubstanceCacheWriter;
+	struct FCacheReadRequest;
+
+	//! @brief Cache counters since startup
+	struct FCacheStats
+	{
+		//! @brief Graph instances read from the disk cache
+		uint64 Hits;
+
+		//! @brief Graph instances read from the memory tier
+		uint64 MemoryHits;
+
+		//! @brief Graph instances with a missing or unreadable entry
+		uint64 Misses;
+
+		uint64 Evictions;
+		uint64 EvictedBytes;
+
+		//! @brief Size of the indexed entries
+		int64 TotalBytes;
+		int64 BudgetBytes;
+		int32 EntryCount;
+
+		//! @brief Size of the results held by the memory tier
+		int64 MemoryBytes;
+		int32 MemoryEntryCount;
+	};
+
 	class SubstanceCache
 	{
 	public:
@@ -25,21 +54,188 @@ namespace Substance
 
 		static void Shutdown()
 		{
-			if (!SbsCache.IsValid())
+			if (SbsCache.IsValid())
 			{
 				SbsCache.Reset();
 			}
 		}
 
+		SubstanceCache();
+		~SubstanceCache();
+
+		//! @brief Tell if every enabled output of the graph has a cache entry
+		//! in memory or on disk
+		//! @note Looks up the entry index, does not touch the disk
 		bool CanReadFromCache(FGraphInstance* graph);
 
-		bool ReadFromCache(FGraphInstance* graph);
+		//! @brief Queue the read of the graph's cached outputs on the reader thread
+		//! @param bProgressive Read the small mips first when progressive reads
+		//! are enabled, the full chains are read over the next frames
+		//! @return False if some enabled output has no cache entry
+		bool RequestRead(FGraphInstance* graph, bool bProgressive = false);
+
+		//! @brief Drop the pending reads of a graph about to be destroyed
+		void CancelReads(FGraphInstance* graph);
+
+		void CancelAllReads();
+
+		//! @brief Upload the outputs of the graphs read from memory or whose read is over
+		//! @param completed Graphs updated from the cache
+		//! @param failed Graphs whose entries could not be read and need a render
+		void ProcessCompletedReads(Substance::List<graph_inst_t*>& completed, Substance::List<graph_inst_t*>& failed);
 
-		void CacheOutput(output_inst_t* Output, const SubstanceTexture& result);
+		//! @brief Process completed reads until every queued read is over
+		void WaitForReads(Substance::List<graph_inst_t*>& completed, Substance::List<graph_inst_t*>& failed);
+
+		//! @brief Hash of the package link data, raw input values, image
+		//! input contents and output format
+		//! @note Falls back to the output guid when the graph is unknown or
+		//! its package released its link data before any key was computed
+		FString GetKeyForOutput(const output_inst_t& output) const;
+
+		//! @brief Keep the result in the memory tier and queue it for writing
+		//! on the writer thread
+		//! @param key Key of the inputs the result was rendered with, see
+		//! RenderResult::getCacheKey
+		//! @note Takes ownership of result.buffer, which must have been
+		//! allocated with FMemory::Malloc (e.g. RenderResult::releaseTexture)
+		void QueueOutput(const FString& key, const SubstanceTexture& result);
+
+		//! @brief Bytes waiting to be written by the writer thread
+		int64 GetQueuedWriteBytes() const;
+
+		//! @brief Bytes written to the cache since startup
+		int64 GetWrittenBytes() const;
+
+		//! @brief Index the written entries, evict some of the least recently
+		//! used ones while the cache is over budget and stream in the full
+		//! chains of progressive reads
+		void Tick();
+
+		FCacheStats GetStats() const;
+
+		//! @brief Save the previous manifest, prefetch the entries listed by
+		//! this one and record the entries used until EndManifest
+		//! @param manifestPath Manifest of the map being loaded
+		void BeginManifest(const FString& manifestPath);
+
+		//! @brief Save the entries used since BeginManifest
+		//! @note Ignored unless manifestPath is the one being recorded
+		void EndManifest(const FString& manifestPath);
+
+		//! @brief Load every cache entry using both read modes, in alternating
+		//! order, and log the time and bytes copied per output
+		//! @note Copies are counted globally, run it while no output streams in
+		void Benchmark();
+
+		//! @brief Compress and decompress every cache entry and log the
+		//! compression ratio and throughput
+		void BenchmarkCompression();
 
 	private:
-		FString GetPathForGuid(const FGuid& guid) const;
-		bool SerializeTexture(FArchive& Ar, SubstanceTexture& result) const;
+		//! @brief Load the entry index from the storage once
+		void BuildIndex();
+
+		//! @brief Add the entries written by the writer thread to the index
+		void UpdateIndex();
+
+		//! @brief Remove a bounded amount of entries, least recently used first
+		void Evict();
+
+		SubstanceCacheWriter& GetWriter();
+		SubstanceCacheReader& GetReader();
+
+		//! @brief Add an entry to the manifest being recorded
+		void RecordUse(const FString& key);
+
+		//! @brief Read the entries into the memory tier in storage order,
+		//! within the memory tier budget
+		void Prefetch(const TArray<FString>& keys);
+
+		//! @brief Tell if the prefetch in flight holds every enabled output
+		bool IsPrefetching(FGraphInstance* graph);
+
+		//! @brief Queue the read of the graph's enabled outputs
+		void EnqueueRead(FGraphInstance* graph, int32 maxMipSize);
+
+		//! @brief Tell if every enabled output has an entry in the given tier
+		bool HasEntries(FGraphInstance* graph, bool bMemory);
+
+		//! @brief Pin the graph's results held in memory for upload
+		//! @return False if some enabled output is not in memory
+		bool ReadFromMemory(FGraphInstance* graph);
+
+		//! @brief Keep a result in the memory tier, replacing any previous one
+		void AddToMemory(const FString& key, const FCachedTexturePtr& texture);
+
+		//! @brief Drop the least recently used results while over budget,
+		//! or every result when the system runs low on memory
+		void EvictMemory();
+
+		//! @brief Queue the full chain reads of graphs showing their small
+		//! mips, within the per-frame budget
+		void RequestDetailReads();
+
+		//! @brief Upload the outputs of a completed read
+		//! @param bCheckKeys Skip outputs whose key changed since the request
+		void UploadRead(FCacheReadRequest* request, bool bCheckKeys);
+
+		//! @brief Link data hash of each package, by package guid
+		mutable TMap<substanceGuid_t, FSHAHash> PackageHashes;
+
+		//! @brief Entries found in the storage or written since
+		TMap<FString, FCacheEntryInfo> Entries;
+		bool bIndexBuilt;
+
+		//! @brief Keys sorted by last use when eviction started
+		TArray<FString> EvictionCandidates;
+		int32 NextEvictionCandidate;
+		FDateTime EvictionStartTime;
+
+		FCacheStats Stats;
+
+		//! @brief Graphs showing their small mips, waiting for a full chain read
+		Substance::List<graph_inst_t*> DetailQueue;
+
+		//! @brief Graphs whose full chain read is in flight
+		Substance::List<graph_inst_t*> DetailReads;
+
+		//! @brief Result held by the memory tier
+		struct FMemoryEntry
+		{
+			FCachedTexturePtr Texture;
+			uint64 LastUse;
+		};
+
+		TMap<FString, FMemoryEntry> MemoryEntries;
+
+		//! @brief Graph read from memory, uploaded by ProcessCompletedReads
+		struct FMemoryRead
+		{
+			graph_inst_t* Graph;
+			TArray<uint32> OutputUids;
+			TArray<FCachedTexturePtr> Textures;
+		};
+
+		TArray<FMemoryRead> MemoryReads;
+
+		//! @brief Manifest being recorded, empty when not recording
+		FString ManifestPath;
+
+		//! @brief Entries used since BeginManifest, in first use order
+		TArray<FString> ManifestKeys;
+		TSet<FString> ManifestKeySet;
+
+		//! @brief Entries of the prefetch in flight
+		TSet<FString> PrefetchKeys;
+
+		//! @brief Graphs requested while their entries were being
+		//! prefetched, requested again once the prefetch completes
+		Substance::List<graph_inst_t*> PrefetchWaiters;
+
+		TSharedPtr<SubstanceCacheStorage> Storage;
+		TSharedPtr<SubstanceCacheReader> Reader;
+		TSharedPtr<SubstanceCacheWriter> Writer;
 
 		static TSharedPtr<SubstanceCache> SbsCache;
 	};
@@ -0,0 +1,140 @@
+//! @file SubstanceCacheMapping.cpp
+//! @brief Read-only memory mapping of Substance cache files
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceCacheMapping.h"
+
+#if PLATFORM_WINDOWS
+#include "AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "HideWindowsPlatformTypes.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace Substance;
+
+SubstanceMappedFile::SubstanceMappedFile()
+	: Data(NULL)
+	, Size(0)
+#if PLATFORM_WINDOWS
+	, FileHandle(NULL)
+	, MappingHandle(NULL)
+#else
+	, FileDescriptor(-1)
+#endif
+{
+}
+
+SubstanceMappedFile::~SubstanceMappedFile()
+{
+	Close();
+}
+
+bool SubstanceMappedFile::Open(const FString& Path)
+{
+	Close();
+
+	const FString NativePath = IFileManager::Get().ConvertToAbsolutePathForExternalAppForRead(*Path);
+
+#if PLATFORM_WINDOWS
+	HANDLE File = CreateFileW(*NativePath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0)
+	{
+		CloseHandle(File);
+		return false;
+	}
+
+	HANDLE Mapping = CreateFileMappingW(File, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (Mapping == NULL)
+	{
+		CloseHandle(File);
+		return false;
+	}
+
+	const void* View = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	if (View == NULL)
+	{
+		CloseHandle(Mapping);
+		CloseHandle(File);
+		return false;
+	}
+
+	FileHandle = File;
+	MappingHandle = Mapping;
+	Data = (const uint8*)View;
+	Size = FileSize.QuadPart;
+#else
+	int File = open(TCHAR_TO_UTF8(*NativePath), O_RDONLY);
+	if (File < 0)
+	{
+		return false;
+	}
+
+	struct stat FileStat;
+	if (fstat(File, &FileStat) != 0 || FileStat.st_size == 0)
+	{
+		close(File);
+		return false;
+	}
+
+	void* View = mmap(NULL, FileStat.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+	if (View == MAP_FAILED)
+	{
+		close(File);
+		return false;
+	}
+
+	madvise(View, FileStat.st_size, MADV_SEQUENTIAL);
+
+	FileDescriptor = File;
+	Data = (const uint8*)View;
+	Size = FileStat.st_size;
+#endif
+
+	return true;
+}
+
+void SubstanceMappedFile::Close()
+{
+#if PLATFORM_WINDOWS
+	if (Data)
+	{
+		UnmapViewOfFile(Data);
+	}
+	if (MappingHandle)
+	{
+		CloseHandle((HANDLE)MappingHandle);
+	}
+	if (FileHandle)
+	{
+		CloseHandle((HANDLE)FileHandle);
+	}
+	FileHandle = NULL;
+	MappingHandle = NULL;
+#else
+	if (Data)
+	{
+		munmap((void*)Data, Size);
+	}
+	if (FileDescriptor >= 0)
+	{
+		close(FileDescriptor);
+	}
+	FileDescriptor = -1;
+#endif
+
+	Data = NULL;
+	Size = 0;
+}
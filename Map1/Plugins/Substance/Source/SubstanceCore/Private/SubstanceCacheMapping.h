@@ -0,0 +1,47 @@
+//! @file SubstanceCacheMapping.h
+//! @brief Read-only memory mapping of Substance cache files
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+namespace Substance
+{
+	//! @brief Read-only view of a whole file mapped in memory
+	//! @note Unmapped on destruction, pointers into the view must not
+	//!       outlive the instance
+	class SubstanceMappedFile
+	{
+	public:
+		SubstanceMappedFile();
+		~SubstanceMappedFile();
+
+		//! @brief Map the file at path, unmaps any previous view
+		//! @return False if the file cannot be opened or is empty
+		bool Open(const FString& Path);
+
+		//! @brief Release the view and the file handles
+		void Close();
+
+		bool IsValid() const { return Data != NULL; }
+
+		const uint8* GetData() const { return Data; }
+
+		int64 GetSize() const { return Size; }
+
+	private:
+		SubstanceMappedFile(const SubstanceMappedFile&);
+		SubstanceMappedFile& operator=(const SubstanceMappedFile&);
+
+		const uint8* Data;
+		int64 Size;
+
+#if PLATFORM_WINDOWS
+		void* FileHandle;
+		void* MappingHandle;
+#else
+		int FileDescriptor;
+#endif
+	};
+
+	//! @brief Views are shared between the reader thread and the game thread
+	typedef TSharedPtr<SubstanceMappedFile, ESPMode::ThreadSafe> FMappedFilePtr;
+}
@@ -0,0 +1,737 @@
+//! @file SubstanceCachePackStorage.cpp
+//! @brief Substance cache entries stored in pack files
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceCacheStorage.h"
+
+#include "Paths.h"
+
+#define SUBSTANCEPACK_MAGIC 0x4B504253
+#define SUBSTANCEPACK_INDEX_MAGIC 0x58494253
+#define SUBSTANCEPACK_VERSION 3
+#define SUBSTANCEPACK_INDEX_VERSION 3
+
+//! @brief Appends go to a new pack past this size
+#define SUBSTANCEPACK_MAX_SIZE ((int64)1024 * 1024 * 1024)
+
+//! @brief Dead bytes needed before compacting, packs also have to be mostly dead
+#define SUBSTANCEPACK_COMPACT_MIN_BYTES ((int64)64 * 1024 * 1024)
+
+DEFINE_LOG_CATEGORY_STATIC(LogSubstanceCachePack, Log, All);
+
+using namespace Substance;
+
+FArchive& operator<<(FArchive& Ar, SubstanceCachePackStorage::FEntry& Entry)
+{
+	Ar << Entry.Pack;
+	Ar << Entry.Offset;
+	Ar << Entry.Size;
+	Ar << Entry.LastAccess;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, SubstanceCachePackStorage::FPack& Pack)
+{
+	Ar << Pack.Size;
+	Ar << Pack.DeadBytes;
+	Ar << Pack.bSealed;
+	return Ar;
+}
+
+namespace
+{
+	bool SerializePackHeader(FArchive& Ar)
+	{
+		uint32 Magic = SUBSTANCEPACK_MAGIC;
+		uint32 Version = SUBSTANCEPACK_VERSION;
+
+		Ar << Magic;
+		Ar << Version;
+
+		return !Ar.IsError() && Magic == SUBSTANCEPACK_MAGIC && Version == SUBSTANCEPACK_VERSION;
+	}
+}
+
+SubstanceCachePackStorage::SubstanceCachePackStorage(bool bInCompress)
+	: SubstanceCacheStorage(bInCompress)
+	, CurrentPack(INDEX_NONE)
+	, bIndexDirty(false)
+	, AppendWriter(NULL)
+{
+}
+
+SubstanceCachePackStorage::~SubstanceCachePackStorage()
+{
+	delete AppendWriter;
+	AppendWriter = NULL;
+
+	CloseReaders();
+
+	if (bIndexDirty)
+	{
+		SaveIndex();
+	}
+}
+
+void SubstanceCachePackStorage::LoadIndex(TMap<FString, FCacheEntryInfo>& Infos)
+{
+	FScopeLock Lock(&Mutex);
+
+	Entries.Empty();
+	Packs.Empty();
+	CurrentPack = INDEX_NONE;
+
+	bool bValidIndex = false;
+	FArchive* Ar = IFileManager::Get().CreateFileReader(*GetIndexPath());
+
+	if (Ar)
+	{
+		uint32 Magic = 0;
+		uint32 Version = 0;
+		*Ar << Magic;
+		*Ar << Version;
+
+		if (Magic == SUBSTANCEPACK_INDEX_MAGIC && Version == SUBSTANCEPACK_INDEX_VERSION)
+		{
+			*Ar << CurrentPack;
+			*Ar << Packs;
+			*Ar << Entries;
+			bValidIndex = !Ar->IsError();
+		}
+
+		delete Ar;
+
+		if (!bValidIndex)
+		{
+			UE_LOG(LogSubstanceCachePack, Warning, TEXT("Out of date Substance cache index, packs will be scanned"));
+			Entries.Empty();
+			Packs.Empty();
+			CurrentPack = INDEX_NONE;
+		}
+	}
+
+	// packs the index knows about but which are gone
+	TArray<int32> MissingPacks;
+	for (auto ItPack = Packs.CreateIterator(); ItPack; ++ItPack)
+	{
+		if (IFileManager::Get().FileSize(*GetPackPath(ItPack.Key())) == INDEX_NONE)
+		{
+			MissingPacks.Add(ItPack.Key());
+		}
+	}
+
+	for (auto ItEntry = Entries.CreateIterator(); ItEntry; ++ItEntry)
+	{
+		if (MissingPacks.Contains(ItEntry.Value().Pack))
+		{
+			ItEntry.RemoveCurrent();
+		}
+	}
+
+	for (int32 Idx = 0; Idx < MissingPacks.Num(); ++Idx)
+	{
+		Packs.Remove(MissingPacks[Idx]);
+		bIndexDirty = true;
+	}
+
+	// recover entries written after the index was last saved
+	TArray<FString> Files;
+	const FString Directory = FPaths::GetPath(GetIndexPath());
+	IFileManager::Get().FindFiles(Files, *(Directory / TEXT("Cache_*.pack")), true, false);
+
+	for (int32 Idx = 0; Idx < Files.Num(); ++Idx)
+	{
+		const int32 Pack = FCString::Atoi(*FPaths::GetBaseFilename(Files[Idx]).RightChop(6));
+		const FPack* Known = Packs.Find(Pack);
+
+		if (Known)
+		{
+			if (IFileManager::Get().FileSize(*GetPackPath(Pack)) > Known->Size)
+			{
+				ScanPack(Pack, Known->Size);
+				bIndexDirty = true;
+			}
+		}
+		else if (bValidIndex)
+		{
+			// not referenced anymore, e.g. compacted while mapped
+			IFileManager::Get().Delete(*GetPackPath(Pack), false, false, true);
+		}
+		else
+		{
+			ScanPack(Pack, 0);
+			bIndexDirty = true;
+		}
+
+		CurrentPack = FMath::Max(CurrentPack, Pack);
+	}
+
+	for (auto ItEntry = Entries.CreateConstIterator(); ItEntry; ++ItEntry)
+	{
+		FCacheEntryInfo Info;
+		Info.Size = ItEntry.Value().Size;
+		Info.LastAccess = ItEntry.Value().LastAccess;
+		Infos.Add(ItEntry.Key(), Info);
+	}
+}
+
+bool SubstanceCachePackStorage::ScanPack(int32 Pack, int64 From)
+{
+	FArchive* Ar = IFileManager::Get().CreateFileReader(*GetPackPath(Pack), FILEREAD_AllowWrite);
+
+	if (!Ar)
+	{
+		return false;
+	}
+
+	if (From == 0)
+	{
+		if (!SerializePackHeader(*Ar))
+		{
+			delete Ar;
+			IFileManager::Get().Delete(*GetPackPath(Pack), false, false, true);
+			return false;
+		}
+
+		FPack NewPack;
+		NewPack.Size = Ar->Tell();
+		NewPack.DeadBytes = 0;
+		NewPack.bSealed = false;
+		Packs.Add(Pack, NewPack);
+	}
+
+	const int64 TotalSize = Ar->TotalSize();
+	bool bComplete = true;
+
+	Ar->Seek(Packs.FindChecked(Pack).Size);
+
+	while (Ar->Tell() < TotalSize)
+	{
+		FString Key;
+		int64 Size = 0;
+
+		*Ar << Key;
+		*Ar << Size;
+
+		if (Ar->IsError() || Size <= 0 || Ar->Tell() + Size > TotalSize)
+		{
+			// partial entry left by an interrupted write
+			bComplete = false;
+			break;
+		}
+
+		FEntry Entry;
+		Entry.Pack = Pack;
+		Entry.Offset = Ar->Tell();
+		Entry.Size = Size;
+		Entry.LastAccess = FDateTime::UtcNow();
+
+		const FEntry* Previous = Entries.Find(Key);
+		if (Previous)
+		{
+			Packs.FindChecked(Previous->Pack).DeadBytes += Previous->Size;
+		}
+
+		Entries.Add(Key, Entry);
+
+		Ar->Seek(Entry.Offset + Size);
+		Packs.FindChecked(Pack).Size = Ar->Tell();
+	}
+
+	delete Ar;
+
+	if (!bComplete)
+	{
+		// never append after garbage
+		Packs.FindChecked(Pack).bSealed = true;
+	}
+
+	return bComplete;
+}
+
+bool SubstanceCachePackStorage::ReadBuffered(const FString& Key, SubstanceTexture& Result, int32 MaxMipSize)
+{
+	FScopeLock Lock(&Mutex);
+
+	const FEntry* Entry = Entries.Find(Key);
+	if (!Entry)
+	{
+		return false;
+	}
+
+	FArchive* Ar = GetReader(Entry->Pack, Entry->Offset + Entry->Size);
+	if (!Ar)
+	{
+		return false;
+	}
+
+	Ar->Seek(Entry->Offset);
+
+	return SerializeTexture(*Ar, Result, false, MaxMipSize);
+}
+
+bool SubstanceCachePackStorage::ReadMapped(const FString& Key, FMappedFilePtr& View, SubstanceTexture& Result, int32 MaxMipSize)
+{
+	FScopeLock Lock(&Mutex);
+
+	const FEntry* Entry = Entries.Find(Key);
+	if (!Entry)
+	{
+		return false;
+	}
+
+	const int64 End = Entry->Offset + Entry->Size;
+	FMappedFilePtr* Found = Views.Find(Entry->Pack);
+
+	// remap once the pack has grown past the view
+	if (!Found || (*Found)->GetSize() < End)
+	{
+		FMappedFilePtr MappedFile(new SubstanceMappedFile);
+
+		if (!MappedFile->Open(GetPackPath(Entry->Pack)) || MappedFile->GetSize() < End)
+		{
+			return false;
+		}
+
+		Found = &Views.Add(Entry->Pack, MappedFile);
+	}
+
+	bool bAllocated = false;
+	if (!SerializeFromMemory((*Found)->GetData() + Entry->Offset, Entry->Size, Result, bAllocated, MaxMipSize))
+	{
+		return false;
+	}
+
+	// compressed entries are decompressed out of the view
+	if (!bAllocated)
+	{
+		View = *Found;
+	}
+
+	return true;
+}
+
+bool SubstanceCachePackStorage::Write(const FString& Key, SubstanceTexture& Texture)
+{
+	FArchive* Ar = GetAppendWriter();
+
+	if (!Ar)
+	{
+		return false;
+	}
+
+	// the size precedes the payload, whose compressed size is not known
+	// before serializing it
+	TArray<uint8> Payload;
+	FMemoryWriter PayloadWriter(Payload);
+	SerializeTexture(PayloadWriter, Texture, bCompress);
+
+	FString EntryKey = Key;
+	int64 Size = Payload.Num();
+
+	*Ar << EntryKey;
+	*Ar << Size;
+
+	FEntry Entry;
+	Entry.Pack = CurrentPack;
+	Entry.Offset = Ar->Tell();
+	Entry.Size = Size;
+	Entry.LastAccess = FDateTime::UtcNow();
+
+	Ar->Serialize(Payload.GetData(), Payload.Num());
+
+	// readers open their own handles, the entry must be on disk
+	// before it is published
+	Ar->Flush();
+
+	FScopeLock Lock(&Mutex);
+
+	if (Ar->IsError())
+	{
+		UE_LOG(LogSubstanceCachePack, Warning, TEXT("Failed to append to Substance cache pack %d"), CurrentPack);
+
+		Packs.FindChecked(CurrentPack).bSealed = true;
+		delete AppendWriter;
+		AppendWriter = NULL;
+		bIndexDirty = true;
+
+		return false;
+	}
+
+	const FEntry* Previous = Entries.Find(Key);
+	if (Previous)
+	{
+		Packs.FindChecked(Previous->Pack).DeadBytes += Previous->Size;
+	}
+
+	Entries.Add(Key, Entry);
+	Packs.FindChecked(CurrentPack).Size = Ar->Tell();
+	bIndexDirty = true;
+
+	return true;
+}
+
+void SubstanceCachePackStorage::Flush()
+{
+	int64 TotalBytes = 0;
+	int64 DeadBytes = 0;
+
+	{
+		FScopeLock Lock(&Mutex);
+
+		for (auto ItPack = Packs.CreateConstIterator(); ItPack; ++ItPack)
+		{
+			TotalBytes += ItPack.Value().Size;
+			DeadBytes += ItPack.Value().DeadBytes;
+		}
+	}
+
+	if (DeadBytes > SUBSTANCEPACK_COMPACT_MIN_BYTES && DeadBytes * 2 > TotalBytes)
+	{
+		Compact();
+	}
+
+	if (bIndexDirty)
+	{
+		SaveIndex();
+	}
+}
+
+void SubstanceCachePackStorage::Remove(const FString& Key)
+{
+	FScopeLock Lock(&Mutex);
+
+	const FEntry* Entry = Entries.Find(Key);
+	if (Entry)
+	{
+		Packs.FindChecked(Entry->Pack).DeadBytes += Entry->Size;
+		Entries.Remove(Key);
+		bIndexDirty = true;
+	}
+}
+
+void SubstanceCachePackStorage::Touch(const FString& Key, const FDateTime& Time)
+{
+	FScopeLock Lock(&Mutex);
+
+	FEntry* Entry = Entries.Find(Key);
+	if (Entry)
+	{
+		Entry->LastAccess = Time;
+		bIndexDirty = true;
+	}
+}
+
+void SubstanceCachePackStorage::SortByLocation(TArray<FString>& Keys)
+{
+	FScopeLock Lock(&Mutex);
+
+	const TMap<FString, FEntry>& Locations = Entries;
+	Keys.Sort([&Locations](const FString& A, const FString& B)
+	{
+		const FEntry* EntryA = Locations.Find(A);
+		const FEntry* EntryB = Locations.Find(B);
+
+		// unknown keys fail to read anyway, keep them last
+		if (NULL == EntryA || NULL == EntryB)
+		{
+			return EntryA != NULL;
+		}
+
+		return EntryA->Pack != EntryB->Pack ? EntryA->Pack < EntryB->Pack : EntryA->Offset < EntryB->Offset;
+	});
+}
+
+FString SubstanceCachePackStorage::GetPackPath(int32 Pack) const
+{
+	return FString::Printf(TEXT("%s/Substance/Cache_%d.pack"), *FPaths::GameSavedDir(), Pack);
+}
+
+FString SubstanceCachePackStorage::GetIndexPath() const
+{
+	return FString::Printf(TEXT("%s/Substance/Cache.index"), *FPaths::GameSavedDir());
+}
+
+void SubstanceCachePackStorage::SaveIndex()
+{
+	FScopeLock Lock(&Mutex);
+
+	const FString Path = GetIndexPath();
+	const FString TempPath = Path + TEXT(".tmp");
+
+	FArchive* Ar = IFileManager::Get().CreateFileWriter(*TempPath, 0);
+	if (!Ar)
+	{
+		return;
+	}
+
+	uint32 Magic = SUBSTANCEPACK_INDEX_MAGIC;
+	uint32 Version = SUBSTANCEPACK_INDEX_VERSION;
+
+	*Ar << Magic;
+	*Ar << Version;
+	*Ar << CurrentPack;
+	*Ar << Packs;
+	*Ar << Entries;
+
+	const bool bWritten = Ar->Close();
+	delete Ar;
+
+	if (bWritten && IFileManager::Get().Move(*Path, *TempPath, true, true))
+	{
+		bIndexDirty = false;
+	}
+	else
+	{
+		IFileManager::Get().Delete(*TempPath, false, false, true);
+	}
+}
+
+void SubstanceCachePackStorage::Compact()
+{
+	delete AppendWriter;
+	AppendWriter = NULL;
+
+	// live entries, sorted to read the old packs sequentially
+	TArray<TPair<FString, FEntry>> Live;
+	int32 NewPack = 0;
+
+	{
+		FScopeLock Lock(&Mutex);
+
+		for (auto ItEntry = Entries.CreateConstIterator(); ItEntry; ++ItEntry)
+		{
+			TPair<FString, FEntry> Pair;
+			Pair.Key = ItEntry.Key();
+			Pair.Value = ItEntry.Value();
+			Live.Add(Pair);
+		}
+
+		for (auto ItPack = Packs.CreateConstIterator(); ItPack; ++ItPack)
+		{
+			NewPack = FMath::Max(NewPack, ItPack.Key() + 1);
+		}
+	}
+
+	Live.Sort([](const TPair<FString, FEntry>& A, const TPair<FString, FEntry>& B)
+	{
+		return A.Value.Pack != B.Value.Pack ? A.Value.Pack < B.Value.Pack : A.Value.Offset < B.Value.Offset;
+	});
+
+	FArchive* Writer = IFileManager::Get().CreateFileWriter(*GetPackPath(NewPack), FILEWRITE_AllowRead);
+	if (!Writer)
+	{
+		return;
+	}
+
+	SerializePackHeader(*Writer);
+
+	// new location of Live[Idx], Size is 0 when not copied
+	TArray<FEntry> Moved;
+	Moved.AddZeroed(Live.Num());
+
+	TArray<uint8> Chunk;
+	Chunk.SetNumUninitialized(1024 * 1024);
+
+	FArchive* Source = NULL;
+	int32 SourcePack = INDEX_NONE;
+
+	for (int32 Idx = 0; Idx < Live.Num(); ++Idx)
+	{
+		const FEntry& Entry = Live[Idx].Value;
+
+		if (Entry.Pack != SourcePack)
+		{
+			delete Source;
+			Source = IFileManager::Get().CreateFileReader(*GetPackPath(Entry.Pack), FILEREAD_AllowWrite);
+			SourcePack = Entry.Pack;
+		}
+
+		if (!Source)
+		{
+			continue;
+		}
+
+		FString Key = Live[Idx].Key;
+		int64 Size = Entry.Size;
+
+		*Writer << Key;
+		*Writer << Size;
+
+		FEntry& MovedEntry = Moved[Idx];
+		MovedEntry.Pack = NewPack;
+		MovedEntry.Offset = Writer->Tell();
+		MovedEntry.Size = Size;
+
+		Source->Seek(Entry.Offset);
+
+		for (int64 Copied = 0; Copied < Size;)
+		{
+			const int64 Count = FMath::Min<int64>(Chunk.Num(), Size - Copied);
+			Source->Serialize(Chunk.GetData(), Count);
+			Writer->Serialize(Chunk.GetData(), Count);
+			Copied += Count;
+		}
+	}
+
+	delete Source;
+
+	const int64 NewPackSize = Writer->Tell();
+	const bool bWritten = Writer->Close();
+	delete Writer;
+
+	if (!bWritten)
+	{
+		UE_LOG(LogSubstanceCachePack, Warning, TEXT("Failed to compact the Substance cache packs"));
+		IFileManager::Get().Delete(*GetPackPath(NewPack), false, false, true);
+		return;
+	}
+
+	TArray<int32> OldPacks;
+
+	{
+		FScopeLock Lock(&Mutex);
+
+		FPack Pack;
+		Pack.Size = NewPackSize;
+		Pack.DeadBytes = 0;
+		Pack.bSealed = false;
+
+		for (int32 Idx = 0; Idx < Live.Num(); ++Idx)
+		{
+			if (Moved[Idx].Size == 0)
+			{
+				continue;
+			}
+
+			const FEntry& Original = Live[Idx].Value;
+			const FEntry* Current = Entries.Find(Live[Idx].Key);
+
+			// removed or replaced while compacting
+			if (!Current || Current->Pack != Original.Pack || Current->Offset != Original.Offset)
+			{
+				Pack.DeadBytes += Moved[Idx].Size;
+				continue;
+			}
+
+			// touched while compacting
+			Moved[Idx].LastAccess = Current->LastAccess;
+			Entries.Add(Live[Idx].Key, Moved[Idx]);
+		}
+
+		for (auto ItPack = Packs.CreateConstIterator(); ItPack; ++ItPack)
+		{
+			OldPacks.Add(ItPack.Key());
+		}
+
+		Packs.Empty();
+		Packs.Add(NewPack, Pack);
+		CurrentPack = NewPack;
+		bIndexDirty = true;
+
+		CloseReaders();
+	}
+
+	SaveIndex();
+
+	// packs still mapped by pending reads are removed on next startup
+	for (int32 Idx = 0; Idx < OldPacks.Num(); ++Idx)
+	{
+		IFileManager::Get().Delete(*GetPackPath(OldPacks[Idx]), false, false, true);
+	}
+
+	UE_LOG(LogSubstanceCachePack, Log, TEXT("Compacted the Substance cache into pack %d (%lld bytes)"), NewPack, NewPackSize);
+}
+
+void SubstanceCachePackStorage::CloseReaders()
+{
+	for (auto ItReader = Readers.CreateIterator(); ItReader; ++ItReader)
+	{
+		delete ItReader.Value();
+	}
+
+	Readers.Empty();
+	Views.Empty();
+}
+
+FArchive* SubstanceCachePackStorage::GetAppendWriter()
+{
+	if (AppendWriter)
+	{
+		return AppendWriter;
+	}
+
+	FScopeLock Lock(&Mutex);
+
+	const FPack* Pack = Packs.Find(CurrentPack);
+
+	if (Pack && !Pack->bSealed && Pack->Size < SUBSTANCEPACK_MAX_SIZE)
+	{
+		AppendWriter = IFileManager::Get().CreateFileWriter(*GetPackPath(CurrentPack), FILEWRITE_Append | FILEWRITE_AllowRead);
+
+		if (AppendWriter && AppendWriter->Tell() == Pack->Size)
+		{
+			return AppendWriter;
+		}
+
+		// the pack does not end where the index says it does
+		delete AppendWriter;
+		AppendWriter = NULL;
+		Packs.FindChecked(CurrentPack).bSealed = true;
+	}
+
+	int32 NewPack = 0;
+	for (auto ItPack = Packs.CreateConstIterator(); ItPack; ++ItPack)
+	{
+		NewPack = FMath::Max(NewPack, ItPack.Key() + 1);
+	}
+
+	AppendWriter = IFileManager::Get().CreateFileWriter(*GetPackPath(NewPack), FILEWRITE_AllowRead);
+
+	if (!AppendWriter)
+	{
+		return NULL;
+	}
+
+	SerializePackHeader(*AppendWriter);
+
+	FPack NewPackState;
+	NewPackState.Size = AppendWriter->Tell();
+	NewPackState.DeadBytes = 0;
+	NewPackState.bSealed = false;
+
+	Packs.Add(NewPack, NewPackState);
+	CurrentPack = NewPack;
+	bIndexDirty = true;
+
+	return AppendWriter;
+}
+
+FArchive* SubstanceCachePackStorage::GetReader(int32 Pack, int64 End)
+{
+	FArchive** Found = Readers.Find(Pack);
+
+	// reopen once the pack has grown past the size seen at open
+	if (Found && (*Found)->TotalSize() >= End)
+	{
+		return *Found;
+	}
+
+	if (Found)
+	{
+		delete *Found;
+		Readers.Remove(Pack);
+	}
+
+	FArchive* Reader = IFileManager::Get().CreateFileReader(*GetPackPath(Pack), FILEREAD_AllowWrite);
+
+	if (!Reader || Reader->TotalSize() < End)
+	{
+		delete Reader;
+		return NULL;
+	}
+
+	Readers.Add(Pack, Reader);
+
+	return Reader;
+}
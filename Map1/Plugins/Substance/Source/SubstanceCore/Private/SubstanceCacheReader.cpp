@@ -0,0 +1,269 @@
+//! @file SubstanceCacheReader.cpp
+//! @brief Background reading of Substance cache entries
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceCacheReader.h"
+#include "SubstanceCacheStorage.h"
+#include "SubstanceCoreHelpers.h"
+
+using namespace Substance;
+
+FCacheReadRequest::FCacheReadRequest(graph_inst_t* InGraph, bool bInMapped)
+	: Graph(InGraph)
+	, Bytes(0)
+	, MaxMipSize(0)
+	, bMapped(bInMapped)
+	, bPrefetch(false)
+	, bSucceeded(false)
+{
+}
+
+FCacheReadRequest::~FCacheReadRequest()
+{
+	for (int32 Idx = 0; Idx < Textures.Num(); ++Idx)
+	{
+		if (!MappedFiles[Idx].IsValid())
+		{
+			FMemory::Free(Textures[Idx].buffer);
+		}
+	}
+
+	// views are released with MappedFiles
+	Textures.Empty();
+	MappedFiles.Empty();
+}
+
+SubstanceCacheReader::SubstanceCacheReader(SubstanceCacheStorage& InStorage, int64 InMaxInFlightBytes)
+	: Storage(InStorage)
+	, MaxInFlightBytes(InMaxInFlightBytes)
+	, Current(NULL)
+	, InFlightBytes(0)
+	, OutstandingCount(0)
+{
+	WorkEvent = FPlatformProcess::CreateSynchEvent();
+	CompletedEvent = FPlatformProcess::CreateSynchEvent();
+	Thread = FRunnableThread::Create(this, TEXT("SubstanceCacheReader"), 0, TPri_BelowNormal);
+}
+
+SubstanceCacheReader::~SubstanceCacheReader()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = NULL;
+	}
+
+	for (int32 Idx = 0; Idx < Pending.Num(); ++Idx)
+	{
+		delete Pending[Idx];
+	}
+
+	for (int32 Idx = 0; Idx < Completed.Num(); ++Idx)
+	{
+		delete Completed[Idx];
+	}
+
+	Pending.Empty();
+	Completed.Empty();
+
+	delete WorkEvent;
+	delete CompletedEvent;
+}
+
+void SubstanceCacheReader::Enqueue(FCacheReadRequest* Request)
+{
+	{
+		FScopeLock Lock(&Mutex);
+		Pending.Add(Request);
+		++OutstandingCount;
+	}
+
+	WorkEvent->Trigger();
+}
+
+void SubstanceCacheReader::Cancel(graph_inst_t* Graph)
+{
+	FScopeLock Lock(&Mutex);
+
+	for (int32 Idx = Pending.Num() - 1; Idx >= 0; --Idx)
+	{
+		if (Pending[Idx]->Graph == Graph)
+		{
+			delete Pending[Idx];
+			Pending.RemoveAt(Idx);
+			--OutstandingCount;
+		}
+	}
+
+	if (Current && Current->Graph == Graph)
+	{
+		Current->Cancelled.Increment();
+	}
+
+	for (int32 Idx = 0; Idx < Completed.Num(); ++Idx)
+	{
+		if (Completed[Idx]->Graph == Graph)
+		{
+			Completed[Idx]->Cancelled.Increment();
+		}
+	}
+}
+
+void SubstanceCacheReader::CancelAll()
+{
+	FScopeLock Lock(&Mutex);
+
+	for (int32 Idx = 0; Idx < Pending.Num(); ++Idx)
+	{
+		delete Pending[Idx];
+		--OutstandingCount;
+	}
+	Pending.Empty();
+
+	if (Current)
+	{
+		Current->Cancelled.Increment();
+	}
+
+	for (int32 Idx = 0; Idx < Completed.Num(); ++Idx)
+	{
+		Completed[Idx]->Cancelled.Increment();
+	}
+}
+
+void SubstanceCacheReader::GetCompleted(TArray<FCacheReadRequest*>& Requests)
+{
+	FScopeLock Lock(&Mutex);
+	Requests.Append(Completed);
+	Completed.Empty();
+}
+
+void SubstanceCacheReader::Release(FCacheReadRequest* Request)
+{
+	{
+		FScopeLock Lock(&Mutex);
+		InFlightBytes -= Request->Bytes;
+		--OutstandingCount;
+	}
+
+	delete Request;
+
+	// the reader may be waiting for some budget
+	WorkEvent->Trigger();
+}
+
+bool SubstanceCacheReader::IsIdle() const
+{
+	FScopeLock Lock(&Mutex);
+	return OutstandingCount == 0;
+}
+
+void SubstanceCacheReader::WaitForCompleted(uint32 WaitTimeMs)
+{
+	CompletedEvent->Wait(WaitTimeMs);
+}
+
+uint32 SubstanceCacheReader::Run()
+{
+	while (StopTaskCounter.GetValue() == 0)
+	{
+		FCacheReadRequest* Request = NULL;
+
+		{
+			FScopeLock Lock(&Mutex);
+
+			if (Pending.Num() && InFlightBytes < MaxInFlightBytes)
+			{
+				Request = Pending[0];
+				Pending.RemoveAt(0);
+				Current = Request;
+			}
+		}
+
+		if (NULL == Request)
+		{
+			WorkEvent->Wait();
+			continue;
+		}
+
+		Read(Request);
+
+		{
+			FScopeLock Lock(&Mutex);
+			Current = NULL;
+			InFlightBytes += Request->Bytes;
+			Completed.Add(Request);
+		}
+
+		CompletedEvent->Trigger();
+	}
+
+	return 0;
+}
+
+void SubstanceCacheReader::Stop()
+{
+	StopTaskCounter.Increment();
+	WorkEvent->Trigger();
+}
+
+void SubstanceCacheReader::Read(FCacheReadRequest* Request)
+{
+	Request->bSucceeded = true;
+
+	for (int32 Idx = 0; Idx < Request->Keys.Num(); ++Idx)
+	{
+		if (Request->Cancelled.GetValue() != 0 || StopTaskCounter.GetValue() != 0)
+		{
+			Request->bSucceeded = false;
+			return;
+		}
+
+		SubstanceTexture Texture;
+		FMemory::MemZero(Texture);
+
+		bool bRead = false;
+		FMappedFilePtr View;
+
+		if (Request->bMapped)
+		{
+			bRead = Storage.ReadMapped(Request->Keys[Idx], View, Texture, Request->MaxMipSize);
+		}
+		else
+		{
+			bRead = Storage.ReadBuffered(Request->Keys[Idx], Texture, Request->MaxMipSize);
+		}
+
+		if (!bRead && Request->bPrefetch)
+		{
+			Request->Keys.RemoveAt(Idx--);
+			continue;
+		}
+
+		if (!bRead)
+		{
+			Request->bSucceeded = false;
+			return;
+		}
+
+		EPixelFormat Format = Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)Texture.pixelFormat);
+		const SIZE_T Size = CalcTextureSize(Texture.level0Width, Texture.level0Height, Format, Texture.mipmapCount);
+
+		if (View.IsValid())
+		{
+			// fault the pages in here so that the game thread
+			// only copies from memory
+			const uint8* Data = (const uint8*)Texture.buffer;
+			volatile uint8 Sum = 0;
+			for (SIZE_T Offset = 0; Offset < Size; Offset += 4096)
+			{
+				Sum += Data[Offset];
+			}
+		}
+
+		Request->Textures.Add(Texture);
+		Request->MappedFiles.Add(View);
+		Request->Bytes += Size;
+	}
+}
@@ -0,0 +1,104 @@
+//! @file SubstanceCacheReader.h
+//! @brief Background reading of Substance cache entries
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+#include "substance_public.h"
+#include "SubstanceCacheMapping.h"
+
+namespace Substance
+{
+	class SubstanceCacheStorage;
+
+	//! @brief Cached outputs of one graph instance, read by the reader thread
+	struct FCacheReadRequest
+	{
+		FCacheReadRequest(graph_inst_t* InGraph, bool bInMapped);
+		~FCacheReadRequest();
+
+		//! @brief Instance the outputs belong to, NULL for prefetches
+		//! @note Only used as an identifier outside of the game thread
+		graph_inst_t* Graph;
+
+		TArray<uint32> OutputUids;
+		TArray<FString> Keys;
+
+		//! @brief Loaded outputs, in the same order than OutputUids
+		TArray<SubstanceTexture> Textures;
+
+		//! @brief View each texture points into, invalid when its buffer
+		//! was allocated (buffered reads or compressed entries)
+		TArray<FMappedFilePtr> MappedFiles;
+
+		//! @brief Amount of memory held by the loaded outputs
+		int64 Bytes;
+
+		//! @brief Only read the mips no larger than this, 0 reads whole chains
+		int32 MaxMipSize;
+
+		bool bMapped;
+
+		//! @brief Entries read ahead of their use, unreadable ones are
+		//! dropped from Keys instead of failing the request
+		bool bPrefetch;
+
+		bool bSucceeded;
+		FThreadSafeCounter Cancelled;
+	};
+
+	//! @brief Worker thread loading cache entries of whole graph instances
+	//! @note Stops picking new requests while the loaded but not yet
+	//! released requests exceed the in-flight budget
+	class SubstanceCacheReader : public FRunnable
+	{
+	public:
+		SubstanceCacheReader(SubstanceCacheStorage& Storage, int64 MaxInFlightBytes);
+		virtual ~SubstanceCacheReader();
+
+		//! @brief Queue a request, the reader takes ownership
+		void Enqueue(FCacheReadRequest* Request);
+
+		//! @brief Drop the requests of this instance
+		//! @note Requests being read or already read are flagged as cancelled
+		void Cancel(graph_inst_t* Graph);
+
+		void CancelAll();
+
+		//! @brief Grab the requests whose read is over
+		//! @post Ownership is given to the caller, who must call Release
+		void GetCompleted(TArray<FCacheReadRequest*>& Requests);
+
+		//! @brief Free a completed request and give its bytes back to the budget
+		void Release(FCacheReadRequest* Request);
+
+		//! @brief Tell if every request has been released
+		bool IsIdle() const;
+
+		//! @brief Block until a request completes or the timeout expires
+		void WaitForCompleted(uint32 WaitTimeMs);
+
+		// FRunnable interface
+		virtual uint32 Run() override;
+		virtual void Stop() override;
+
+	private:
+		void Read(FCacheReadRequest* Request);
+
+		SubstanceCacheStorage& Storage;
+		const int64 MaxInFlightBytes;
+
+		mutable FCriticalSection Mutex;
+		TArray<FCacheReadRequest*> Pending;
+		TArray<FCacheReadRequest*> Completed;
+		FCacheReadRequest* Current;
+
+		//! @brief Bytes held by completed requests not released yet
+		int64 InFlightBytes;
+		int32 OutstandingCount;
+
+		FEvent* WorkEvent;
+		FEvent* CompletedEvent;
+		FThreadSafeCounter StopTaskCounter;
+		FRunnableThread* Thread;
+	};
+}
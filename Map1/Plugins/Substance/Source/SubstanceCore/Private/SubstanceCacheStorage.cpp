@@ -0,0 +1,681 @@
+//! @file SubstanceCacheStorage.cpp
+//! @brief Substance cache entry serialization and per-file storage
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceCacheStorage.h"
+#include "SubstanceCoreHelpers.h"
+
+#include "Paths.h"
+
+#define SUBSTANCECACHE_VERSION 3
+
+//! @brief Mips smaller than this are (de)compressed without a task
+#define SUBSTANCECACHE_CHUNK_TASK_MIN_BYTES (64 * 1024)
+
+//! @brief Larger mips are split in chunks of this size, so that the top
+//! mip of a large output is not (de)compressed by a single task
+#define SUBSTANCECACHE_CHUNK_MAX_BYTES (1024 * 1024)
+
+DEFINE_LOG_CATEGORY_STATIC(LogSubstanceCacheStorage, Log, All);
+
+using namespace Substance;
+
+//! @brief Bytes read or decompressed into allocated buffers
+static volatile int64 GCopiedBytes = 0;
+
+namespace
+{
+	//! @brief A mip, or a part of a mip, to compress or decompress
+	struct FMipChunk
+	{
+		const uint8* Source;
+		int32 SourceSize;
+		uint8* Dest;
+		int32 DestSize;
+
+		//! @brief Bytes written to Dest, INDEX_NONE on failure
+		int32 Result;
+	};
+
+	//! @brief Compressed chunks which did not shrink are stored raw
+	void CompressChunk(FMipChunk& Chunk)
+	{
+		int32 CompressedSize = Chunk.DestSize;
+
+		if (FCompression::CompressMemory((ECompressionFlags)(COMPRESS_ZLIB | COMPRESS_BiasSpeed),
+				Chunk.Dest, CompressedSize, Chunk.Source, Chunk.SourceSize) &&
+			CompressedSize < Chunk.SourceSize)
+		{
+			Chunk.Result = CompressedSize;
+		}
+		else
+		{
+			FMemory::Memcpy(Chunk.Dest, Chunk.Source, Chunk.SourceSize);
+			Chunk.Result = Chunk.SourceSize;
+		}
+	}
+
+	void DecompressChunk(FMipChunk& Chunk)
+	{
+		if (Chunk.SourceSize == Chunk.DestSize)
+		{
+			FMemory::Memcpy(Chunk.Dest, Chunk.Source, Chunk.SourceSize);
+			Chunk.Result = Chunk.DestSize;
+		}
+		else if (FCompression::UncompressMemory(COMPRESS_ZLIB, Chunk.Dest, Chunk.DestSize, Chunk.Source, Chunk.SourceSize))
+		{
+			Chunk.Result = Chunk.DestSize;
+		}
+		else
+		{
+			Chunk.Result = INDEX_NONE;
+		}
+	}
+
+	class FMipChunkTask
+	{
+	public:
+		FMipChunkTask(FMipChunk& InChunk, bool bInCompress)
+			: Chunk(InChunk)
+			, bCompress(bInCompress)
+		{
+		}
+
+		static const TCHAR* GetTaskName()
+		{
+			return TEXT("FSubstanceMipChunkTask");
+		}
+
+		FORCEINLINE TStatId GetStatId() const
+		{
+			RETURN_QUICK_DECLARE_CYCLE_STAT(FSubstanceMipChunkTask, STATGROUP_TaskGraphTasks);
+		}
+
+		static ENamedThreads::Type GetDesiredThread()
+		{
+			return ENamedThreads::AnyThread;
+		}
+
+		static ESubsequentsMode::Type GetSubsequentsMode()
+		{
+			return ESubsequentsMode::TrackSubsequents;
+		}
+
+		void DoTask(ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+		{
+			if (bCompress)
+			{
+				CompressChunk(Chunk);
+			}
+			else
+			{
+				DecompressChunk(Chunk);
+			}
+		}
+
+	private:
+		FMipChunk& Chunk;
+		bool bCompress;
+	};
+
+	//! @brief Process the large mips on task threads and the tail on this one
+	//! @pre Chunks is not resized until this returns
+	void ProcessChunks(TArray<FMipChunk>& Chunks, bool bCompress)
+	{
+		FGraphEventArray Tasks;
+
+		for (int32 Idx = 0; Idx < Chunks.Num(); ++Idx)
+		{
+			if (Chunks[Idx].DestSize >= SUBSTANCECACHE_CHUNK_TASK_MIN_BYTES)
+			{
+				Tasks.Add(TGraphTask<FMipChunkTask>::CreateTask().ConstructAndDispatchWhenReady(Chunks[Idx], bCompress));
+			}
+			else if (bCompress)
+			{
+				CompressChunk(Chunks[Idx]);
+			}
+			else
+			{
+				DecompressChunk(Chunks[Idx]);
+			}
+		}
+
+		if (Tasks.Num() > 0)
+		{
+			FTaskGraphInterface::Get().WaitUntilTasksComplete(Tasks);
+		}
+	}
+
+	//! @brief Raw size of each chunk of the mips
+	//! @param MipFirstChunks Index of the first chunk of each mip, plus the chunks count
+	void SplitMips(const TArray<int32>& MipBytes, TArray<int32>& ChunkBytes, TArray<int32>& MipFirstChunks)
+	{
+		ChunkBytes.Empty();
+		MipFirstChunks.Empty(MipBytes.Num() + 1);
+
+		for (int32 Idx = 0; Idx < MipBytes.Num(); ++Idx)
+		{
+			MipFirstChunks.Add(ChunkBytes.Num());
+
+			for (int32 Offset = 0; Offset < MipBytes[Idx]; Offset += SUBSTANCECACHE_CHUNK_MAX_BYTES)
+			{
+				ChunkBytes.Add(FMath::Min(MipBytes[Idx] - Offset, SUBSTANCECACHE_CHUNK_MAX_BYTES));
+			}
+		}
+
+		MipFirstChunks.Add(ChunkBytes.Num());
+	}
+
+	//! @brief Stored size of each chunk, which can not exceed the raw size
+	bool SerializeChunkSizes(FArchive& Ar, const TArray<int32>& ChunkBytes, TArray<int32>& ChunkSizes)
+	{
+		if (Ar.IsLoading())
+		{
+			ChunkSizes.SetNumZeroed(ChunkBytes.Num());
+		}
+
+		for (int32 Idx = 0; Idx < ChunkBytes.Num(); ++Idx)
+		{
+			Ar << ChunkSizes[Idx];
+
+			if (ChunkSizes[Idx] <= 0 || ChunkSizes[Idx] > ChunkBytes[Idx])
+			{
+				return false;
+			}
+		}
+
+		return !Ar.IsError();
+	}
+
+	//! @brief Sum of the first Count sizes, all of them by default
+	int64 GetTotalSize(const TArray<int32>& Sizes, int32 Count = MAX_int32)
+	{
+		int64 Total = 0;
+		for (int32 Idx = 0; Idx < FMath::Min(Count, Sizes.Num()); ++Idx)
+		{
+			Total += Sizes[Idx];
+		}
+		return Total;
+	}
+}
+
+FCachedTexture::FCachedTexture(const SubstanceTexture& InTexture, const FMappedFilePtr& InView)
+	: Texture(InTexture)
+	, View(InView)
+{
+	Bytes = CalcTextureSize(Texture.level0Width, Texture.level0Height,
+		Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)Texture.pixelFormat),
+		Texture.mipmapCount);
+}
+
+FCachedTexture::~FCachedTexture()
+{
+	if (!View.IsValid())
+	{
+		FMemory::Free(Texture.buffer);
+	}
+}
+
+void SubstanceCacheStorage::SerializeHeader(FArchive& Ar, SubstanceTexture& Result, uint8& Codec, SIZE_T& BufferSize)
+{
+	Ar << Result.level0Width;
+	Ar << Result.level0Height;
+	Ar << Result.pixelFormat;
+	Ar << Result.channelsOrder;
+	Ar << Result.mipmapCount;
+	Ar << Codec;
+
+	EPixelFormat PixelFormat = Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)Result.pixelFormat);
+	BufferSize = CalcTextureSize(Result.level0Width, Result.level0Height, PixelFormat, Result.mipmapCount);
+}
+
+bool SubstanceCacheStorage::SerializeTexture(FArchive& Ar, SubstanceTexture& Result, bool bCompressMips, int32 MaxMipSize)
+{
+	uint8 Codec = bCompressMips ? CacheCodec_Zlib : CacheCodec_None;
+	SIZE_T BufferSize = 0;
+	SerializeHeader(Ar, Result, Codec, BufferSize);
+
+	if (Ar.IsError() || Codec > CacheCodec_Zlib)
+	{
+		return false;
+	}
+
+	TArray<int32> MipBytes;
+	GetMipBytes(Result, MipBytes);
+
+	TArray<int32> ChunkBytes;
+	TArray<int32> MipFirstChunks;
+	SplitMips(MipBytes, ChunkBytes, MipFirstChunks);
+
+	if (Ar.IsSaving())
+	{
+		if (Codec == CacheCodec_None)
+		{
+			Ar.Serialize(Result.buffer, BufferSize);
+		}
+		else
+		{
+			TArray<int32> ChunkSizes;
+			TArray<uint8> Chunks;
+			CompressMips(Result, ChunkSizes, Chunks);
+
+			SerializeChunkSizes(Ar, ChunkBytes, ChunkSizes);
+			Ar.Serialize(Chunks.GetData(), Chunks.Num());
+		}
+
+		return !Ar.IsError();
+	}
+
+	// mips above the requested size are skipped
+	const int32 FirstMip = GetFirstMip(Result, MaxMipSize);
+	const int32 FirstChunk = MipFirstChunks[FirstMip];
+	const int64 SkippedBytes = GetTotalSize(MipBytes, FirstMip);
+
+	check(Result.buffer == NULL);
+	Result.buffer = FMemory::Malloc(BufferSize - SkippedBytes);
+
+	bool bSuccess = true;
+
+	if (Codec == CacheCodec_None)
+	{
+		Ar.Seek(Ar.Tell() + SkippedBytes);
+		Ar.Serialize(Result.buffer, BufferSize - SkippedBytes);
+	}
+	else
+	{
+		TArray<int32> ChunkSizes;
+		bSuccess = SerializeChunkSizes(Ar, ChunkBytes, ChunkSizes);
+
+		if (bSuccess)
+		{
+			TArray<uint8> Chunks;
+			Chunks.SetNumUninitialized(GetTotalSize(ChunkSizes) - GetTotalSize(ChunkSizes, FirstChunk));
+
+			Ar.Seek(Ar.Tell() + GetTotalSize(ChunkSizes, FirstChunk));
+			Ar.Serialize(Chunks.GetData(), Chunks.Num());
+
+			// the kept mips are split the same way
+			SubstanceTexture Kept = Result;
+			TrimMips(Kept, FirstMip);
+			ChunkSizes.RemoveAt(0, FirstChunk);
+
+			bSuccess = !Ar.IsError() &&
+				DecompressMips(Kept, ChunkSizes, Chunks.GetData(), (uint8*)Result.buffer);
+		}
+	}
+
+	bSuccess = bSuccess && !Ar.IsError();
+
+	if (bSuccess)
+	{
+		FPlatformAtomics::InterlockedAdd(&GCopiedBytes, (int64)(BufferSize - SkippedBytes));
+		TrimMips(Result, FirstMip);
+	}
+	else
+	{
+		FMemory::Free(Result.buffer);
+		Result.buffer = NULL;
+	}
+
+	return bSuccess;
+}
+
+bool SubstanceCacheStorage::SerializeFromMemory(const uint8* Data, int64 Size, SubstanceTexture& Result, bool& bAllocated, int32 MaxMipSize)
+{
+	bAllocated = false;
+
+	// the buffer reader is sized w/ an int32
+	if (Size > MAX_int32)
+	{
+		UE_LOG(LogSubstanceCacheStorage, Warning, TEXT("Substance cache entry of %lld bytes is too large to be read from memory"), Size);
+		return false;
+	}
+
+	FBufferReader Ar((void*)Data, (int32)Size, false);
+
+	uint8 Codec = CacheCodec_None;
+	SIZE_T BufferSize = 0;
+	SerializeHeader(Ar, Result, Codec, BufferSize);
+
+	if (Ar.IsError() || Codec > CacheCodec_Zlib)
+	{
+		return false;
+	}
+
+	TArray<int32> MipBytes;
+	GetMipBytes(Result, MipBytes);
+
+	const int32 FirstMip = GetFirstMip(Result, MaxMipSize);
+
+	if (Codec == CacheCodec_None)
+	{
+		if (Ar.Tell() + (int64)BufferSize > Size)
+		{
+			return false;
+		}
+
+		Result.buffer = (void*)(Data + Ar.Tell() + GetTotalSize(MipBytes, FirstMip));
+		TrimMips(Result, FirstMip);
+
+		return true;
+	}
+
+	TArray<int32> ChunkBytes;
+	TArray<int32> MipFirstChunks;
+	SplitMips(MipBytes, ChunkBytes, MipFirstChunks);
+
+	TArray<int32> ChunkSizes;
+	if (!SerializeChunkSizes(Ar, ChunkBytes, ChunkSizes) || Ar.Tell() + GetTotalSize(ChunkSizes) > Size)
+	{
+		return false;
+	}
+
+	const int32 FirstChunk = MipFirstChunks[FirstMip];
+	const uint8* Chunks = Data + Ar.Tell() + GetTotalSize(ChunkSizes, FirstChunk);
+
+	Result.buffer = FMemory::Malloc(BufferSize - GetTotalSize(MipBytes, FirstMip));
+	TrimMips(Result, FirstMip);
+	ChunkSizes.RemoveAt(0, FirstChunk);
+
+	if (!DecompressMips(Result, ChunkSizes, Chunks, (uint8*)Result.buffer))
+	{
+		FMemory::Free(Result.buffer);
+		Result.buffer = NULL;
+		return false;
+	}
+
+	FPlatformAtomics::InterlockedAdd(&GCopiedBytes, (int64)(BufferSize - GetTotalSize(MipBytes, FirstMip)));
+	bAllocated = true;
+
+	return true;
+}
+
+int32 SubstanceCacheStorage::GetFirstMip(const SubstanceTexture& Texture, int32 MaxMipSize)
+{
+	if (MaxMipSize <= 0)
+	{
+		return 0;
+	}
+
+	TArray<FIntPoint> MipSizes;
+	Substance::Helpers::GetMipSizes(Texture, MipSizes);
+
+	for (int32 Idx = 0; Idx < MipSizes.Num(); ++Idx)
+	{
+		if (MipSizes[Idx].GetMax() <= MaxMipSize)
+		{
+			return Idx;
+		}
+	}
+
+	return FMath::Max(MipSizes.Num() - 1, 0);
+}
+
+void SubstanceCacheStorage::TrimMips(SubstanceTexture& Texture, int32 FirstMip)
+{
+	if (FirstMip <= 0)
+	{
+		return;
+	}
+
+	TArray<FIntPoint> MipSizes;
+	Substance::Helpers::GetMipSizes(Texture, MipSizes);
+
+	// the smaller mips keep the same layout from the new first mip
+	Texture.level0Width = MipSizes[FirstMip].X;
+	Texture.level0Height = MipSizes[FirstMip].Y;
+	Texture.mipmapCount -= FirstMip;
+}
+
+void SubstanceCacheStorage::GetMipBytes(const SubstanceTexture& Texture, TArray<int32>& MipBytes)
+{
+	const EPixelFormat Format = Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)Texture.pixelFormat);
+
+	TArray<FIntPoint> MipSizes;
+	Substance::Helpers::GetMipSizes(Texture, MipSizes);
+
+	MipBytes.Empty(MipSizes.Num());
+
+	for (int32 Idx = 0; Idx < MipSizes.Num(); ++Idx)
+	{
+		MipBytes.Add((int32)CalculateImageBytes(MipSizes[Idx].X, MipSizes[Idx].Y, 0, Format));
+	}
+}
+
+void SubstanceCacheStorage::CompressMips(const SubstanceTexture& Texture, TArray<int32>& ChunkSizes, TArray<uint8>& Chunks)
+{
+	TArray<int32> MipBytes;
+	GetMipBytes(Texture, MipBytes);
+
+	TArray<int32> ChunkBytes;
+	TArray<int32> MipFirstChunks;
+	SplitMips(MipBytes, ChunkBytes, MipFirstChunks);
+
+	// each chunk compresses in place of its raw copy, then chunks are packed
+	TArray<uint8> Staging;
+	Staging.SetNumUninitialized(GetTotalSize(ChunkBytes));
+
+	TArray<FMipChunk> Work;
+	Work.SetNumUninitialized(ChunkBytes.Num());
+
+	int64 Offset = 0;
+	for (int32 Idx = 0; Idx < ChunkBytes.Num(); ++Idx)
+	{
+		FMipChunk& Chunk = Work[Idx];
+		Chunk.Source = (const uint8*)Texture.buffer + Offset;
+		Chunk.SourceSize = ChunkBytes[Idx];
+		Chunk.Dest = Staging.GetData() + Offset;
+		Chunk.DestSize = ChunkBytes[Idx];
+		Chunk.Result = INDEX_NONE;
+		Offset += ChunkBytes[Idx];
+	}
+
+	ProcessChunks(Work, true);
+
+	ChunkSizes.Empty(Work.Num());
+	Chunks.Empty();
+
+	for (int32 Idx = 0; Idx < Work.Num(); ++Idx)
+	{
+		ChunkSizes.Add(Work[Idx].Result);
+		Chunks.Append(Work[Idx].Dest, Work[Idx].Result);
+	}
+}
+
+bool SubstanceCacheStorage::DecompressMips(const SubstanceTexture& Texture, const TArray<int32>& ChunkSizes, const uint8* Chunks, uint8* Dest)
+{
+	TArray<int32> MipBytes;
+	GetMipBytes(Texture, MipBytes);
+
+	TArray<int32> ChunkBytes;
+	TArray<int32> MipFirstChunks;
+	SplitMips(MipBytes, ChunkBytes, MipFirstChunks);
+
+	if (ChunkSizes.Num() != ChunkBytes.Num())
+	{
+		return false;
+	}
+
+	TArray<FMipChunk> Work;
+	Work.SetNumUninitialized(ChunkBytes.Num());
+
+	for (int32 Idx = 0; Idx < ChunkBytes.Num(); ++Idx)
+	{
+		FMipChunk& Chunk = Work[Idx];
+		Chunk.Source = Chunks;
+		Chunk.SourceSize = ChunkSizes[Idx];
+		Chunk.Dest = Dest;
+		Chunk.DestSize = ChunkBytes[Idx];
+		Chunk.Result = INDEX_NONE;
+
+		Chunks += ChunkSizes[Idx];
+		Dest += ChunkBytes[Idx];
+	}
+
+	ProcessChunks(Work, false);
+
+	for (int32 Idx = 0; Idx < Work.Num(); ++Idx)
+	{
+		if (Work[Idx].Result == INDEX_NONE)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int64 SubstanceCacheStorage::GetCopiedBytes()
+{
+	return FPlatformAtomics::InterlockedAdd(&GCopiedBytes, 0);
+}
+
+void SubstanceCacheFileStorage::LoadIndex(TMap<FString, FCacheEntryInfo>& Infos)
+{
+	IFileManager& FileManager = IFileManager::Get();
+
+	TArray<FString> Files;
+	const FString Directory = FString::Printf(TEXT("%s/Substance"), *FPaths::GameSavedDir());
+	FileManager.FindFiles(Files, *(Directory / TEXT("*.cache")), true, false);
+
+	for (int32 Idx = 0; Idx < Files.Num(); ++Idx)
+	{
+		const FString Path = Directory / Files[Idx];
+
+		FCacheEntryInfo Info;
+		Info.Size = FileManager.FileSize(*Path);
+		Info.LastAccess = FileManager.GetTimeStamp(*Path);
+
+		if (Info.Size > 0)
+		{
+			Infos.Add(FPaths::GetBaseFilename(Files[Idx]), Info);
+		}
+	}
+
+	//remove entries left over by an interrupted write
+	TArray<FString> TempFiles;
+	FileManager.FindFiles(TempFiles, *(Directory / TEXT("*.tmp")), true, false);
+
+	for (int32 Idx = 0; Idx < TempFiles.Num(); ++Idx)
+	{
+		FileManager.Delete(*(Directory / TempFiles[Idx]), false, false, true);
+	}
+}
+
+bool SubstanceCacheFileStorage::ReadBuffered(const FString& Key, SubstanceTexture& Result, int32 MaxMipSize)
+{
+	FArchive* Ar = IFileManager::Get().CreateFileReader(*GetPath(Key));
+
+	if (!Ar)
+	{
+		return false;
+	}
+
+	bool bSuccess = SerializeVersion(*Ar) && SerializeTexture(*Ar, Result, false, MaxMipSize);
+	delete Ar;
+
+	return bSuccess;
+}
+
+bool SubstanceCacheFileStorage::ReadMapped(const FString& Key, FMappedFilePtr& View, SubstanceTexture& Result, int32 MaxMipSize)
+{
+	const FString Path = GetPath(Key);
+
+	FMappedFilePtr MappedFile(new SubstanceMappedFile);
+	if (!MappedFile->Open(Path))
+	{
+		return false;
+	}
+
+	const int64 FileSize = MappedFile->GetSize();
+
+	// the buffer reader is sized w/ an int32
+	if (FileSize > MAX_int32)
+	{
+		UE_LOG(LogSubstanceCacheStorage, Warning, TEXT("Substance cache entry %s is too large to be mapped, will regenerate"), *Path);
+		return false;
+	}
+
+	FBufferReader Ar((void*)MappedFile->GetData(), (int32)FileSize, false);
+
+	if (!SerializeVersion(Ar))
+	{
+		return false;
+	}
+
+	bool bAllocated = false;
+	if (!SerializeFromMemory(MappedFile->GetData() + Ar.Tell(), FileSize - Ar.Tell(), Result, bAllocated, MaxMipSize))
+	{
+		UE_LOG(LogSubstanceCacheStorage, Warning, TEXT("Truncated Substance cache entry %s, will regenerate"), *Path);
+		return false;
+	}
+
+	// compressed entries are decompressed out of the view
+	if (!bAllocated)
+	{
+		View = MappedFile;
+	}
+
+	return true;
+}
+
+bool SubstanceCacheFileStorage::Write(const FString& Key, SubstanceTexture& Texture)
+{
+	IFileManager& FileManager = IFileManager::Get();
+
+	const FString Path = GetPath(Key);
+	const FString TempPath = Path + TEXT(".tmp");
+
+	bool bWritten = false;
+	FArchive* Ar = FileManager.CreateFileWriter(*TempPath, 0);
+
+	if (Ar)
+	{
+		bWritten = SerializeVersion(*Ar) && SerializeTexture(*Ar, Texture, bCompress);
+		bWritten = Ar->Close() && bWritten;
+		delete Ar;
+	}
+
+	// the entry only shows up once complete
+	if (bWritten)
+	{
+		bWritten = FileManager.Move(*Path, *TempPath, true, true);
+	}
+
+	if (!bWritten)
+	{
+		FileManager.Delete(*TempPath, false, false, true);
+	}
+
+	return bWritten;
+}
+
+void SubstanceCacheFileStorage::Remove(const FString& Key)
+{
+	IFileManager::Get().Delete(*GetPath(Key), false, false, true);
+}
+
+void SubstanceCacheFileStorage::Touch(const FString& Key, const FDateTime& Time)
+{
+	IFileManager::Get().SetTimeStamp(*GetPath(Key), Time);
+}
+
+FString SubstanceCacheFileStorage::GetPath(const FString& Key) const
+{
+	return FString::Printf(TEXT("%s/Substance/%s.cache"), *FPaths::GameSavedDir(), *Key);
+}
+
+bool SubstanceCacheFileStorage::SerializeVersion(FArchive& Ar) const
+{
+	uint32 Version = SUBSTANCECACHE_VERSION;
+
+	Ar << Version;
+
+	if (Ar.IsLoading() && Version != SUBSTANCECACHE_VERSION)
+	{
+		UE_LOG(LogSubstanceCacheStorage, Warning, TEXT("Out of date Substance cache entry, will regenerate"));
+		return false;
+	}
+
+	return !Ar.IsError();
+}
@@ -0,0 +1,218 @@
+//! @file SubstanceCacheStorage.h
+//! @brief Storage backends of the Substance cache
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+#include "substance_public.h"
+#include "SubstanceCacheMapping.h"
+
+class FArchive;
+
+namespace Substance
+{
+	//! @brief Size and last use of a stored entry
+	struct FCacheEntryInfo
+	{
+		int64 Size;
+		FDateTime LastAccess;
+	};
+
+	//! @brief Cached result shared between the memory tier, uploads and the writer thread
+	//! @note The buffer is freed with the last reference unless it points into View
+	struct FCachedTexture
+	{
+		FCachedTexture(const SubstanceTexture& InTexture, const FMappedFilePtr& InView = FMappedFilePtr());
+		~FCachedTexture();
+
+		SubstanceTexture Texture;
+		FMappedFilePtr View;
+
+		//! @brief Size of the mip chain
+		int64 Bytes;
+
+	private:
+		FCachedTexture(const FCachedTexture&);
+		FCachedTexture& operator=(const FCachedTexture&);
+	};
+
+	typedef TSharedPtr<FCachedTexture, ESPMode::ThreadSafe> FCachedTexturePtr;
+
+	//! @brief How the mip chain of an entry is stored
+	enum ECacheCodec
+	{
+		CacheCodec_None = 0,
+
+		//! @brief One zlib chunk per mip, mips which do not shrink are kept raw
+		CacheCodec_Zlib = 1
+	};
+
+	//! @brief Where and how cache entries are stored
+	//! @note LoadIndex is called from the game thread, reads from the reader
+	//! thread and writes, touches and removals from the writer thread
+	class SubstanceCacheStorage
+	{
+	public:
+		//! @param bCompress Compress the mip chains of the written entries
+		SubstanceCacheStorage(bool bInCompress) : bCompress(bInCompress) {}
+		virtual ~SubstanceCacheStorage() {}
+
+		//! @brief Gather the stored entries
+		virtual void LoadIndex(TMap<FString, FCacheEntryInfo>& Infos) = 0;
+
+		//! @brief Read an entry into a buffer allocated with FMemory::Malloc
+		//! @param MaxMipSize Only read the mips no larger than this, 0 reads the whole chain
+		virtual bool ReadBuffered(const FString& Key, SubstanceTexture& Result, int32 MaxMipSize = 0) = 0;
+
+		//! @brief Point Result.buffer into a mapped view of the entry
+		//! @post Result.buffer is valid as long as View is referenced
+		virtual bool ReadMapped(const FString& Key, FMappedFilePtr& View, SubstanceTexture& Result, int32 MaxMipSize = 0) = 0;
+
+		//! @brief Store an entry, replacing any previous entry with that key
+		virtual bool Write(const FString& Key, SubstanceTexture& Texture) = 0;
+
+		//! @brief Called after each batch of writes
+		virtual void Flush() {}
+
+		//! @brief Drop an entry
+		virtual void Remove(const FString& Key) = 0;
+
+		//! @brief Record the last use of an entry
+		virtual void Touch(const FString& Key, const FDateTime& Time) = 0;
+
+		//! @brief Order keys the way their entries are laid out on disk
+		//! so that reading them in turn is sequential
+		virtual void SortByLocation(TArray<FString>& Keys) { Keys.Sort(); }
+
+		//! @brief Serialize the texture description and codec, return the size of the mip chain
+		static void SerializeHeader(FArchive& Ar, SubstanceTexture& Result, uint8& Codec, SIZE_T& BufferSize);
+
+		//! @brief Serialize the texture description and mip chain
+		//! @note The buffer is allocated when loading, bCompressMips is
+		//! only used when saving and MaxMipSize when loading
+		static bool SerializeTexture(FArchive& Ar, SubstanceTexture& Result, bool bCompressMips, int32 MaxMipSize = 0);
+
+		//! @brief Load an entry from memory, pointing Result.buffer into it
+		//! when the mips are not compressed
+		//! @param bAllocated Set when Result.buffer had to be allocated instead
+		//! @note Entries of 2GB or more are rejected
+		static bool SerializeFromMemory(const uint8* Data, int64 Size, SubstanceTexture& Result, bool& bAllocated, int32 MaxMipSize = 0);
+
+		//! @brief First mip no larger than MaxMipSize, 0 when MaxMipSize is 0
+		static int32 GetFirstMip(const SubstanceTexture& Texture, int32 MaxMipSize);
+
+		//! @brief Describe the chain as starting at FirstMip
+		static void TrimMips(SubstanceTexture& Texture, int32 FirstMip);
+
+		//! @brief Size in bytes of each mip of the chain
+		static void GetMipBytes(const SubstanceTexture& Texture, TArray<int32>& MipBytes);
+
+		//! @brief Compress each mip into its own chunks, in parallel
+		//! @param ChunkSizes Stored size of each chunk, equal to its size when raw
+		static void CompressMips(const SubstanceTexture& Texture, TArray<int32>& ChunkSizes, TArray<uint8>& Chunks);
+
+		//! @brief Decompress every chunk into the mip chain, in parallel
+		static bool DecompressMips(const SubstanceTexture& Texture, const TArray<int32>& ChunkSizes, const uint8* Chunks, uint8* Dest);
+
+		//! @brief Bytes read or decompressed into allocated buffers since startup,
+		//! mapped reads pointing into their view copy none
+		static int64 GetCopiedBytes();
+
+	protected:
+		const bool bCompress;
+	};
+
+	//! @brief One file per entry in Saved/Substance
+	//! @note Last uses are stored as the file modification times
+	class SubstanceCacheFileStorage : public SubstanceCacheStorage
+	{
+	public:
+		SubstanceCacheFileStorage(bool bInCompress) : SubstanceCacheStorage(bInCompress) {}
+
+		virtual void LoadIndex(TMap<FString, FCacheEntryInfo>& Infos) override;
+		virtual bool ReadBuffered(const FString& Key, SubstanceTexture& Result, int32 MaxMipSize = 0) override;
+		virtual bool ReadMapped(const FString& Key, FMappedFilePtr& View, SubstanceTexture& Result, int32 MaxMipSize = 0) override;
+		virtual bool Write(const FString& Key, SubstanceTexture& Texture) override;
+		virtual void Remove(const FString& Key) override;
+		virtual void Touch(const FString& Key, const FDateTime& Time) override;
+
+	private:
+		FString GetPath(const FString& Key) const;
+
+		//! @brief Check the per-entry version
+		bool SerializeVersion(FArchive& Ar) const;
+	};
+
+	//! @brief Entries appended to a few pack files, located through an index
+	//! @note The index is loaded once and saved after each batch of writes
+	//! or touches,
+	//! packs are compacted once they mostly hold replaced or removed entries
+	class SubstanceCachePackStorage : public SubstanceCacheStorage
+	{
+	public:
+		SubstanceCachePackStorage(bool bInCompress);
+		virtual ~SubstanceCachePackStorage();
+
+		virtual void LoadIndex(TMap<FString, FCacheEntryInfo>& Infos) override;
+		virtual bool ReadBuffered(const FString& Key, SubstanceTexture& Result, int32 MaxMipSize = 0) override;
+		virtual bool ReadMapped(const FString& Key, FMappedFilePtr& View, SubstanceTexture& Result, int32 MaxMipSize = 0) override;
+		virtual bool Write(const FString& Key, SubstanceTexture& Texture) override;
+		virtual void Flush() override;
+		virtual void Remove(const FString& Key) override;
+		virtual void Touch(const FString& Key, const FDateTime& Time) override;
+		virtual void SortByLocation(TArray<FString>& Keys) override;
+
+		//! @brief Location of an entry payload
+		struct FEntry
+		{
+			int32 Pack;
+			int64 Offset;
+			int64 Size;
+			FDateTime LastAccess;
+		};
+
+		//! @brief State of a pack file
+		struct FPack
+		{
+			//! @brief Size covered by the index
+			int64 Size;
+
+			//! @brief Bytes of replaced or removed entries
+			int64 DeadBytes;
+
+			//! @brief Appends go to a new pack
+			bool bSealed;
+		};
+
+	private:
+		FString GetPackPath(int32 Pack) const;
+		FString GetIndexPath() const;
+
+		//! @brief Read the entries appended after the last saved index
+		//! @return False if the pack ends with a partial entry
+		bool ScanPack(int32 Pack, int64 From);
+
+		void SaveIndex();
+
+		//! @brief Rewrite live entries into a new pack and drop the old ones
+		void Compact();
+
+		//! @brief Close the handles and views on the packs
+		void CloseReaders();
+
+		//! @brief Open the pack new entries are appended to
+		FArchive* GetAppendWriter();
+
+		FArchive* GetReader(int32 Pack, int64 End);
+
+		FCriticalSection Mutex;
+
+		TMap<FString, FEntry> Entries;
+		TMap<int32, FPack> Packs;
+		int32 CurrentPack;
+		bool bIndexDirty;
+
+		FArchive* AppendWriter;
+		TMap<int32, FArchive*> Readers;
+		TMap<int32, FMappedFilePtr> Views;
+	};
+}
@@ -0,0 +1,195 @@
+//! @file SubstanceCacheWriter.cpp
+//! @brief Background writing of Substance cache entries
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceCacheWriter.h"
+#include "SubstanceCacheStorage.h"
+#include "SubstanceCoreStats.h"
+
+//! @brief Time given to other outputs of the same batch to be queued
+#define SUBSTANCECACHE_WRITE_COALESCE_MS 50
+
+//! @brief Queued amount above which a flush starts without waiting
+#define SUBSTANCECACHE_WRITE_BATCH_BYTES (32 * 1024 * 1024)
+
+DECLARE_MEMORY_STAT(TEXT("Cache Bytes Queued For Write"), STAT_SubstanceCacheQueuedBytes, STATGROUP_Substance);
+DECLARE_MEMORY_STAT(TEXT("Cache Bytes Written"), STAT_SubstanceCacheWrittenBytes, STATGROUP_Substance);
+
+using namespace Substance;
+
+SubstanceCacheWriter::SubstanceCacheWriter(SubstanceCacheStorage& InStorage)
+	: Storage(InStorage)
+	, QueuedBytes(0)
+	, WrittenBytes(0)
+{
+	WorkEvent = FPlatformProcess::CreateSynchEvent();
+	Thread = FRunnableThread::Create(this, TEXT("SubstanceCacheWriter"), 0, TPri_BelowNormal);
+}
+
+SubstanceCacheWriter::~SubstanceCacheWriter()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = NULL;
+	}
+
+	// in case the thread could not be created
+	Flush(Pending);
+
+	delete WorkEvent;
+}
+
+void SubstanceCacheWriter::Enqueue(const FString& Key, const FCachedTexturePtr& Texture)
+{
+	FWriteRequest Request;
+	Request.Operation = Op_Write;
+	Request.Key = Key;
+	Request.Texture = Texture;
+	Request.Bytes = Texture->Bytes;
+
+	FPlatformAtomics::InterlockedAdd(&QueuedBytes, Request.Bytes);
+	INC_MEMORY_STAT_BY(STAT_SubstanceCacheQueuedBytes, Request.Bytes);
+
+	Push(Request);
+}
+
+void SubstanceCacheWriter::EnqueueTouch(const FString& Key, const FDateTime& Time)
+{
+	FWriteRequest Request;
+	Request.Operation = Op_Touch;
+	Request.Key = Key;
+	Request.Time = Time;
+	Request.Bytes = 0;
+
+	Push(Request);
+}
+
+void SubstanceCacheWriter::EnqueueRemove(const FString& Key)
+{
+	FWriteRequest Request;
+	Request.Operation = Op_Remove;
+	Request.Key = Key;
+	Request.Bytes = 0;
+
+	Push(Request);
+}
+
+void SubstanceCacheWriter::Push(const FWriteRequest& Request)
+{
+	{
+		FScopeLock Lock(&Mutex);
+		Pending.Add(Request);
+	}
+
+	WorkEvent->Trigger();
+}
+
+void SubstanceCacheWriter::GetWritten(TArray<FWrittenEntry>& Entries)
+{
+	FScopeLock Lock(&Mutex);
+	Entries.Append(Written);
+	Written.Empty();
+}
+
+uint32 SubstanceCacheWriter::Run()
+{
+	for (;;)
+	{
+		const bool bStopping = StopTaskCounter.GetValue() != 0;
+
+		if (!bStopping)
+		{
+			WorkEvent->Wait();
+
+			// let the other outputs of the render batch come in
+			if (QueuedBytes < SUBSTANCECACHE_WRITE_BATCH_BYTES && StopTaskCounter.GetValue() == 0)
+			{
+				FPlatformProcess::Sleep(SUBSTANCECACHE_WRITE_COALESCE_MS / 1000.0f);
+			}
+		}
+
+		TArray<FWriteRequest> Batch;
+		{
+			FScopeLock Lock(&Mutex);
+			Batch = Pending;
+			Pending.Empty();
+		}
+
+		Flush(Batch);
+
+		if (bStopping)
+		{
+			break;
+		}
+	}
+
+	return 0;
+}
+
+void SubstanceCacheWriter::Stop()
+{
+	StopTaskCounter.Increment();
+	WorkEvent->Trigger();
+}
+
+void SubstanceCacheWriter::Flush(TArray<FWriteRequest>& Batch)
+{
+	if (Batch.Num() == 0)
+	{
+		return;
+	}
+
+	for (int32 Idx = 0; Idx < Batch.Num(); ++Idx)
+	{
+		FWriteRequest& Request = Batch[Idx];
+
+		if (Request.Operation == Op_Touch)
+		{
+			Storage.Touch(Request.Key, Request.Time);
+			continue;
+		}
+
+		if (Request.Operation == Op_Remove)
+		{
+			Storage.Remove(Request.Key);
+
+			// the game thread must not index it again
+			FScopeLock Lock(&Mutex);
+			for (int32 IdxWritten = Written.Num() - 1; IdxWritten >= 0; --IdxWritten)
+			{
+				if (Written[IdxWritten].Key == Request.Key)
+				{
+					Written.RemoveAt(IdxWritten);
+				}
+			}
+			continue;
+		}
+
+		const bool bWritten = Storage.Write(Request.Key, Request.Texture->Texture);
+
+		// freed here unless the memory tier still holds it
+		Request.Texture.Reset();
+
+		FPlatformAtomics::InterlockedAdd(&QueuedBytes, -Request.Bytes);
+		DEC_MEMORY_STAT_BY(STAT_SubstanceCacheQueuedBytes, Request.Bytes);
+
+		if (bWritten)
+		{
+			FPlatformAtomics::InterlockedAdd(&WrittenBytes, Request.Bytes);
+			INC_MEMORY_STAT_BY(STAT_SubstanceCacheWrittenBytes, Request.Bytes);
+
+			FWrittenEntry Entry;
+			Entry.Key = Request.Key;
+			Entry.Size = Request.Bytes;
+
+			FScopeLock Lock(&Mutex);
+			Written.Add(Entry);
+		}
+	}
+
+	Storage.Flush();
+
+	Batch.Empty();
+}
@@ -0,0 +1,87 @@
+//! @file SubstanceCacheWriter.h
+//! @brief Background writing of Substance cache entries
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+#include "substance_public.h"
+#include "SubstanceCacheStorage.h"
+
+namespace Substance
+{
+	//! @brief Worker thread applying every change to the cache storage
+	//! @note Writes, touches and removals are applied in queued order
+	class SubstanceCacheWriter : public FRunnable
+	{
+	public:
+		//! @brief Entry stored since last call to GetWritten
+		struct FWrittenEntry
+		{
+			FString Key;
+			int64 Size;
+		};
+
+		SubstanceCacheWriter(SubstanceCacheStorage& Storage);
+
+		//! @brief Writes every queued entry before returning
+		virtual ~SubstanceCacheWriter();
+
+		//! @brief Queue an entry for writing
+		//! @note The writer holds a reference on Texture until written
+		void Enqueue(const FString& Key, const FCachedTexturePtr& Texture);
+
+		//! @brief Queue the update of an entry last use
+		void EnqueueTouch(const FString& Key, const FDateTime& Time);
+
+		//! @brief Queue the removal of an entry
+		void EnqueueRemove(const FString& Key);
+
+		//! @brief Grab the entries written since last call
+		//! @note Entries removed since they were written are left out
+		void GetWritten(TArray<FWrittenEntry>& Entries);
+
+		//! @brief Bytes waiting to be written
+		int64 GetQueuedBytes() const { return QueuedBytes; }
+
+		//! @brief Bytes written since startup
+		int64 GetWrittenBytes() const { return WrittenBytes; }
+
+		// FRunnable interface
+		virtual uint32 Run() override;
+		virtual void Stop() override;
+
+	private:
+		enum EOperation
+		{
+			Op_Write,
+			Op_Touch,
+			Op_Remove
+		};
+
+		struct FWriteRequest
+		{
+			EOperation Operation;
+			FString Key;
+			FCachedTexturePtr Texture;
+			FDateTime Time;
+			int64 Bytes;
+		};
+
+		void Push(const FWriteRequest& Request);
+
+		//! @brief Apply a batch of requests and release the written textures
+		void Flush(TArray<FWriteRequest>& Batch);
+
+		SubstanceCacheStorage& Storage;
+
+		FCriticalSection Mutex;
+		TArray<FWriteRequest> Pending;
+		TArray<FWrittenEntry> Written;
+
+		volatile int64 QueuedBytes;
+		volatile int64 WrittenBytes;
+
+		FEvent* WorkEvent;
+		FThreadSafeCounter StopTaskCounter;
+		FRunnableThread* Thread;
+	};
+}
@@ -8,40 +8,242 @@
 #include "SubstanceTexture2D.h"
 #include "SubstanceFGraph.h"
 #include "SubstanceFOutput.h"
+#include "SubstanceCoreHelpers.h"
 
-Substance::List<output_inst_t*> Substance::RenderCallbacks::mOutputQueue;
-Substance::Details::Sync::mutex Substance::RenderCallbacks::mMutex;
+//! @brief Time since a texture drawn on screen is still considered visible
+#define SUBSTANCE_VISIBLE_TEXTURE_SECONDS 1.0
 
+DEFINE_LOG_CATEGORY_STATIC(LogSubstanceCallbacks, Log, All);
 
-void Substance::RenderCallbacks::outputComputed(
-	uint32 Uid,
-	const Substance::FGraphInstance* graph,
-	Substance::FOutputInstance* output)
+Substance::OutputQueue Substance::RenderCallbacks::mOutputQueue;
+
+
+Substance::OutputQueue::OutputQueue() :
+	mPendingBytes(0),
+	mPeakBytes(0)
 {
-	Substance::Details::Sync::unique_lock slock(mMutex);
-	mOutputQueue.AddUnique(output);
 }
 
 
-Substance::List<Substance::FOutputInstance*> Substance::RenderCallbacks::getComputedOutputs(bool throttleOutputGrab)
+Substance::OutputQueue::~OutputQueue()
 {
-	Substance::Details::Sync::unique_lock slock(mMutex);
+	drain();
+
+	while (mPending.Num() != 0)
+	{
+		removeAt(mPending.Num() - 1);
+	}
+}
+
+
+void Substance::OutputQueue::push(Substance::FOutputInstance* output, int64 bytes)
+{
+	// an output computed again keeps its place in the queue, its previous
+	// result is released
+	if (FPlatformAtomics::InterlockedCompareExchange(&output->QueuedForUpload, 1, 0) != 0)
+	{
+		return;
+	}
+
+	QueuedOutput* queued = new QueuedOutput;
+	queued->output = output;
+	queued->time = FPlatformTime::Seconds();
+	queued->bytes = bytes;
+
+	mPushed.Push(queued);
+}
+
+
+Substance::List<Substance::FOutputInstance*> Substance::OutputQueue::popAll()
+{
+	drain();
+
 	Substance::List<Substance::FOutputInstance*> outputs;
-	
-	if (mOutputQueue.size())
+
+	for (int32 idx = 0; idx < mPending.Num(); ++idx)
+	{
+		outputs.push(mPending[idx]->output);
+	}
+
+	while (mPending.Num() != 0)
+	{
+		removeAt(mPending.Num() - 1);
+	}
+
+	return outputs;
+}
+
+
+//! @brief Tell if the texture of an output was drawn recently
+static bool isOutputVisible(Substance::FOutputInstance* output, double now)
+{
+	USubstanceTexture2D* texture = output->Texture.get() ? *output->Texture : NULL;
+
+	return texture != NULL && texture->Resource != NULL &&
+		now - texture->Resource->LastRenderTime < SUBSTANCE_VISIBLE_TEXTURE_SECONDS;
+}
+
+
+Substance::FOutputInstance* Substance::OutputQueue::pop(int64 maxBytes, int64& bytes)
+{
+	drain();
+
+	// render thread timestamps and texture draw times use different clocks
+	const double now = FApp::GetCurrentTime();
+
+	int32 best = INDEX_NONE;
+	bool bestVisible = false;
+
+	// the outputs which do not fit wait, smaller ones may still go
+	for (int32 idx = 0; idx < mPending.Num(); ++idx)
 	{
-		if (throttleOutputGrab)
+		if (mPending[idx]->bytes > maxBytes)
 		{
-			outputs.push(mOutputQueue.pop());
+			continue;
 		}
-		else
+
+		const bool visible = isOutputVisible(mPending[idx]->output, now);
+
+		if (best == INDEX_NONE ||
+			(visible && !bestVisible) ||
+			(visible == bestVisible && mPending[idx]->time < mPending[best]->time))
 		{
-			outputs = mOutputQueue;
-			mOutputQueue.Empty();
+			best = idx;
+			bestVisible = visible;
+		}
+	}
+
+	if (best == INDEX_NONE)
+	{
+		return NULL;
+	}
+
+	Substance::FOutputInstance* output = mPending[best]->output;
+	bytes = mPending[best]->bytes;
+
+	// the flag is cleared before the result is grabbed: a result filled
+	// meanwhile queues the output again, at worst for nothing
+	removeAt(best);
+
+	return output;
+}
+
+
+void Substance::OutputQueue::remove(Substance::FOutputInstance* output)
+{
+	if (output->QueuedForUpload == 0)
+	{
+		return;
+	}
+
+	drain();
+
+	for (int32 idx = 0; idx < mPending.Num(); ++idx)
+	{
+		if (mPending[idx]->output == output)
+		{
+			removeAt(idx);
+			return;
 		}
 	}
-	 
-	return outputs;
+}
+
+
+void Substance::OutputQueue::getStats(int32& count, double& oldestSeconds)
+{
+	drain();
+
+	const double now = FPlatformTime::Seconds();
+
+	count = mPending.Num();
+	oldestSeconds = 0.0;
+
+	for (int32 idx = 0; idx < mPending.Num(); ++idx)
+	{
+		oldestSeconds = FMath::Max(oldestSeconds, now - mPending[idx]->time);
+	}
+}
+
+
+void Substance::OutputQueue::getBytes(int64& bytes, int64& peakBytes)
+{
+	drain();
+
+	bytes = mPendingBytes;
+	peakBytes = mPeakBytes;
+}
+
+
+bool Substance::OutputQueue::isEmpty() const
+{
+	return mPending.Num() == 0 && mPushed.IsEmpty();
+}
+
+
+void Substance::OutputQueue::drain()
+{
+	TArray<QueuedOutput*> pushed;
+	mPushed.PopAll(pushed);
+
+	for (int32 idx = 0; idx < pushed.Num(); ++idx)
+	{
+		mPending.Add(pushed[idx]);
+		mPendingBytes += pushed[idx]->bytes;
+	}
+
+	mPeakBytes = FMath::Max(mPeakBytes, mPendingBytes);
+}
+
+
+void Substance::OutputQueue::removeAt(int32 idx)
+{
+	QueuedOutput* queued = mPending[idx];
+
+	FPlatformAtomics::InterlockedExchange(&queued->output->QueuedForUpload, 0);
+
+	mPendingBytes -= queued->bytes;
+	mPending.RemoveAtSwap(idx);
+
+	delete queued;
+}
+
+
+void Substance::RenderCallbacks::outputComputed(
+	uint32 Uid,
+	const Substance::FGraphInstance* graph,
+	Substance::FOutputInstance* output,
+	const SubstanceTexture& resultTexture)
+{
+	// estimated even if the output is queued already: the game thread may
+	// unqueue it before the push, which must then count its bytes.
+	// Sized from the result, the instance inputs may change meanwhile
+	const int64 bytes = Substance::Helpers::EstimateUploadBytes(resultTexture);
+
+	mOutputQueue.push(output, bytes);
+}
+
+
+Substance::List<Substance::FOutputInstance*> Substance::RenderCallbacks::getComputedOutputs()
+{
+	return mOutputQueue.popAll();
+}
+
+
+Substance::FOutputInstance* Substance::RenderCallbacks::popComputedOutput(int64 maxBytes, int64& bytes)
+{
+	return mOutputQueue.pop(maxBytes, bytes);
+}
+
+
+void Substance::RenderCallbacks::getOutputQueueStats(int32& count, double& oldestSeconds)
+{
+	mOutputQueue.getStats(count, oldestSeconds);
+}
+
+
+void Substance::RenderCallbacks::getOutputQueueBytes(int64& bytes, int64& peakBytes)
+{
+	mOutputQueue.getBytes(bytes, peakBytes);
 }
 
 
@@ -53,6 +255,113 @@ bool Substance::RenderCallbacks::runRenderProcess(RenderFunction renderFunction,
 
 void Substance::RenderCallbacks::clearComputedOutputs(output_inst_t* Output)
 {
-	Substance::Details::Sync::unique_lock slock(mMutex);
-	mOutputQueue.Remove(Output);
+	mOutputQueue.remove(Output);
 }
+
+
+//! @brief Render thread stand-in pushing outputs as fast as possible
+class FOutputQueueBenchmarkProducer : public FRunnable
+{
+public:
+	FOutputQueueBenchmarkProducer(Substance::OutputQueue& InQueue, TArray<output_inst_t*>& InOutputs, FThreadSafeCounter& InStop) :
+		Queue(InQueue),
+		Outputs(InOutputs),
+		Stop(InStop),
+		PushCount(0)
+	{
+	}
+
+	virtual uint32 Run() override
+	{
+		int32 Idx = FMath::Rand() % Outputs.Num();
+
+		while (Stop.GetValue() == 0)
+		{
+			Queue.push(Outputs[Idx], 1024);
+			Idx = (Idx + 1) % Outputs.Num();
+			++PushCount;
+		}
+
+		return 0;
+	}
+
+	Substance::OutputQueue& Queue;
+	TArray<output_inst_t*>& Outputs;
+	FThreadSafeCounter& Stop;
+	uint64 PushCount;
+};
+
+
+//! @brief Push outputs from 1, 2, 4... threads while this thread pops them
+//! and log the throughput
+static void BenchmarkOutputQueue()
+{
+	const int32 OutputsCount = 4096;
+	const double Seconds = 1.0;
+
+	TArray<output_inst_t*> Outputs;
+	for (int32 Idx = 0; Idx < OutputsCount; ++Idx)
+	{
+		output_inst_t* Output = new output_inst_t;
+		Output->ParentInstance = NULL;
+		Outputs.Add(Output);
+	}
+
+	const int32 MaxProducerCount = FMath::Clamp(FPlatformMisc::NumberOfCores() - 1, 1, 16);
+
+	for (int32 ProducerCount = 1; ProducerCount <= MaxProducerCount; ProducerCount *= 2)
+	{
+		Substance::OutputQueue Queue;
+		FThreadSafeCounter Stop;
+
+		TArray<FOutputQueueBenchmarkProducer*> Producers;
+		TArray<FRunnableThread*> Threads;
+
+		for (int32 Idx = 0; Idx < ProducerCount; ++Idx)
+		{
+			Producers.Add(new FOutputQueueBenchmarkProducer(Queue, Outputs, Stop));
+			Threads.Add(FRunnableThread::Create(Producers[Idx], TEXT("SubstanceOutputQueueBenchmark")));
+		}
+
+		const double Start = FPlatformTime::Seconds();
+		uint64 PopCount = 0;
+		int64 Bytes = 0;
+
+		while (FPlatformTime::Seconds() - Start < Seconds)
+		{
+			while (Queue.pop(MAX_int64, Bytes) != NULL)
+			{
+				++PopCount;
+			}
+		}
+
+		Stop.Increment();
+
+		uint64 PushCount = 0;
+
+		for (int32 Idx = 0; Idx < ProducerCount; ++Idx)
+		{
+			Threads[Idx]->WaitForCompletion();
+			PushCount += Producers[Idx]->PushCount;
+
+			delete Threads[Idx];
+			delete Producers[Idx];
+		}
+
+		const double Elapsed = FPlatformTime::Seconds() - Start;
+
+		// most pushes find the output already queued, the others allocate
+		UE_LOG(LogSubstanceCallbacks, Log, TEXT("%d producer(s): %.0f pushes/s (%.1f ns each), %.0f outputs popped/s"),
+			ProducerCount, PushCount / Elapsed, Elapsed * ProducerCount * 1e9 / FMath::Max<uint64>(PushCount, 1), PopCount / Elapsed);
+	}
+
+	for (int32 Idx = 0; Idx < OutputsCount; ++Idx)
+	{
+		delete Outputs[Idx];
+	}
+}
+
+static FAutoConsoleCommand SubstanceOutputQueueBenchmarkCommand(
+	TEXT("Substance.OutputQueue.Benchmark"),
+	TEXT("Pushes outputs to a computed outputs queue from 1, 2, 4... threads while the game thread pops them, and logs the throughput."),
+	FConsoleCommandDelegate::CreateStatic(&BenchmarkOutputQueue));
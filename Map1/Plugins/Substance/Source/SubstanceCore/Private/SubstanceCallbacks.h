@@ -8,14 +8,77 @@
 
 #include "framework/callbacks.h"
 
-#include "framework/details/detailssync.h"
-
 namespace Substance
 {
 
 struct FOutputInstance;
 struct FGraphInstance;
 
+//! @brief Computed outputs waiting for upload
+//! Render threads push w/o lock; an output already queued is not pushed
+//! again (FOutputInstance::QueuedForUpload flag), so a push costs the same
+//! whatever the queue length. The other methods belong to a single consumer
+//! thread, which moves the pushed outputs to its own list when called.
+class OutputQueue
+{
+public:
+	OutputQueue();
+
+	~OutputQueue();
+
+	//! @brief Queue a computed output, any thread
+	//! @param bytes Estimated size of its result
+	void push(output_inst_t* output, int64 bytes);
+
+	//! @brief Grab every queued output
+	Substance::List<output_inst_t*> popAll();
+
+	//! @brief Grab the most important queued output no larger than maxBytes
+	//! @see RenderCallbacks::popComputedOutput
+	output_inst_t* pop(int64 maxBytes, int64& bytes);
+
+	//! @brief Forget an output
+	void remove(output_inst_t* output);
+
+	//! @brief Count and wait time of the oldest of the queued outputs
+	void getStats(int32& count, double& oldestSeconds);
+
+	//! @brief Estimated bytes held by the queued outputs, and their peak
+	void getBytes(int64& bytes, int64& peakBytes);
+
+	//! @brief Tell if no output is queued
+	bool isEmpty() const;
+
+protected:
+	//! @brief Computed output waiting for upload
+	struct QueuedOutput
+	{
+		output_inst_t* output;
+		double time;             //!< Computation time (FPlatformTime::Seconds())
+		int64 bytes;             //!< Estimated result size
+	};
+
+	//! @brief Outputs pushed by render threads, not seen by the consumer yet
+	TLockFreePointerList<QueuedOutput> mPushed;
+
+	//! @brief Outputs seen by the consumer
+	TArray<QueuedOutput*> mPending;
+
+	//! @brief Estimated bytes of mPending, and their peak
+	int64 mPendingBytes;
+	int64 mPeakBytes;
+
+	//! @brief Move pushed outputs to mPending
+	void drain();
+
+	//! @brief Remove an entry of mPending, clear its output flag
+	void removeAt(int32 idx);
+
+private:
+	OutputQueue(const OutputQueue&);
+	const OutputQueue& operator=(const OutputQueue&);
+};
+
 struct RenderCallbacks : public Substance::Callbacks
 {
 public:
@@ -24,9 +87,26 @@ public:
 	void outputComputed(
 		uint32 Uid,
 		const Substance::FGraphInstance*,
-		Substance::FOutputInstance*);
+		Substance::FOutputInstance*,
+		const SubstanceTexture& resultTexture);
+
+	//! @brief Grab every computed output
+	static Substance::List<output_inst_t*> getComputedOutputs();
+
+	//! @brief Grab the most important computed output
+	//! Outputs of textures drawn recently come first, then the oldest ones.
+	//! @param maxBytes Estimated upload bytes allowed for the output
+	//! @param[out] bytes Estimated upload bytes of the returned output
+	//! @return Return the most important output that fits, NULL if none
+	static output_inst_t* popComputedOutput(int64 maxBytes, int64& bytes);
+
+	//! @brief Count and wait time of the oldest of the computed outputs
+	static void getOutputQueueStats(int32& count, double& oldestSeconds);
 
-	static Substance::List<output_inst_t*> getComputedOutputs(bool throttleOutputGrab=true);
+	//! @brief Estimated bytes held by the computed outputs
+	//! @param[out] bytes Bytes waiting for upload
+	//! @param[out] peakBytes Highest value of bytes so far
+	static void getOutputQueueBytes(int64& bytes, int64& peakBytes);
 
 	static void clearComputedOutputs(output_inst_t*);
 
@@ -36,12 +116,11 @@ public:
 
 	static bool isOutputQueueEmpty()
 	{
-		return mOutputQueue.size() == 0;
+		return mOutputQueue.isEmpty();
 	}
 
 protected:
-	static Substance::List<output_inst_t*> mOutputQueue;
-	static Substance::Details::Sync::mutex mMutex;
+	static OutputQueue mOutputQueue;
 };
 
 } // namespace Substance
@@ -12,8 +12,14 @@
 #include "SubstanceCorePreset.h"
 #include "SubstanceCache.h"
 #include "SubstanceCallbacks.h"
+#include "SubstanceSettings.h"
+#include "SubstanceCoreStats.h"
+#include "SubstanceTexture2DDynamicResource.h"
+#include "SubstancePixelKernels.h"
+#include "SubstanceBlockEncoder.h"
 
 #include "framework/renderer.h"
+#include "framework/rendererpool.h"
 #include "framework/details/detailslinkdata.h"
 
 #include "RenderCore.h"
@@ -29,6 +35,15 @@
 
 #include "Materials/MaterialExpressionTextureSampleParameter.h"
 
+DEFINE_LOG_CATEGORY_STATIC(LogSubstanceRenderer, Log, All);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Outputs Waiting For Upload"), STAT_SubstanceOutputsQueued, STATGROUP_Substance);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Oldest Output Wait (ms)"), STAT_SubstanceOutputsOldestWait, STATGROUP_Substance);
+DECLARE_MEMORY_STAT(TEXT("Outputs Bytes Waiting For Upload"), STAT_SubstanceOutputsQueuedBytes, STATGROUP_Substance);
+DECLARE_MEMORY_STAT(TEXT("Outputs Bytes Waiting For Upload Peak"), STAT_SubstanceOutputsPeakQueuedBytes, STATGROUP_Substance);
+DECLARE_CYCLE_STAT(TEXT("Update Outputs"), STAT_SubstanceUpdateOutputs, STATGROUP_Substance);
+DECLARE_CYCLE_STAT(TEXT("Encode Outputs"), STAT_SubstanceEncodeOutputs, STATGROUP_Substance);
+
 namespace local
 {
 	TArray<USubstanceGraphInstance*> InstancesToDelete;
@@ -40,7 +55,7 @@ namespace Substance
 {
 
 TSharedPtr<Substance::RenderCallbacks> gCallbacks(new Substance::RenderCallbacks());
-TSharedPtr<Substance::Renderer> GSubstanceRenderer(NULL);
+TSharedPtr<Substance::RendererPool> GSubstanceRenderer(NULL);
 
 bool bCacheCleared = false;
 int32 RefreshContentBrowserCount = 0;
@@ -54,6 +69,40 @@ Substance::List<graph_inst_t*> BlueprintQueue; //queue used by the blueprint int
 
 uint32 ASyncRunID = 0;
 
+#if !WITH_EDITOR
+//! @brief Graph instances rendered by one asynchronous run at runtime
+struct FRenderBatch
+{
+	Substance::RenderHandle Handle;
+	double StartTime;
+	TArray<graph_inst_t*> Graphs;
+	uint64 Pixels;
+};
+
+//! @brief Runtime batches not completed yet, oldest first
+static TArray<FRenderBatch> RenderBatches;
+
+//! @brief Completion time of the last runtime batch
+static double LastBatchEndTime = 0.0;
+
+//! @brief Instances pushed since the renderer was last trimmed
+static int32 InstancesSinceTrim = 0;
+
+//! @brief Measured render time per output pixel of each graph
+static TMap<const graph_desc_t*, double> GraphSecondsPerPixel;
+
+//! @brief Render time per output pixel of graphs never rendered yet
+static double DefaultSecondsPerPixel = 20e-9;
+#endif // !WITH_EDITOR
+
+static TAutoConsoleVariable<int32> CVarSubstanceRecreateRendererPerBatch(
+	TEXT("Substance.Renderer.RecreatePerBatch"),
+	0,
+	TEXT("Recreate the renderer after each runtime batch instead of trimming its memory, to compare the batch overhead."));
+
+//! @brief Measured bytes uploaded per millisecond, for the output delivery budget
+static double UploadBytesPerMs = 256.0 * 1024.0;
+
 static uint32 GlobalInstancePendingCount = 0;
 static uint32 GlobalInstanceCompletedCount = 0;
 
@@ -84,15 +133,27 @@ void RenderAsync(Substance::List<graph_inst_t*>& Instances)
 }
 
 
+//! @brief Render the outputs canceled by CancelRender() again
+static void ResumeRender(graph_inst_t* Instance)
+{
+	Substance::List<output_inst_t>::TIterator ItOut(Instance->Outputs.itfront());
+
+	for (; ItOut; ++ItOut)
+	{
+		ItOut->resumeRender();
+	}
+}
+
+
 void RenderAsync(graph_inst_t* Instance)
 {
-	//If this graph has been cached before, read from disk
+	ResumeRender(Instance);
+
+	//If this graph has been cached before, read from disk in the background
 	if (Instance->ParentInstance->bCooked && Instance->ParentInstance->Parent->ShouldCacheOutput())
 	{
-		if (Substance::SubstanceCache::Get()->ReadFromCache(Instance))
+		if (Substance::SubstanceCache::Get()->RequestRead(Instance, true))
 		{
-			Instance->ParentInstance->Parent->SubstancePackage->LinkData.reset();
-			++GlobalInstanceCompletedCount;
 			++GlobalInstancePendingCount;
 			return;
 		}
@@ -117,6 +178,11 @@ void RenderSync(Substance::List<graph_inst_t*>& Instances)
 	GlobalInstanceCompletedCount += Instances.Num();
 	GlobalInstancePendingCount += Instances.Num();
 
+	for (auto ItGraph = Instances.itfront(); ItGraph; ++ItGraph)
+	{
+		ResumeRender(*ItGraph);
+	}
+
 	GSubstanceRenderer->push(Instances);
 	GSubstanceRenderer->run(Substance::Renderer::Run_Default);
 
@@ -130,6 +196,8 @@ void RenderSync(graph_inst_t* Instance)
 
 	++GlobalInstanceCompletedCount;
 	++GlobalInstancePendingCount;
+
+	ResumeRender(Instance);
 	
 	GSubstanceRenderer->push(Instance);
 	GSubstanceRenderer->run(Substance::Renderer::Run_Default);
@@ -142,6 +210,7 @@ void QueueForRendering(graph_inst_t* Instance)
 {
 	++GlobalInstancePendingCount;
 	check(false == Instance->bIsFreezed);
+	ResumeRender(Instance);
 	BlueprintQueue.AddUnique(Instance);
 }
 
@@ -202,13 +271,38 @@ void SetDelayedImageInput()
 }
 
 
+//! @brief Upload the outputs read by the cache reader thread
+//! @param Failed Graphs whose cache entries could not be read
+//! @param bWait Block until every queued read is over
+void ProcessCacheReads(Substance::List<graph_inst_t*>& Failed, bool bWait)
+{
+	Substance::List<graph_inst_t*> Completed;
+
+	if (bWait)
+	{
+		Substance::SubstanceCache::Get()->WaitForReads(Completed, Failed);
+	}
+	else
+	{
+		Substance::SubstanceCache::Get()->ProcessCompletedReads(Completed, Failed);
+	}
+
+	for (auto ItGraph = Completed.itfront(); ItGraph; ++ItGraph)
+	{
+		(*ItGraph)->ParentInstance->Parent->SubstancePackage->LinkData.reset();
+		++GlobalInstanceCompletedCount;
+	}
+}
+
+
 void PerformDelayedRender()
 {
 	if (PriorityLoadingQueue.Num())
 	{
 		Substance::List<graph_inst_t*> RemoveList;
 
-		//see if we have cache entries first
+		//see if we have cache entries first, all reads are
+		//issued before waiting for any of them
 		auto iter = PriorityLoadingQueue.itfront();
 		while (iter)
 		{
@@ -216,10 +310,9 @@ void PerformDelayedRender()
 
 			if (graph->ParentInstance->bCooked && graph->ParentInstance->Parent->ShouldCacheOutput())
 			{
-				if (Substance::SubstanceCache::Get()->ReadFromCache(graph))
+				if (Substance::SubstanceCache::Get()->RequestRead(graph))
 				{
 					++GlobalInstancePendingCount;
-					++GlobalInstanceCompletedCount;
 					RemoveList.push(graph);
 				}
 			}
@@ -235,6 +328,23 @@ void PerformDelayedRender()
 			iterr++;
 		}
 
+		//entries that could not be read are rendered
+		Substance::List<graph_inst_t*> Failed;
+		ProcessCacheReads(Failed, true);
+
+		for (auto ItFailed = Failed.itfront(); ItFailed; ++ItFailed)
+		{
+			int32 Idx = INDEX_NONE;
+			if (RemoveList.FindItem(*ItFailed, Idx))
+			{
+				PriorityLoadingQueue.AddUnique(*ItFailed);
+			}
+			else
+			{
+				AsyncQueue.AddUnique(*ItFailed);
+			}
+		}
+
 		GSubstanceRenderer->clearCache();
 
 		if (PriorityLoadingQueue.Num())
@@ -255,19 +365,161 @@ void PerformDelayedRender()
 }
 
 
-void UpdateSubstanceOutput(USubstanceTexture2D* Texture, const SubstanceTexture& ResultText)
+void GetOutputSizeLog2(graph_inst_t* Graph, int32& SizeLog2X, int32& SizeLog2Y)
 {
-	// make sure any outstanding resource update has been completed
-	FlushRenderingCommands();
+	// Substance default output size
+	SizeLog2X = 8;
+	SizeLog2Y = 8;
+
+	for (auto ItIn = Graph->Inputs.itfront(); ItIn; ++ItIn)
+	{
+		if ((*ItIn)->Desc->Type == Substance_IType_Integer2 && (*ItIn)->Desc->Identifier == TEXT("$outputsize"))
+		{
+			const vec2int_t& Value = ((FNumericalInputInstance<vec2int_t>*)ItIn->Get())->Value;
+			SizeLog2X = FMath::Clamp(Value.X, 0, 13);
+			SizeLog2Y = FMath::Clamp(Value.Y, 0, 13);
+		}
+	}
+}
+
+
+int64 EstimateUploadBytes(const SubstanceTexture& ResultText)
+{
+	const EPixelFormat Format = SubstanceToUe3Format((SubstancePixelFormat)ResultText.pixelFormat);
+
+	if (Format == PF_Unknown || ResultText.mipmapCount == 0)
+	{
+		return 0;
+	}
+
+	return CalcTextureSize(ResultText.level0Width, ResultText.level0Height, Format, ResultText.mipmapCount);
+}
+
+
+void GetMipSizes(const SubstanceTexture& ResultText, TArray<FIntPoint>& Sizes)
+{
+	GetMipSizes(ResultText, Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)ResultText.pixelFormat), Sizes);
+}
+
+
+void GetMipSizes(const SubstanceTexture& ResultText, EPixelFormat Format, TArray<FIntPoint>& Sizes)
+{
+	int32 MipSizeX = ResultText.level0Width;
+	int32 MipSizeY = ResultText.level0Height;
+
+	Sizes.Empty(ResultText.mipmapCount);
+
+	for (int32 IdxMip=0 ; IdxMip < ResultText.mipmapCount ; ++IdxMip)
+	{
+		Sizes.Add(FIntPoint(MipSizeX, MipSizeY));
+
+		// compute the next mip size
+		MipSizeX = FMath::Max(MipSizeX>>1, 1);
+		MipSizeY = FMath::Max(MipSizeY>>1, 1);
+
+		// not smaller than the "block size"
+		MipSizeX = FMath::Max((int32)GPixelFormats[Format].BlockSizeX,MipSizeX);
+		MipSizeY = FMath::Max((int32)GPixelFormats[Format].BlockSizeY,MipSizeY);
+	}
+}
+
+
+//! @brief Blocks smaller than this are not worth a task
+#define SUBSTANCE_PARALLEL_BLOCK_MIN_BYTES (256 * 1024)
+
+//! @brief Task processing a block of rows
+class FSubstanceRowsTask
+{
+public:
+	FSubstanceRowsTask(const std::function<void(int32, int32)>& InBody, int32 InFirstRow, int32 InRowCount)
+		: Body(InBody)
+		, FirstRow(InFirstRow)
+		, RowCount(InRowCount)
+	{
+	}
+
+	static const TCHAR* GetTaskName()
+	{
+		return TEXT("FSubstanceRowsTask");
+	}
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FSubstanceRowsTask, STATGROUP_TaskGraphTasks);
+	}
+
+	static ENamedThreads::Type GetDesiredThread()
+	{
+		return ENamedThreads::AnyThread;
+	}
+
+	static ESubsequentsMode::Type GetSubsequentsMode()
+	{
+		return ESubsequentsMode::TrackSubsequents;
+	}
+
+	void DoTask(ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+	{
+		Body(FirstRow, RowCount);
+	}
+
+private:
+	const std::function<void(int32, int32)>& Body;
+	int32 FirstRow;
+	int32 RowCount;
+};
+
+
+void ParallelForRows(int32 Rows, SIZE_T RowBytes, const std::function<void(int32, int32)>& Body)
+{
+	const int32 MaxBlockCount = FMath::Min(Rows, FTaskGraphInterface::Get().GetNumWorkerThreads() + 1);
+	const int32 BlockCount = (int32)FMath::Min<SIZE_T>(MaxBlockCount, Rows * RowBytes / SUBSTANCE_PARALLEL_BLOCK_MIN_BYTES);
+
+	if (BlockCount <= 1)
+	{
+		if (Rows > 0)
+		{
+			Body(0, Rows);
+		}
+		return;
+	}
+
+	const int32 BlockRows = FMath::DivideAndRoundUp(Rows, BlockCount);
+
+	FGraphEventArray Tasks;
+
+	for (int32 FirstRow = BlockRows; FirstRow < Rows; FirstRow += BlockRows)
+	{
+		Tasks.Add(TGraphTask<FSubstanceRowsTask>::CreateTask().ConstructAndDispatchWhenReady(
+			Body, FirstRow, FMath::Min(BlockRows, Rows - FirstRow)));
+	}
+
+	// the first block is processed by the calling thread
+	Body(0, BlockRows);
+
+	FTaskGraphInterface::Get().WaitUntilTasksComplete(Tasks);
+}
+
+
+void ParallelCopy(void* Dest, const void* Src, SIZE_T Size)
+{
+	const SIZE_T RowBytes = 64 * 1024;
+
+	ParallelForRows((int32)FMath::DivideAndRoundUp(Size, RowBytes), RowBytes, [=](int32 FirstRow, int32 RowCount)
+	{
+		const SIZE_T Offset = FirstRow * RowBytes;
+		FMemory::Memcpy((uint8*)Dest + Offset, (const uint8*)Src + Offset, FMath::Min(RowCount * RowBytes, Size - Offset));
+	});
+}
 
-	// grab the Result computed in the Substance Thread
-	const SIZE_T Mipstart = (SIZE_T) ResultText.buffer;
-	SIZE_T MipOffset = 0;
 
+//! @brief Set the format, size and mips of a texture for a result
+static void PrepareMips(USubstanceTexture2D* Texture, const SubstanceTexture& ResultText, EPixelFormat Format)
+{
 	// prepare mip map data
 	FTexture2DMipMap* MipMap = 0;
 
-	Texture->Format = Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)ResultText.pixelFormat);
+	Texture->Format = Format;
 
 	Texture->NumMips = ResultText.mipmapCount;
 
@@ -278,97 +530,451 @@ void UpdateSubstanceOutput(USubstanceTexture2D* Texture, const SubstanceTexture&
 	{
 		Texture->Mips.Empty();
 
-		int32 MipSizeX = Texture->SizeX = ResultText.level0Width;
-		int32 MipSizeY = Texture->SizeY = ResultText.level0Height;
+		Texture->SizeX = ResultText.level0Width;
+		Texture->SizeY = ResultText.level0Height;
 
-		for (int32 IdxMip=0 ; IdxMip < ResultText.mipmapCount ; ++IdxMip)
+		TArray<FIntPoint> MipSizes;
+		GetMipSizes(ResultText, Format, MipSizes);
+
+		for (int32 IdxMip=0 ; IdxMip < MipSizes.Num() ; ++IdxMip)
 		{
 			MipMap = new(Texture->Mips) FTexture2DMipMap;
-			MipMap->SizeX = MipSizeX;
-			MipMap->SizeY = MipSizeY;
+			MipMap->SizeX = MipSizes[IdxMip].X;
+			MipMap->SizeY = MipSizes[IdxMip].Y;
+		}
+	}
+}
 
-			// compute the next mip size
-			MipSizeX = FMath::Max(MipSizeX>>1, 1);
-			MipSizeY = FMath::Max(MipSizeY>>1, 1);
 
-			// not smaller than the "block size"
-			MipSizeX = FMath::Max((int32)GPixelFormats[Texture->Format].BlockSizeX,MipSizeX);
-			MipSizeY = FMath::Max((int32)GPixelFormats[Texture->Format].BlockSizeY,MipSizeY);
-		}
+//! @brief Output compression of a texture, the project setting by default
+static ESubstanceOutputCompression GetOutputCompression(const USubstanceTexture2D* Texture)
+{
+	if (Texture->OutputCompression == SOC_Default)
+	{
+		return (ESubstanceOutputCompression)GetDefault<USubstanceSettings>()->DefaultOutputCompression.GetValue();
 	}
 
-	// fill up the mips
-	for (int32 IdxMip=0 ; IdxMip < ResultText.mipmapCount ; ++IdxMip)
+	return (ESubstanceOutputCompression)Texture->OutputCompression.GetValue();
+}
+
+
+//! @brief Tell if the results of a texture are block compressed after their render
+static bool ShouldEncodeOutput(const USubstanceTexture2D* Texture, const SubstanceTexture& ResultText)
+{
+	const ESubstanceOutputCompression Compression = GetOutputCompression(Texture);
+
+	if (Compression != SOC_Fast && Compression != SOC_High)
+	{
+		return false;
+	}
+
+	// whole blocks only, the smallest mips repeat their last row and column
+	if (ResultText.level0Width % 4 != 0 || ResultText.level0Height % 4 != 0)
+	{
+		return false;
+	}
+
+	switch (ResultText.pixelFormat & ~Substance_PF_sRGB)
+	{
+	case Substance_PF_L:
+	case Substance_PF_RGB:
+	case Substance_PF_RGBx:
+	case Substance_PF_RGBA:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+
+//! @brief Pick the block format of a result, normal maps keep their x and y
+//! @return Return false if the result is not encoded
+static bool GetOutputEncoding(const USubstanceTexture2D* Texture, const SubstanceTexture& ResultText, Substance::BlockEncoder::EBlockFormat& BlockFormat, bool& bHighQuality, EPixelFormat& Format)
+{
+	using namespace Substance::BlockEncoder;
+
+	if (!ShouldEncodeOutput(Texture, ResultText))
+	{
+		return false;
+	}
+
+	const bool bNormalMap = Texture->CompressionSettings == TC_Normalmap;
+
+	switch (ResultText.pixelFormat & ~Substance_PF_sRGB)
+	{
+	case Substance_PF_L:
+		BlockFormat = BF_BC4;
+		break;
+
+	case Substance_PF_RGB:
+	case Substance_PF_RGBx:
+		BlockFormat = bNormalMap ? BF_BC5 : BF_BC1;
+		break;
+
+	// opaque results switch to BC1 on the encode task
+	default:
+		BlockFormat = bNormalMap ? BF_BC5 : BF_BC3;
+		break;
+	}
+
+	const EPixelFormat BlockFormats[] = { PF_DXT1, PF_DXT5, PF_BC4, PF_BC5 };
+
+	Format = BlockFormats[BlockFormat];
+	bHighQuality = GetOutputCompression(Texture) == SOC_High;
+
+	return GPixelFormats[Format].Supported;
+}
+
+
+//! @brief Result block compressed on a task thread
+struct FOutputEncode
+{
+	//! @brief Texture adopting the encoded result, may be destroyed meanwhile
+	TWeakObjectPtr<USubstanceTexture2D> Texture;
+
+	//! @brief Result to encode, owned and freed once encoded
+	SubstanceTexture Source;
+	EPixelFormat SourceFormat;
+
+	//! @brief Encoded mips, in Format, owned until adopted
+	SubstanceTexture Encoded;
+	EPixelFormat Format;
+
+	Substance::BlockEncoder::EBlockFormat BlockFormat;
+	bool bHighQuality;
+
+	//! @brief A later result of the texture replaces this one
+	bool bSuperseded;
+
+	FGraphEventRef Event;
+};
+
+typedef TSharedPtr<FOutputEncode, ESPMode::ThreadSafe> FOutputEncodePtr;
+
+//! @brief Encodes in start order, adopted on the game thread once complete
+static TArray<FOutputEncodePtr> OutputEncodes;
+
+
+//! @brief Upload a texture whose mips were updated, refresh its consumers
+static void RefreshUpdatedTexture(USubstanceTexture2D* Texture);
+
+
+//! @brief Block compress the mips of a result in a new buffer, free the result
+static void EncodeSubstanceOutput(FOutputEncode& Encode)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SubstanceEncodeOutputs);
+
+	const SubstanceTexture& Source = Encode.Source;
+
+	if (Encode.BlockFormat == Substance::BlockEncoder::BF_BC3 &&
+		Substance::Kernels::IsOpaque((const uint8*)Source.buffer, (SIZE_T)Source.level0Width * Source.level0Height))
+	{
+		Encode.BlockFormat = Substance::BlockEncoder::BF_BC1;
+		Encode.Format = PF_DXT1;
+	}
+
+	Encode.Encoded = Source;
+	Encode.Encoded.buffer = FMemory::Malloc(CalcTextureSize(Source.level0Width, Source.level0Height, Encode.Format, Source.mipmapCount));
+
+	const uint8* Src = (const uint8*)Source.buffer;
+	uint8* Dest = (uint8*)Encode.Encoded.buffer;
+
+	for (int32 IdxMip = 0; IdxMip < Source.mipmapCount; ++IdxMip)
+	{
+		const uint32 MipSizeX = FMath::Max(Source.level0Width >> IdxMip, 1);
+		const uint32 MipSizeY = FMath::Max(Source.level0Height >> IdxMip, 1);
+
+		// already on a task thread, the other outputs encode in parallel
+		Substance::BlockEncoder::EncodeImage(Src, MipSizeX, MipSizeY, Encode.BlockFormat, Encode.bHighQuality, Dest, false);
+
+		const SIZE_T SourceBytes = CalculateImageBytes(MipSizeX, MipSizeY, 0, Encode.SourceFormat);
+		const SIZE_T EncodedBytes = CalculateImageBytes(MipSizeX, MipSizeY, 0, Encode.Format);
+
+		// the blocks of the smallest mips may outweigh their pixels
+		UE_LOG(LogSubstanceRenderer, Verbose, TEXT("Encoded mip %d of a %dx%d output in %s, %lld bytes saved"),
+			IdxMip,
+			Source.level0Width,
+			Source.level0Height,
+			GPixelFormats[Encode.Format].Name,
+			(int64)SourceBytes - (int64)EncodedBytes);
+
+		Src += SourceBytes;
+		Dest += EncodedBytes;
+	}
+
+	FMemory::Free(Encode.Source.buffer);
+	Encode.Source.buffer = NULL;
+}
+
+
+//! @brief Task block compressing a result, adopted by FinishOutputEncodes
+class FSubstanceEncodeTask
+{
+public:
+	FSubstanceEncodeTask(const FOutputEncodePtr& InEncode)
+		: Encode(InEncode)
+	{
+	}
+
+	static const TCHAR* GetTaskName()
+	{
+		return TEXT("FSubstanceEncodeTask");
+	}
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FSubstanceEncodeTask, STATGROUP_TaskGraphTasks);
+	}
+
+	static ENamedThreads::Type GetDesiredThread()
+	{
+		return ENamedThreads::AnyThread;
+	}
+
+	static ESubsequentsMode::Type GetSubsequentsMode()
 	{
-		MipMap = &Texture->Mips[IdxMip];
+		return ESubsequentsMode::TrackSubsequents;
+	}
 
-		// get the size of the mip's content
-		const SIZE_T ImageSize = CalculateImageBytes(
-			MipMap->SizeX,
-			MipMap->SizeY,
-			0,
-			Texture->Format);
-		check(0 != ImageSize);
+	void DoTask(ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+	{
+		EncodeSubstanceOutput(*Encode);
+	}
 
-		// copy the data
-		MipMap->BulkData = FByteBulkData();
-		MipMap->BulkData.Lock(LOCK_READ_WRITE);
-		void* TheMipDataPtr = MipMap->BulkData.Realloc(ImageSize);
+private:
+	FOutputEncodePtr Encode;
+};
 
-		FMemory::Memcpy(TheMipDataPtr, (void*)(Mipstart + MipOffset), ImageSize);
 
-		if (Texture->Format == PF_B8G8R8A8)
+//! @brief The encodes in flight of a texture are dropped once complete
+static void SupersedeOutputEncodes(USubstanceTexture2D* Texture)
+{
+	for (int32 Idx = 0; Idx < OutputEncodes.Num(); ++Idx)
+	{
+		if (OutputEncodes[Idx]->Texture.Get() == Texture)
 		{
-			uint8 temp;
-			uint8* Pixels = (uint8*)TheMipDataPtr;
+			OutputEncodes[Idx]->bSuperseded = true;
+		}
+	}
+}
 
-			for (SIZE_T Idx = 0; Idx < ImageSize; Idx +=4)
-			{
-				// substance outputs rgba8, convert to bgra8
-				// r, g, b, a = b, g, r, a
-				temp = Pixels[0];
-				Pixels[0] = Pixels[2];
-				Pixels[2] = temp;
 
-				Pixels += 4;
+//! @brief Encode a result on a task thread, the texture keeps its mips until then
+//! @param Source Result whose ownership is transferred to the encode
+static void StartOutputEncode(USubstanceTexture2D* Texture, const SubstanceTexture& Source, Substance::BlockEncoder::EBlockFormat BlockFormat, bool bHighQuality, EPixelFormat Format)
+{
+	SupersedeOutputEncodes(Texture);
+
+	FOutputEncodePtr Encode = MakeShareable(new FOutputEncode);
+	Encode->Texture = Texture;
+	Encode->Source = Source;
+	Encode->SourceFormat = SubstanceToUe3Format((SubstancePixelFormat)Source.pixelFormat);
+	FMemory::MemZero(Encode->Encoded);
+	Encode->Format = Format;
+	Encode->BlockFormat = BlockFormat;
+	Encode->bHighQuality = bHighQuality;
+	Encode->bSuperseded = false;
+
+	Encode->Event = TGraphTask<FSubstanceEncodeTask>::CreateTask().ConstructAndDispatchWhenReady(Encode);
+
+	OutputEncodes.Add(Encode);
+}
+
+
+//! @brief Upload the encoded results, in start order
+//! @param bWait Block until every encode in flight is over
+//! @return Return true if a texture was updated
+static bool FinishOutputEncodes(bool bWait)
+{
+	bool bUpdatedOutput = false;
+
+	for (int32 Idx = 0; Idx < OutputEncodes.Num();)
+	{
+		FOutputEncodePtr Encode = OutputEncodes[Idx];
+
+		if (!Encode->Event->IsComplete())
+		{
+			if (!bWait)
+			{
+				++Idx;
+				continue;
 			}
+
+			FTaskGraphInterface::Get().WaitUntilTaskCompletes(Encode->Event);
 		}
-	
-		MipOffset += ImageSize;
-		MipMap->BulkData.ClearBulkDataFlags( BULKDATA_SingleUse );
-		MipMap->BulkData.Unlock();
+
+		OutputEncodes.RemoveAt(Idx);
+
+		USubstanceTexture2D* Texture = Encode->Texture.Get();
+
+		if (NULL == Texture || Encode->bSuperseded)
+		{
+			FMemory::Free(Encode->Encoded.buffer);
+			continue;
+		}
+
+		AdoptSubstanceOutput(Texture, Encode->Encoded, Encode->Format);
+		Texture->EncodedFromFormat = Encode->SourceFormat;
+		RefreshUpdatedTexture(Texture);
+		bUpdatedOutput = true;
+	}
+
+	return bUpdatedOutput;
+}
+
+
+//! @brief Drop the encodes in flight, once their tasks are over
+static void CancelOutputEncodes()
+{
+	for (int32 Idx = 0; Idx < OutputEncodes.Num(); ++Idx)
+	{
+		OutputEncodes[Idx]->bSuperseded = true;
+	}
+
+	FinishOutputEncodes(true);
+}
+
+
+//! @brief Bytes copied by UpdateSubstanceOutput, measured by the cache benchmark
+static volatile int64 GCopiedOutputBytes = 0;
+
+
+//! @brief Copy a result in a new buffer, the previous one may still be uploading
+static SubstanceTexture CopySubstanceOutput(const SubstanceTexture& ResultText)
+{
+	const EPixelFormat Format = SubstanceToUe3Format((SubstancePixelFormat)ResultText.pixelFormat);
+	const SIZE_T BufferSize = CalcTextureSize(ResultText.level0Width, ResultText.level0Height, Format, ResultText.mipmapCount);
+
+	SubstanceTexture Copy = ResultText;
+	Copy.buffer = FMemory::Malloc(BufferSize);
+	ParallelCopy(Copy.buffer, ResultText.buffer, BufferSize);
+	FPlatformAtomics::InterlockedAdd(&GCopiedOutputBytes, (int64)BufferSize);
+
+	return Copy;
+}
+
+
+bool UpdateSubstanceOutput(USubstanceTexture2D* Texture, const SubstanceTexture& ResultText)
+{
+	Substance::BlockEncoder::EBlockFormat BlockFormat;
+	bool bHighQuality;
+	EPixelFormat EncodedFormat;
+
+	// the encode reads its own copy, the result may be released meanwhile
+	if (GetOutputEncoding(Texture, ResultText, BlockFormat, bHighQuality, EncodedFormat))
+	{
+		StartOutputEncode(Texture, CopySubstanceOutput(ResultText), BlockFormat, bHighQuality, EncodedFormat);
+		return false;
+	}
+
+	SupersedeOutputEncodes(Texture);
+	AdoptSubstanceOutput(Texture, CopySubstanceOutput(ResultText));
+
+	return true;
+}
+
+
+int64 GetCopiedOutputBytes()
+{
+	return FPlatformAtomics::InterlockedAdd(&GCopiedOutputBytes, 0);
+}
+
+
+void AdoptSubstanceOutput(USubstanceTexture2D* Texture, const SubstanceTexture& ResultText, EPixelFormat Format)
+{
+	// the rendering thread reads the mips bulk data of a previous upload
+	Texture->MipsFence.Wait();
+
+	if (Format == PF_Unknown)
+	{
+		Format = SubstanceToUe3Format((SubstancePixelFormat)ResultText.pixelFormat);
+	}
+
+	PrepareMips(Texture, ResultText, Format);
+
+	// release the previous result copied in the bulk data
+	for (int32 IdxMip=0 ; IdxMip < Texture->Mips.Num() ; ++IdxMip)
+	{
+		Texture->Mips[IdxMip].BulkData = FByteBulkData();
 	}
+
+	Texture->MipBuffer = MakeShareable(new FSubstanceMipBuffer(ResultText, Texture->Format, Texture->Mips));
+	Texture->EncodedFromFormat = PF_Unknown;
 }
 
 
-void UpdateTexture(const SubstanceTexture& result, output_inst_t* Output, bool bCacheResults /*= true*/)
+//! @brief Tell if the results of this output go to the disk cache
+bool ShouldCacheOutput(const output_inst_t* Output)
 {
 	USubstanceTexture2D* Texture = *(Output->Texture.get());
 
 	if (NULL == Texture)
 	{
-		if (bCacheResults)
+		return true;
+	}
+
+	return Texture->ParentInstance->bCooked &&
+		Texture->ParentInstance->Parent->ShouldCacheOutput();
+}
+
+
+void UpdateTexture(RenderResult& Result, output_inst_t* Output)
+{
+	// keyed when pushed, from the inputs it was rendered with
+	const FString& CacheKey = Result.getCacheKey();
+	const bool bCacheResult = !CacheKey.IsEmpty();
+	USubstanceTexture2D* Texture = *(Output->Texture.get());
+
+	//the texture or its encode adopts the buffer, unless the cache writer takes it
+	if (!bCacheResult && Texture && Result.haveOwnership())
+	{
+		Substance::BlockEncoder::EBlockFormat BlockFormat;
+		bool bHighQuality;
+		EPixelFormat EncodedFormat;
+
+		if (GetOutputEncoding(Texture, Result.getTexture(), BlockFormat, bHighQuality, EncodedFormat))
 		{
-			Substance::SubstanceCache::Get()->CacheOutput(Output, result);
+			StartOutputEncode(Texture, Result.releaseTexture(), BlockFormat, bHighQuality, EncodedFormat);
+			return;
 		}
 
+		SupersedeOutputEncodes(Texture);
+		AdoptSubstanceOutput(Texture, Result.releaseTexture());
+		RefreshUpdatedTexture(Texture);
 		return;
 	}
 
-	//publish to cache if appropriate
-	if (bCacheResults)
+	UpdateTexture(Result.getTexture(), Output);
+
+	//the cache writer thread takes ownership of the buffer
+	if (bCacheResult && Result.haveOwnership())
 	{
-		if (Texture->ParentInstance->bCooked)
-		{
-			if (Texture->ParentInstance->Parent->ShouldCacheOutput())
-			{
-				Substance::SubstanceCache::Get()->CacheOutput(Output, result);
-			}
-		}
+		Substance::SubstanceCache::Get()->QueueOutput(CacheKey, Result.releaseTexture());
 	}
+}
+
+
+void UpdateTexture(const SubstanceTexture& result, output_inst_t* Output)
+{
+	USubstanceTexture2D* Texture = *(Output->Texture.get());
+
+	if (NULL == Texture)
+	{
+		return;
+	}
+
+	//encoded outputs are refreshed once adopted
+	if (Helpers::UpdateSubstanceOutput(Texture, result))
+	{
+		RefreshUpdatedTexture(Texture);
+	}
+}
 
-	Helpers::UpdateSubstanceOutput(Texture, result);
-	Texture->UpdateResource();
+
+static void RefreshUpdatedTexture(USubstanceTexture2D* Texture)
+{
+	Texture->UpdateMips();
 
 	Texture->OutputCopy->bIsDirty = false;
 
@@ -402,65 +1008,394 @@ void UpdateTexture(const SubstanceTexture& result, output_inst_t* Output, bool b
 }
 
 
-void PostLoadRender()
+void PostLoadRender()
+{
+	GlobalInstanceCompletedCount = 0;
+	GlobalInstancePendingCount = 0;
+
+	PerformDelayedRender();
+}
+
+
+void StartPIE()
+{
+#if WITH_EDITOR
+	GSubstanceRenderer->flush();
+	
+	//update outputs
+	Substance::List<output_inst_t*> Outputs =
+		RenderCallbacks::getComputedOutputs();
+
+	Substance::List<output_inst_t*>::TIterator ItOut(Outputs.itfront());
+
+	bool bUpdatedOutput = false;
+
+	for (; ItOut; ++ItOut)
+	{
+		// Grab Result (auto pointer on RenderResult)
+		output_inst_t::Result Result = ((*ItOut)->grabResult());
+
+		if (Result.get())
+		{
+			UpdateTexture(*Result, *ItOut);
+			bUpdatedOutput = true;
+		}
+	}
+#endif
+}
+
+
+#if !WITH_EDITOR
+//! @brief Output pixels an instance renders, mipmaps included
+static uint64 EstimateRenderPixels(graph_inst_t* Graph)
+{
+	int32 SizeLog2X = 0;
+	int32 SizeLog2Y = 0;
+	GetOutputSizeLog2(Graph, SizeLog2X, SizeLog2Y);
+
+	uint64 Pixels = 0;
+
+	for (auto ItOut = Graph->Outputs.itfront(); ItOut; ++ItOut)
+	{
+		if (ItOut->bIsEnabled)
+		{
+			Pixels += ((uint64)1 << (SizeLog2X + SizeLog2Y)) * 4 / 3;
+		}
+	}
+
+	return FMath::Max<uint64>(Pixels, 1);
+}
+
+
+//! @brief Render time of an instance from the past renders of its graph
+static double EstimateRenderSeconds(graph_inst_t* Graph, uint64 Pixels)
+{
+	const double* SecondsPerPixel = GraphSecondsPerPixel.Find(Graph->Desc);
+	return Pixels * (SecondsPerPixel ? *SecondsPerPixel : DefaultSecondsPerPixel);
+}
+
+
+//! @brief Record the render time of a completed batch
+//! The engine renders batches one after the other: a batch computes from
+//! its run or the end of the previous one, whichever is last.
+static void RecordBatchTime(const FRenderBatch& Batch, double EndTime)
+{
+	const double Seconds = EndTime - FMath::Max(Batch.StartTime, LastBatchEndTime);
+	LastBatchEndTime = EndTime;
+
+	if (Seconds <= 0.0)
+	{
+		return;
+	}
+
+	// the batch time is shared by pixel count, smoothed per graph
+	const double SecondsPerPixel = Seconds / Batch.Pixels;
+	const double Smoothing = 0.3;
+
+	for (int32 Idx = 0; Idx < Batch.Graphs.Num(); ++Idx)
+	{
+		double& GraphValue = GraphSecondsPerPixel.FindOrAdd(Batch.Graphs[Idx]->Desc);
+		GraphValue = GraphValue > 0.0 ? FMath::Lerp(GraphValue, SecondsPerPixel, Smoothing) : SecondsPerPixel;
+	}
+
+	DefaultSecondsPerPixel = FMath::Lerp(DefaultSecondsPerPixel, SecondsPerPixel, Smoothing);
+}
+
+
+//! @brief Keep the renderer fed w/ batches sized from their estimated cost
+//! Batches are filled up to the target render time and to the memory
+//! budget. The next batch is queued while the current one computes; the
+//! renderer is trimmed once every batch is over.
+static void TickRenderBatches()
+{
+	const USubstanceSettings* Settings = GetDefault<USubstanceSettings>();
+	const double Now = FPlatformTime::Seconds();
+
+	// forget completed batches
+	while (RenderBatches.Num() != 0 && RenderBatches[0].Handle.isComplete())
+	{
+		FRenderBatch& Batch = RenderBatches[0];
+		RecordBatchTime(Batch, Now);
+
+		UE_LOG(LogSubstanceRenderer, Verbose, TEXT("Batch of %d instances, %llu pixels rendered in %.3f ms"),
+			Batch.Graphs.Num(), Batch.Pixels, (Now - Batch.StartTime) * 1000.0);
+
+		for (int32 Idx = 0; Idx < Batch.Graphs.Num(); ++Idx)
+		{
+			Batch.Graphs[Idx]->ParentInstance->Parent->SubstancePackage->ConditionnalClearLinkData();
+			CurrentRenderQueue.Remove(Batch.Graphs[Idx]);
+		}
+
+		GlobalInstanceCompletedCount += Batch.Graphs.Num();
+		RenderBatches.RemoveAt(0);
+	}
+
+	// free some memory once idle, the engine contexts, linkers and render
+	// threads are kept
+	if (RenderBatches.Num() == 0 && InstancesSinceTrim != 0 && RenderCallbacks::isOutputQueueEmpty())
+	{
+		const double ResetStart = FPlatformTime::Seconds();
+
+		if (CVarSubstanceRecreateRendererPerBatch.GetValueOnGameThread() != 0 || !GSubstanceRenderer->trim())
+		{
+			GSubstanceRenderer = TSharedPtr<Substance::RendererPool>(new Substance::RendererPool());
+			GSubstanceRenderer->setRenderCallbacks(gCallbacks.Get());
+		}
+
+		UE_LOG(LogSubstanceRenderer, Verbose, TEXT("Renderer reset in %.3f ms"), (FPlatformTime::Seconds() - ResetStart) * 1000.0);
+
+		InstancesSinceTrim = 0;
+	}
+
+	// one batch computing, the next one queued; every instance pushed since
+	// the last trim is linked again by the next batch, hence the limit
+	const int32 MaxBatchesInFlight = 2;
+	const int32 MaxInstancesBeforeTrim = 32;
+
+	const uint64 BudgetBytes = (uint64)Settings->MemoryBudgetMb * 1024 * 1024;
+	const double TargetSeconds = Settings->RuntimeBatchTargetMs / 1000.0;
+
+	uint64 InFlightBytes = 0;
+	for (int32 Idx = 0; Idx < RenderBatches.Num(); ++Idx)
+	{
+		InFlightBytes += RenderBatches[Idx].Pixels * 4;
+	}
+
+	while ((AsyncQueue.Num() || BlueprintQueue.Num()) &&
+		RenderBatches.Num() < MaxBatchesInFlight &&
+		InstancesSinceTrim < MaxInstancesBeforeTrim &&
+		(RenderBatches.Num() == 0 || InFlightBytes < BudgetBytes))
+	{
+		FRenderBatch Batch;
+		Batch.Pixels = 0;
+		double BatchSeconds = 0.0;
+
+		// instances changed through blueprints are most likely in view, the
+		// others are loading; synchronous renders preempt both
+		while (BlueprintQueue.Num() != 0 || AsyncQueue.Num() != 0)
+		{
+			const bool bVisible = BlueprintQueue.Num() != 0;
+			graph_inst_t* Graph = bVisible ? BlueprintQueue.Last() : AsyncQueue.Last();
+
+			const uint64 Pixels = EstimateRenderPixels(Graph);
+			const double Seconds = EstimateRenderSeconds(Graph, Pixels);
+
+			// a batch takes at least one instance
+			if (Batch.Graphs.Num() != 0 &&
+				(BatchSeconds + Seconds > TargetSeconds || InFlightBytes + Pixels * 4 > BudgetBytes))
+			{
+				break;
+			}
+
+			if (bVisible)
+			{
+				BlueprintQueue.pop();
+			}
+			else
+			{
+				AsyncQueue.pop();
+			}
+
+			if (CurrentRenderQueue.AddUnique(Graph) != CurrentRenderQueue.Num() - 1)
+			{
+				continue;
+			}
+
+			GSubstanceRenderer->push(Graph, bVisible ?
+				Substance::Renderer::Priority_Visible :
+				Substance::Renderer::Priority_Nearby);
+
+			Batch.Graphs.Add(Graph);
+			Batch.Pixels += Pixels;
+			BatchSeconds += Seconds;
+			InFlightBytes += Pixels * 4;
+		}
+
+		if (Batch.Graphs.Num() == 0)
+		{
+			break;
+		}
+
+		Batch.StartTime = FPlatformTime::Seconds();
+		Batch.Handle = GSubstanceRenderer->runAsync(
+			Substance::Renderer::Run_Replace |
+			Substance::Renderer::Run_First |
+			Substance::Renderer::Run_PreserveRun
+			);
+
+		InstancesSinceTrim += Batch.Graphs.Num();
+
+		if (Batch.Handle.isComplete())
+		{
+			// nothing to compute, or computed already
+			for (int32 Idx = 0; Idx < Batch.Graphs.Num(); ++Idx)
+			{
+				CurrentRenderQueue.Remove(Batch.Graphs[Idx]);
+			}
+
+			GlobalInstanceCompletedCount += Batch.Graphs.Num();
+			continue;
+		}
+
+		RenderBatches.Add(Batch);
+	}
+}
+#endif // !WITH_EDITOR
+
+
+//! @brief Upload every computed output
+//! @return Return true if a texture was updated
+static bool UpdateComputedOutputs()
+{
+	Substance::List<output_inst_t*> Outputs =
+		RenderCallbacks::getComputedOutputs();
+		
+	Substance::List<output_inst_t*>::TIterator ItOut(Outputs.itfront());
+
+	bool bUpdatedOutput = false;
+
+	for (; ItOut; ++ItOut)
+	{
+		// Grab Result (auto pointer on RenderResult)
+		output_inst_t::Result Result = ((*ItOut)->grabResult());
+
+		if (Result.get())
+		{
+			UpdateTexture(*Result, *ItOut);
+			bUpdatedOutput = true;
+		}
+	}
+
+	return bUpdatedOutput;
+}
+
+
+//! @brief Upload computed outputs within the time and bytes budgets of a frame
+//! The most important outputs go first. One output is always uploaded so the
+//! queue drains even if a single output is over budget.
+//! @return Return true if a texture was updated
+static bool UpdateComputedOutputsBudgeted()
+{
+	const USubstanceSettings* Settings = GetDefault<USubstanceSettings>();
+	const double StartTime = FPlatformTime::Seconds();
+	const double EndTime = StartTime + Settings->OutputDeliveryBudgetMs / 1000.0;
+
+	int64 BytesLeft = (int64)Settings->OutputDeliveryBudgetMb * 1024 * 1024;
+	int64 BytesUploaded = 0;
+	bool bUpdatedOutput = false;
+
+	for (;;)
+	{
+		const double Now = FPlatformTime::Seconds();
+
+		// first output unbounded, the others must fit both budgets
+		int64 MaxBytes = MAX_int64;
+
+		if (bUpdatedOutput)
+		{
+			if (Now >= EndTime || BytesLeft <= 0)
+			{
+				break;
+			}
+
+			const int64 TimeBytes = (int64)((EndTime - Now) * 1000.0 * UploadBytesPerMs);
+			MaxBytes = FMath::Min(BytesLeft, TimeBytes);
+		}
+
+		int64 Bytes = 0;
+		output_inst_t* Output = RenderCallbacks::popComputedOutput(MaxBytes, Bytes);
+
+		if (NULL == Output)
+		{
+			break;
+		}
+
+		// Grab Result (auto pointer on RenderResult)
+		output_inst_t::Result Result = Output->grabResult();
+
+		if (Result.get())
+		{
+			UpdateTexture(*Result, Output);
+			bUpdatedOutput = true;
+			BytesLeft -= Bytes;
+			BytesUploaded += Bytes;
+		}
+	}
+
+	// measured upload rate, for the next frames
+	const double ElapsedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	if (BytesUploaded != 0 && ElapsedMs > 0.0)
+	{
+		UploadBytesPerMs = FMath::Lerp(UploadBytesPerMs, BytesUploaded / ElapsedMs, 0.3);
+	}
+
+	return bUpdatedOutput;
+}
+
+
+//! @brief Hold the renderer while the computed outputs exceed the backlog budget
+//! Rendering resumes once the backlog is back under half the budget.
+static void UpdateOutputBackpressure()
 {
-	GlobalInstanceCompletedCount = 0;
-	GlobalInstancePendingCount = 0;
+	int32 QueuedCount = 0;
+	double OldestSeconds = 0.0;
+	RenderCallbacks::getOutputQueueStats(QueuedCount, OldestSeconds);
 
-	PerformDelayedRender();
-}
+	int64 QueuedBytes = 0;
+	int64 PeakQueuedBytes = 0;
+	RenderCallbacks::getOutputQueueBytes(QueuedBytes, PeakQueuedBytes);
 
+	SET_DWORD_STAT(STAT_SubstanceOutputsQueued, QueuedCount);
+	SET_FLOAT_STAT(STAT_SubstanceOutputsOldestWait, OldestSeconds * 1000.0);
+	SET_MEMORY_STAT(STAT_SubstanceOutputsQueuedBytes, QueuedBytes);
+	SET_MEMORY_STAT(STAT_SubstanceOutputsPeakQueuedBytes, PeakQueuedBytes);
 
-void StartPIE()
-{
-#if WITH_EDITOR
-	GSubstanceRenderer->flush();
-	
-	//update outputs
-	Substance::List<output_inst_t*> Outputs =
-		RenderCallbacks::getComputedOutputs(false);
+	const int64 BudgetBytes = (int64)GetDefault<USubstanceSettings>()->OutputBacklogBudgetMb * 1024 * 1024;
 
-	Substance::List<output_inst_t*>::TIterator ItOut(Outputs.itfront());
+	// the pool keeps the hold across synchronous runs and flushes
+	const bool bHeld = GSubstanceRenderer->isHeld();
 
-	bool bUpdatedOutput = false;
+	if (!bHeld && BudgetBytes > 0 && QueuedBytes > BudgetBytes)
+	{
+		UE_LOG(LogSubstanceRenderer, Verbose, TEXT("Rendering held, %lld bytes waiting for upload"), QueuedBytes);
 
-	for (; ItOut; ++ItOut)
+		GSubstanceRenderer->hold();
+	}
+	else if (bHeld && (BudgetBytes <= 0 || QueuedBytes * 2 < BudgetBytes))
 	{
-		// Grab Result (auto pointer on RenderResult)
-		output_inst_t::Result Result = ((*ItOut)->grabResult());
+		UE_LOG(LogSubstanceRenderer, Verbose, TEXT("Rendering resumed, %lld bytes waiting for upload"), QueuedBytes);
 
-		if (Result.get())
-		{
-			UpdateTexture(Result->getTexture(), *ItOut);
-			bUpdatedOutput = true;
-		}
+		GSubstanceRenderer->resume();
 	}
-#endif
 }
 
 
 void Tick()
 {
-	//update outputs
-	Substance::List<output_inst_t*> Outputs =
-		RenderCallbacks::getComputedOutputs(!GIsEditor);
-		
-	Substance::List<output_inst_t*>::TIterator ItOut(Outputs.itfront());
+	Substance::SubstanceCache::Get()->Tick();
 
-	bool bUpdatedOutput = false;
-
-	for (; ItOut; ++ItOut)
+	//upload outputs read from the cache, the others go through the renderer
 	{
-		// Grab Result (auto pointer on RenderResult)
-		output_inst_t::Result Result = ((*ItOut)->grabResult());
+		Substance::List<graph_inst_t*> Failed;
+		ProcessCacheReads(Failed, false);
 
-		if (Result.get())
+		for (auto ItFailed = Failed.itfront(); ItFailed; ++ItFailed)
 		{
-			UpdateTexture(Result->getTexture(), *ItOut);
-			bUpdatedOutput = true;
+			AsyncQueue.AddUnique(*ItFailed);
 		}
 	}
 
+	//update outputs, uploads are staged without waiting for the rendering thread
+	bool bUpdatedOutput = false;
+	{
+		SCOPE_CYCLE_COUNTER(STAT_SubstanceUpdateOutputs);
+		bUpdatedOutput = GIsEditor ? UpdateComputedOutputs() : UpdateComputedOutputsBudgeted();
+		bUpdatedOutput |= FinishOutputEncodes(false);
+	}
+
+	UpdateOutputBackpressure();
+
 #if WITH_EDITOR
 	if (bUpdatedOutput)
 	{
@@ -468,51 +1403,12 @@ void Tick()
 		FEditorSupportDelegates::RedrawAllViewports.Broadcast();
 		ASyncRunID = 0;
 	}
-#endif
-
-	//check if our last async job has completed
-	if (!GIsEditor && CurrentRenderQueue.Num() && ASyncRunID != 0 && !GSubstanceRenderer->isPending(ASyncRunID) && RenderCallbacks::isOutputQueueEmpty())
-	{
-		ASyncRunID = 0;
 
-		// free some memory by reseting the engine each batch of rendering
-		GSubstanceRenderer = TSharedPtr<Substance::Renderer>(new Substance::Renderer());
-		GSubstanceRenderer->setRenderCallbacks(gCallbacks.Get());
-
-		for (auto itG = CurrentRenderQueue.itfront(); itG; ++itG)
-		{
-			(*itG)->ParentInstance->Parent->SubstancePackage->ConditionnalClearLinkData();
-		}
-
-		GlobalInstanceCompletedCount += CurrentRenderQueue.Num();
-		CurrentRenderQueue.Empty();	
-	}
-	
-#if WITH_EDITOR
 	//push async substances to renderer
 	if (AsyncQueue.Num() && 0 == ASyncRunID)
 	{
 		GSubstanceRenderer->push(AsyncQueue);
 		AsyncQueue.Empty();
-#else // WITH_EDITOR
-	if ((AsyncQueue.Num() || BlueprintQueue.Num()) && !CurrentRenderQueue.Num()/*&& ASyncRunID == 0*/)
-	{
-		// limit the number of substances being rendered at the same time
-		// to save some memory
-		const int BatchSize = 4;
-
-		while (AsyncQueue.Num() != 0 && CurrentRenderQueue.Num() <= BatchSize)
-		{
-			CurrentRenderQueue.AddUnique(AsyncQueue.pop());
-		}
-
-		while (BlueprintQueue.Num() != 0 && CurrentRenderQueue.Num() <= BatchSize)
-		{
-			CurrentRenderQueue.AddUnique(BlueprintQueue.pop());
-		}
-
-		GSubstanceRenderer->push(CurrentRenderQueue);
-#endif //WITH_EDITOR
 
 		ASyncRunID = GSubstanceRenderer->run(
 			Substance::Renderer::Run_Asynchronous |
@@ -521,6 +1417,9 @@ void Tick()
 			Substance::Renderer::Run_PreserveRun
 			);
 	}
+#else // WITH_EDITOR
+	TickRenderBatches();
+#endif //WITH_EDITOR
 
 	Substance::Helpers::PerformDelayedDeletion();
 }
@@ -532,11 +1431,89 @@ void CancelPendingActions()
 	{
 		LoadingQueue.Empty();
 		PriorityLoadingQueue.Empty();
+		SubstanceCache::Get()->CancelAllReads();
 		GSubstanceRenderer->cancelAll();
 	}
 }
 
 
+bool CancelRender(graph_inst_t* Instance)
+{
+	bool bCanceled = false;
+
+	// not pushed yet, counted as rendered for the loading progress
+	const int32 QueuedCount = AsyncQueue.Remove(Instance) + BlueprintQueue.Remove(Instance);
+
+	if (QueuedCount != 0)
+	{
+		GlobalInstanceCompletedCount += QueuedCount;
+		bCanceled = true;
+	}
+
+	LoadingQueue.Remove(Instance);
+	PriorityLoadingQueue.Remove(Instance);
+
+	// pushed, the rest of its render job goes on
+	Substance::List<output_inst_t>::TIterator ItOut(Instance->Outputs.itfront());
+
+	for (; ItOut; ++ItOut)
+	{
+		if (ItOut->bIsEnabled)
+		{
+			bCanceled = CancelRender(&(*ItOut)) || bCanceled;
+		}
+	}
+
+	return bCanceled;
+}
+
+
+bool CancelRender(output_inst_t* Output)
+{
+	USubstanceTexture2D* Texture = *(Output->Texture.get());
+
+	// the encodes in flight would upload the computed results
+	if (Texture)
+	{
+		SupersedeOutputEncodes(Texture);
+	}
+
+	return Output->cancelRender();
+}
+
+
+float GetRenderProgress(output_inst_t* Output)
+{
+	// not pushed to the renderer yet, or canceled
+	if (Output->isDirty() || Output->isRenderCanceled())
+	{
+		return 0.0f;
+	}
+
+	return Output->getRenderProgress();
+}
+
+
+float GetRenderProgress(graph_inst_t* Instance)
+{
+	float Progress = 0.0f;
+	int32 OutputCount = 0;
+
+	Substance::List<output_inst_t>::TIterator ItOut(Instance->Outputs.itfront());
+
+	for (; ItOut; ++ItOut)
+	{
+		if (ItOut->bIsEnabled)
+		{
+			Progress += GetRenderProgress(&(*ItOut));
+			++OutputCount;
+		}
+	}
+
+	return OutputCount != 0 ? Progress / OutputCount : 1.0f;
+}
+
+
 output_desc_t* GetOutputDesc(output_inst_t* Output)
 {
 	output_desc_t* Desc = NULL;
@@ -636,12 +1613,15 @@ bool UpdateTextures(Substance::List<FGraphInstance*>& Instances)
 			if (Result.get())
 			{
 				(*ItInst)->ParentInstance->MarkPackageDirty();
-				UpdateTexture(Result->getTexture(), &*ItOut);
+				UpdateTexture(*Result, &*ItOut);
 				GotSomething = true;
 			}
 		}
 	}
 
+	// the encoded outputs are expected too
+	FinishOutputEncodes(true);
+
 	return GotSomething;
 }
 
@@ -747,8 +1727,12 @@ void CreatePlaceHolderMips(graph_inst_t* Instance)
 
 		Texture->Format = PF_B8G8R8A8;
 
+		Texture->MipsFence.Wait();
+
 		Texture->NumMips = 4;	
 		Texture->Mips.Empty();
+		Texture->MipBuffer.Reset();
+		Texture->EncodedFromFormat = PF_Unknown;
 
 		int32 MipSizeX = Texture->SizeX = 16;
 		int32 MipSizeY = Texture->SizeY = 16;
@@ -788,16 +1772,8 @@ void CreatePlaceHolderMips(graph_inst_t* Instance)
 			MipMap->BulkData.Lock(LOCK_READ_WRITE);
 			void* TheMipDataPtr = MipMap->BulkData.Realloc(ImageSize);
 
-			uint8* Pixels = (uint8*)TheMipDataPtr;
-
-			for (SIZE_T Idx = 0; Idx < ImageSize; Idx += 4)
-			{
-				Pixels[0] = 128;
-				Pixels[1] = 128;
-				Pixels[2] = 128;
-				Pixels[3] = 0;
-				Pixels += 4;
-			}
+			// grey, transparent
+			Substance::Kernels::Fill32((uint8*)TheMipDataPtr, 0x00808080, ImageSize / 4);
 			
 			MipOffset += ImageSize;
 			MipMap->BulkData.ClearBulkDataFlags(BULKDATA_SingleUse);
@@ -1091,15 +2067,315 @@ bool AreInputValuesEqual(
 }
 
 
+//! @brief Render the loaded instances w/ 1, 2, 4... renderers and log the throughput
+//! @note The CPUCores and memory budget settings are split between the renderers
+static void BenchmarkRendererPool()
+{
+	if (GSubstanceRenderer.Get())
+	{
+		GSubstanceRenderer->flush();
+	}
+
+	TArray<graph_inst_t*> Graphs;
+	int32 OutputsCount = 0;
+
+	for (TObjectIterator<USubstanceGraphInstance> It; It; ++It)
+	{
+		graph_inst_t* Graph = It->Instance;
+
+		if (Graph && !Graph->bIsBaked && Graph->Desc && Graph->Desc->Parent && Graph->Desc->Parent->getLinkData())
+		{
+			Graphs.Add(Graph);
+
+			for (auto ItOut = Graph->Outputs.itfront(); ItOut; ++ItOut)
+			{
+				OutputsCount += ItOut->bIsEnabled ? 1 : 0;
+			}
+		}
+	}
+
+	if (Graphs.Num() == 0 || OutputsCount == 0)
+	{
+		UE_LOG(LogSubstanceRenderer, Log, TEXT("No Substance graph instance to render"));
+		return;
+	}
+
+	const uint32 MaxShardCount = FMath::Clamp(FPlatformMisc::NumberOfCores(), 1, 16);
+	double SingleShardSeconds = 0.0;
+
+	for (uint32 ShardCount = 1; ShardCount <= MaxShardCount; ShardCount *= 2)
+	{
+		Substance::RendererPool Pool(ShardCount, Substance::RendererPool::Placement_Load);
+		Pool.setRenderCallbacks(NULL);
+
+		for (int32 Idx = 0; Idx < Graphs.Num(); ++Idx)
+		{
+			for (auto ItOut = Graphs[Idx]->Outputs.itfront(); ItOut; ++ItOut)
+			{
+				if (ItOut->bIsEnabled)
+				{
+					ItOut->flagAsDirty();
+				}
+			}
+
+			Pool.push(Graphs[Idx]);
+		}
+
+		const double Start = FPlatformTime::Seconds();
+		Pool.run(Substance::Renderer::Run_Default);
+		const double Seconds = FMath::Max(FPlatformTime::Seconds() - Start, 1e-6);
+
+		// results hold engine memory, release them before the pool
+		for (int32 Idx = 0; Idx < Graphs.Num(); ++Idx)
+		{
+			for (auto ItOut = Graphs[Idx]->Outputs.itfront(); ItOut; ++ItOut)
+			{
+				ItOut->grabResult();
+			}
+		}
+
+		SingleShardSeconds = ShardCount == 1 ? Seconds : SingleShardSeconds;
+
+		UE_LOG(LogSubstanceRenderer, Log, TEXT("%u renderer(s): %d instances, %d outputs in %.3f s, %.1f outputs/s, speedup %.2f"),
+			ShardCount, Graphs.Num(), OutputsCount, Seconds, OutputsCount / Seconds, SingleShardSeconds / Seconds);
+	}
+}
+
+static FAutoConsoleCommand SubstanceRendererBenchmarkCommand(
+	TEXT("Substance.Renderer.Benchmark"),
+	TEXT("Renders the loaded Substance graph instances with 1, 2, 4... renderers and logs the throughput."),
+	FConsoleCommandDelegate::CreateStatic(&BenchmarkRendererPool));
+
+
+//! @brief Upload 4K results w/ and w/o copy, then many results at once, and log the cost
+//! Game thread time is the mips update, upload time is the rendering thread
+//! catching up. Uploads recreating the resource wait for the rendering thread.
+static void BenchmarkOutputUpload()
+{
+	const int32 Iterations = 4;
+	const SubstancePixelFormat Formats[] = { Substance_PF_RGBA, Substance_PF_DXT1 };
+
+	// a result of the given size, full mip chain
+	struct FBenchmarkResult
+	{
+		static SubstanceTexture Create(SubstancePixelFormat Format, int32 SizeLog2, int32 Fill)
+		{
+			const EPixelFormat UeFormat = SubstanceToUe3Format(Format);
+			const SIZE_T BufferSize = CalcTextureSize(1 << SizeLog2, 1 << SizeLog2, UeFormat, SizeLog2 + 1);
+
+			SubstanceTexture Result;
+			FMemory::MemZero(Result);
+			Result.buffer = FMemory::Malloc(BufferSize, 16);
+			Result.level0Width = 1 << SizeLog2;
+			Result.level0Height = 1 << SizeLog2;
+			Result.pixelFormat = Format;
+			Result.mipmapCount = SizeLog2 + 1;
+			FMemory::Memset(Result.buffer, Fill, BufferSize);
+
+			return Result;
+		}
+	};
+
+	USubstanceTexture2D* Texture = ConstructObject<USubstanceTexture2D>(
+		USubstanceTexture2D::StaticClass(),
+		GetTransientPackage());
+
+	// the copies are measured, not their encoding
+	Texture->OutputCompression = SOC_None;
+
+	for (int32 IdxFormat = 0; IdxFormat < ARRAY_COUNT(Formats); ++IdxFormat)
+	{
+		const EPixelFormat Format = SubstanceToUe3Format(Formats[IdxFormat]);
+		const SIZE_T BufferSize = CalcTextureSize(4096, 4096, Format, 13);
+
+		for (int32 bAdopt = 0; bAdopt < 2; ++bAdopt)
+		{
+			double GameMs = 0.0;
+			double UploadMs = 0.0;
+
+			for (int32 Idx = 0; Idx < Iterations; ++Idx)
+			{
+				SubstanceTexture Result = FBenchmarkResult::Create(Formats[IdxFormat], 12, Idx);
+
+				const double Start = FPlatformTime::Seconds();
+
+				if (bAdopt)
+				{
+					AdoptSubstanceOutput(Texture, Result);
+				}
+				else
+				{
+					UpdateSubstanceOutput(Texture, Result);
+					FMemory::Free(Result.buffer);
+				}
+
+				Texture->UpdateMips();
+
+				const double Updated = FPlatformTime::Seconds();
+
+				FlushRenderingCommands();
+
+				GameMs += (Updated - Start) * 1000.0;
+				UploadMs += (FPlatformTime::Seconds() - Updated) * 1000.0;
+			}
+
+			// the copy holds the result and its copy until the result is released
+			UE_LOG(LogSubstanceRenderer, Log, TEXT("4096x4096 %s %s: %.3f ms game thread, %.3f ms upload, %llu bytes copied on the game thread, %llu bytes peak"),
+				GPixelFormats[Format].Name,
+				bAdopt ? TEXT("adopted") : TEXT("copied"),
+				GameMs / Iterations,
+				UploadMs / Iterations,
+				(uint64)(bAdopt ? 0 : BufferSize),
+				(uint64)(bAdopt ? BufferSize : BufferSize * 2));
+		}
+	}
+
+	Texture->ReleaseResource();
+	Texture->MipBuffer.Reset();
+	Texture->Mips.Empty();
+
+	// many outputs computed in the same frame
+	const int32 TexturesCount = 32;
+	TArray<USubstanceTexture2D*> Textures;
+
+	for (int32 Idx = 0; Idx < TexturesCount; ++Idx)
+	{
+		Textures.Add(ConstructObject<USubstanceTexture2D>(
+			USubstanceTexture2D::StaticClass(),
+			GetTransientPackage()));
+
+		AdoptSubstanceOutput(Textures[Idx], FBenchmarkResult::Create(Substance_PF_RGBA, 10, 0));
+		Textures[Idx]->UpdateResource();
+	}
+
+	FlushRenderingCommands();
+
+	for (int32 bStaged = 0; bStaged < 2; ++bStaged)
+	{
+		const double Start = FPlatformTime::Seconds();
+
+		for (int32 Idx = 0; Idx < TexturesCount; ++Idx)
+		{
+			AdoptSubstanceOutput(Textures[Idx], FBenchmarkResult::Create(Substance_PF_RGBA, 10, bStaged));
+
+			if (bStaged)
+			{
+				Textures[Idx]->UpdateMips();
+			}
+			else
+			{
+				Textures[Idx]->UpdateResource();
+			}
+		}
+
+		const double Updated = FPlatformTime::Seconds();
+
+		FlushRenderingCommands();
+
+		UE_LOG(LogSubstanceRenderer, Log, TEXT("%d 1024x1024 outputs in one frame %s: %.3f ms game thread, %.3f ms upload"),
+			TexturesCount,
+			bStaged ? TEXT("staged") : TEXT("w/ resources recreated"),
+			(Updated - Start) * 1000.0,
+			(FPlatformTime::Seconds() - Updated) * 1000.0);
+	}
+
+	for (int32 Idx = 0; Idx < TexturesCount; ++Idx)
+	{
+		Textures[Idx]->ReleaseResource();
+		Textures[Idx]->MipBuffer.Reset();
+		Textures[Idx]->Mips.Empty();
+	}
+}
+
+static FAutoConsoleCommand SubstanceUploadBenchmarkCommand(
+	TEXT("Substance.Upload.Benchmark"),
+	TEXT("Uploads 4K results copied, then adopted as mip storage, then 32 results in one frame, and logs the cost."),
+	FConsoleCommandDelegate::CreateStatic(&BenchmarkOutputUpload));
+
+
+//! @brief Log the memory saved per mip level by the encoded outputs
+static void ReportOutputEncoding()
+{
+	struct FLevelReport
+	{
+		int32 TexturesCount;
+		uint64 SourceBytes;
+		uint64 EncodedBytes;
+	};
+
+	TArray<FLevelReport> Levels;
+
+	for (TObjectIterator<USubstanceTexture2D> It; It; ++It)
+	{
+		const USubstanceTexture2D* Texture = *It;
+
+		if (Texture->EncodedFromFormat == PF_Unknown)
+		{
+			continue;
+		}
+
+		for (int32 IdxMip = 0; IdxMip < Texture->Mips.Num(); ++IdxMip)
+		{
+			if (Levels.Num() <= IdxMip)
+			{
+				FLevelReport Level = { 0, 0, 0 };
+				Levels.Add(Level);
+			}
+
+			Levels[IdxMip].TexturesCount += 1;
+			Levels[IdxMip].SourceBytes += CalculateImageBytes(
+				FMath::Max(Texture->SizeX >> IdxMip, 1),
+				FMath::Max(Texture->SizeY >> IdxMip, 1),
+				0,
+				Texture->EncodedFromFormat);
+			Levels[IdxMip].EncodedBytes += CalculateImageBytes(
+				Texture->Mips[IdxMip].SizeX,
+				Texture->Mips[IdxMip].SizeY,
+				0,
+				Texture->Format);
+		}
+	}
+
+	uint64 SourceBytes = 0;
+	uint64 EncodedBytes = 0;
+
+	for (int32 IdxMip = 0; IdxMip < Levels.Num(); ++IdxMip)
+	{
+		const FLevelReport& Level = Levels[IdxMip];
+
+		UE_LOG(LogSubstanceRenderer, Log, TEXT("Mip %d: %d textures, %.2f MB encoded in %.2f MB, %.2f MB saved"),
+			IdxMip,
+			Level.TexturesCount,
+			Level.SourceBytes / (1024.0 * 1024.0),
+			Level.EncodedBytes / (1024.0 * 1024.0),
+			(Level.SourceBytes - Level.EncodedBytes) / (1024.0 * 1024.0));
+
+		SourceBytes += Level.SourceBytes;
+		EncodedBytes += Level.EncodedBytes;
+	}
+
+	UE_LOG(LogSubstanceRenderer, Log, TEXT("Encoded outputs: %.2f MB encoded in %.2f MB, %.2f MB saved"),
+		SourceBytes / (1024.0 * 1024.0),
+		EncodedBytes / (1024.0 * 1024.0),
+		(SourceBytes - EncodedBytes) / (1024.0 * 1024.0));
+}
+
+static FAutoConsoleCommand SubstanceEncodeReportCommand(
+	TEXT("Substance.Encode.Report"),
+	TEXT("Logs the GPU memory saved per mip level by the outputs encoded on the CPU."),
+	FConsoleCommandDelegate::CreateStatic(&ReportOutputEncoding));
+
+
 void SetupSubstance()
 {
-	GSubstanceRenderer = TSharedPtr<Substance::Renderer>(new Substance::Renderer());
+	GSubstanceRenderer = TSharedPtr<Substance::RendererPool>(new Substance::RendererPool());
 	GSubstanceRenderer->setRenderCallbacks(gCallbacks.Get());
 }
 
 
 void TearDownSubstance()
 {
+	CancelOutputEncodes();
 	GSubstanceRenderer.Reset();
 	SubstanceCache::Shutdown();
 }
@@ -1238,17 +2514,7 @@ void Join_RGBA_8bpp(
 	
 	if (DecompressedImageA)
 	{
-		uint8* DstImagePtrA = DecompressedImageRGBA + 3;
-		uint8* ImagePtrA = DecompressedImageA;
-
-		for(int32 Y = 0; Y < Height; Y++)
-		{					
-			for(int32 X = 0;X < Width;X++)
-			{	
-				*DstImagePtrA = *ImagePtrA++;
-				DstImagePtrA += 4;
-			}
-		}
+		Substance::Kernels::InterleaveAlpha(DecompressedImageA, DecompressedImageRGBA, Width * Height);
 	}
 }
 
@@ -1780,6 +3046,7 @@ void ClearFromRender(USubstanceGraphInstance* GraphInstance)
 	LoadingQueue.Remove(GraphInstance->Instance);
 	PriorityLoadingQueue.Remove(GraphInstance->Instance);
 	BlueprintQueue.Remove(GraphInstance->Instance);
+	SubstanceCache::Get()->CancelReads(GraphInstance->Instance);
 
 	Substance::List<output_inst_t>::TIterator
 		ItOut(GraphInstance->Instance->Outputs.itfront());
@@ -1843,6 +3110,11 @@ void Cleanup( USubstanceGraphInstance* InstanceContainer )
 				InstanceContainer->Instance);
 		}
 
+		if (GSubstanceRenderer.IsValid())
+		{
+			GSubstanceRenderer->releaseInstance(InstanceContainer->Instance);
+		}
+
 		delete InstanceContainer->Instance;
 		InstanceContainer->Instance = 0;
 		InstanceContainer->Parent = 0;
@@ -2,6 +2,7 @@
 
 #include "SubstanceCorePrivatePCH.h"
 #include "SubstanceCoreHelpers.h"
+#include "SubstanceCache.h"
 #include "SubstanceCoreModule.h"
 
 #include "SubstanceCoreClasses.h"
@@ -14,6 +15,35 @@ namespace
 {
 	static FWorldDelegates::FWorldInitializationEvent::FDelegate OnWorldInitDelegate;
 	static FDelegateHandle OnWorldInitDelegateHandle;
+	static FWorldDelegates::FWorldCleanupEvent::FDelegate OnWorldCleanupDelegate;
+	static FDelegateHandle OnWorldCleanupDelegateHandle;
+
+	//! @brief Cache manifest of the world's map in Saved/Substance/Manifests,
+	//! empty for unsaved maps and worlds not meant to be played or edited
+	FString GetCacheManifestPath(UWorld* World)
+	{
+		if (World->WorldType != EWorldType::Game &&
+			World->WorldType != EWorldType::PIE &&
+			World->WorldType != EWorldType::Editor)
+		{
+			return FString();
+		}
+
+		const FString PackageName = UWorld::RemovePIEPrefix(World->GetOutermost()->GetName());
+
+		if (!FPackageName::DoesPackageExist(PackageName))
+		{
+			return FString();
+		}
+
+		// one file per package, /Game/Maps/Map is Game_Maps_Map
+		FString FileName = PackageName.Replace(TEXT("/"), TEXT("_"));
+		FileName.RemoveFromStart(TEXT("_"));
+
+		return FString::Printf(TEXT("%s/Substance/Manifests/%s.substancemanifest"),
+			*FPaths::GameSavedDir(),
+			*FileName);
+	}
 }
 
 void FSubstanceCoreModule::StartupModule()
@@ -30,11 +60,15 @@ void FSubstanceCoreModule::StartupModule()
 
 	::OnWorldInitDelegate = FWorldDelegates::FWorldInitializationEvent::FDelegate::CreateStatic(&FSubstanceCoreModule::OnWorldInitialized);
 	::OnWorldInitDelegateHandle = FWorldDelegates::OnPostWorldInitialization.Add(::OnWorldInitDelegate);
+
+	::OnWorldCleanupDelegate = FWorldDelegates::FWorldCleanupEvent::FDelegate::CreateStatic(&FSubstanceCoreModule::OnWorldCleanup);
+	::OnWorldCleanupDelegateHandle = FWorldDelegates::OnWorldCleanup.Add(::OnWorldCleanupDelegate);
 }
 
 void FSubstanceCoreModule::ShutdownModule()
 {
 	FWorldDelegates::OnPostWorldInitialization.Remove(::OnWorldInitDelegateHandle);
+	FWorldDelegates::OnWorldCleanup.Remove(::OnWorldCleanupDelegateHandle);
 
 	UnregisterSettings();
 
@@ -55,7 +89,24 @@ bool FSubstanceCoreModule::Tick(float DeltaTime)
 
 void FSubstanceCoreModule::OnWorldInitialized(UWorld* World, const UWorld::InitializationValues IVS)
 {
+	// get the entries used last time in flight before the queued
+	// graphs are read or rendered
+	const FString ManifestPath = GetCacheManifestPath(World);
+	if (!ManifestPath.IsEmpty())
+	{
+		Substance::SubstanceCache::Get()->BeginManifest(ManifestPath);
+	}
+
 	Substance::Helpers::PostLoadRender();
 }
 
+void FSubstanceCoreModule::OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+{
+	const FString ManifestPath = GetCacheManifestPath(World);
+	if (!ManifestPath.IsEmpty())
+	{
+		Substance::SubstanceCache::Get()->EndManifest(ManifestPath);
+	}
+}
+
 IMPLEMENT_MODULE( FSubstanceCoreModule, SubstanceCore );
@@ -0,0 +1,6 @@
+//! @file SubstanceCoreStats.h
+//! @brief Substance stats group
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+DECLARE_STATS_GROUP(TEXT("Substance"), STATGROUP_Substance, STATCAT_Advanced);
@@ -9,6 +9,7 @@
 #include "SubstanceFPackage.h"
 #include "SubstanceInput.h"
 #include "SubstanceImageInput.h"
+#include "SubstanceCoreHelpers.h"
 #include "substance_public.h"
 
 namespace Substance
@@ -401,6 +402,25 @@ FGraphInstance::~FGraphInstance()
 }
 
 
+input_hash_t FGraphInstance::getHeavyInputHash() const
+{
+	input_hash_t Hash;
+
+	Substance::List<TSharedPtr<input_inst_t>>::TConstIterator ItIn(Inputs.itfrontconst());
+
+	for (; ItIn ; ++ItIn)
+	{
+		if ((*ItIn)->IsHeavyDuty)
+		{
+			Hash += Helpers::GetValueString(*ItIn);
+			Hash += TEXT(";");
+		}
+	}
+
+	return Hash;
+}
+
+
 int32 FGraphInstance::UpdateInput(
 	const uint32& Uid,
 	class UObject* InValue)
@@ -0,0 +1,650 @@
+//! @file SubstancePixelKernels.cpp
+//! @brief Scalar, SSE2 and AVX2 implementations of the pixel conversion kernels
+//! @copyright Allegorithmic. All rights reserved.
+
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstancePixelKernels.h"
+
+// x86 CPUs running the engine support SSE2
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SUBSTANCE_KERNELS_SSE2 1
+#include <emmintrin.h>
+#else
+#define SUBSTANCE_KERNELS_SSE2 0
+#endif
+
+// AVX2 intrinsics need no compiler switch w/ msvc only, picked at runtime
+#if SUBSTANCE_KERNELS_SSE2 && defined(_MSC_VER)
+#define SUBSTANCE_KERNELS_AVX2 1
+#include <immintrin.h>
+#include <intrin.h>
+#else
+#define SUBSTANCE_KERNELS_AVX2 0
+#endif
+
+DEFINE_LOG_CATEGORY_STATIC(LogSubstanceKernels, Log, All);
+
+namespace Substance
+{
+namespace Kernels
+{
+
+//! @brief Kernels of an instruction set
+struct FKernelTable
+{
+	void (*SwizzleRB)(const uint8* Src, uint8* Dest, SIZE_T PixelCount);
+	void (*InterleaveAlpha)(const uint8* Alpha, uint8* Dest, SIZE_T PixelCount);
+	void (*DeinterleaveAlpha)(const uint8* Src, uint8* Alpha, SIZE_T PixelCount);
+	void (*Fill32)(uint8* Dest, uint32 Value, SIZE_T PixelCount);
+	void (*Convert16To8)(const uint16* Src, uint8* Dest, SIZE_T Count);
+	bool (*IsOpaque)(const uint8* Src, SIZE_T PixelCount);
+};
+
+
+static void SwizzleRB_Scalar(const uint8* Src, uint8* Dest, SIZE_T PixelCount)
+{
+	for (SIZE_T Idx = 0; Idx < PixelCount; ++Idx)
+	{
+		// read both before writing, Src may be Dest
+		const uint8 Red = Src[0];
+		const uint8 Blue = Src[2];
+
+		Dest[0] = Blue;
+		Dest[1] = Src[1];
+		Dest[2] = Red;
+		Dest[3] = Src[3];
+
+		Src += 4;
+		Dest += 4;
+	}
+}
+
+
+static void InterleaveAlpha_Scalar(const uint8* Alpha, uint8* Dest, SIZE_T PixelCount)
+{
+	for (SIZE_T Idx = 0; Idx < PixelCount; ++Idx)
+	{
+		Dest[Idx * 4 + 3] = Alpha[Idx];
+	}
+}
+
+
+static void DeinterleaveAlpha_Scalar(const uint8* Src, uint8* Alpha, SIZE_T PixelCount)
+{
+	for (SIZE_T Idx = 0; Idx < PixelCount; ++Idx)
+	{
+		Alpha[Idx] = Src[Idx * 4 + 3];
+	}
+}
+
+
+static void Fill32_Scalar(uint8* Dest, uint32 Value, SIZE_T PixelCount)
+{
+	for (SIZE_T Idx = 0; Idx < PixelCount; ++Idx)
+	{
+		FMemory::Memcpy(Dest + Idx * 4, &Value, sizeof(Value));
+	}
+}
+
+
+static void Convert16To8_Scalar(const uint16* Src, uint8* Dest, SIZE_T Count)
+{
+	for (SIZE_T Idx = 0; Idx < Count; ++Idx)
+	{
+		Dest[Idx] = (uint8)(Src[Idx] >> 8);
+	}
+}
+
+
+static bool IsOpaque_Scalar(const uint8* Src, SIZE_T PixelCount)
+{
+	for (SIZE_T Idx = 0; Idx < PixelCount; ++Idx)
+	{
+		if (Src[Idx * 4 + 3] != 255)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+static const FKernelTable GScalarKernels =
+{
+	&SwizzleRB_Scalar,
+	&InterleaveAlpha_Scalar,
+	&DeinterleaveAlpha_Scalar,
+	&Fill32_Scalar,
+	&Convert16To8_Scalar,
+	&IsOpaque_Scalar
+};
+
+
+#if SUBSTANCE_KERNELS_SSE2
+
+static void SwizzleRB_SSE2(const uint8* Src, uint8* Dest, SIZE_T PixelCount)
+{
+	const __m128i MaskAG = _mm_set1_epi32((int32)0xff00ff00);
+	const __m128i MaskRB = _mm_set1_epi32(0x00ff00ff);
+
+	SIZE_T Idx = 0;
+
+	for (; Idx + 4 <= PixelCount; Idx += 4)
+	{
+		const __m128i Pixels = _mm_loadu_si128((const __m128i*)(Src + Idx * 4));
+		const __m128i RB = _mm_and_si128(Pixels, MaskRB);
+		const __m128i BR = _mm_or_si128(_mm_slli_epi32(RB, 16), _mm_srli_epi32(RB, 16));
+
+		_mm_storeu_si128((__m128i*)(Dest + Idx * 4), _mm_or_si128(_mm_and_si128(Pixels, MaskAG), BR));
+	}
+
+	SwizzleRB_Scalar(Src + Idx * 4, Dest + Idx * 4, PixelCount - Idx);
+}
+
+
+static void InterleaveAlpha_SSE2(const uint8* Alpha, uint8* Dest, SIZE_T PixelCount)
+{
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128i MaskRGB = _mm_set1_epi32(0x00ffffff);
+
+	SIZE_T Idx = 0;
+
+	for (; Idx + 16 <= PixelCount; Idx += 16)
+	{
+		// alpha bytes widened to the high byte of 32 bits pixels
+		const __m128i Alpha8 = _mm_loadu_si128((const __m128i*)(Alpha + Idx));
+		const __m128i AlphaLo = _mm_unpacklo_epi8(Zero, Alpha8);
+		const __m128i AlphaHi = _mm_unpackhi_epi8(Zero, Alpha8);
+
+		const __m128i Alpha32[4] =
+		{
+			_mm_unpacklo_epi16(Zero, AlphaLo),
+			_mm_unpackhi_epi16(Zero, AlphaLo),
+			_mm_unpacklo_epi16(Zero, AlphaHi),
+			_mm_unpackhi_epi16(Zero, AlphaHi)
+		};
+
+		for (int32 Part = 0; Part < 4; ++Part)
+		{
+			__m128i* Pixels = (__m128i*)(Dest + (Idx + Part * 4) * 4);
+			const __m128i RGB = _mm_and_si128(_mm_loadu_si128(Pixels), MaskRGB);
+
+			_mm_storeu_si128(Pixels, _mm_or_si128(RGB, Alpha32[Part]));
+		}
+	}
+
+	InterleaveAlpha_Scalar(Alpha + Idx, Dest + Idx * 4, PixelCount - Idx);
+}
+
+
+static void DeinterleaveAlpha_SSE2(const uint8* Src, uint8* Alpha, SIZE_T PixelCount)
+{
+	SIZE_T Idx = 0;
+
+	for (; Idx + 16 <= PixelCount; Idx += 16)
+	{
+		const __m128i* Pixels = (const __m128i*)(Src + Idx * 4);
+
+		const __m128i Alpha0 = _mm_srli_epi32(_mm_loadu_si128(Pixels + 0), 24);
+		const __m128i Alpha1 = _mm_srli_epi32(_mm_loadu_si128(Pixels + 1), 24);
+		const __m128i Alpha2 = _mm_srli_epi32(_mm_loadu_si128(Pixels + 2), 24);
+		const __m128i Alpha3 = _mm_srli_epi32(_mm_loadu_si128(Pixels + 3), 24);
+
+		// values fit in a byte, packs do not saturate
+		const __m128i Alpha8 = _mm_packus_epi16(
+			_mm_packs_epi32(Alpha0, Alpha1),
+			_mm_packs_epi32(Alpha2, Alpha3));
+
+		_mm_storeu_si128((__m128i*)(Alpha + Idx), Alpha8);
+	}
+
+	DeinterleaveAlpha_Scalar(Src + Idx * 4, Alpha + Idx, PixelCount - Idx);
+}
+
+
+static void Fill32_SSE2(uint8* Dest, uint32 Value, SIZE_T PixelCount)
+{
+	const __m128i Values = _mm_set1_epi32((int32)Value);
+
+	SIZE_T Idx = 0;
+
+	for (; Idx + 4 <= PixelCount; Idx += 4)
+	{
+		_mm_storeu_si128((__m128i*)(Dest + Idx * 4), Values);
+	}
+
+	Fill32_Scalar(Dest + Idx * 4, Value, PixelCount - Idx);
+}
+
+
+static void Convert16To8_SSE2(const uint16* Src, uint8* Dest, SIZE_T Count)
+{
+	SIZE_T Idx = 0;
+
+	for (; Idx + 16 <= Count; Idx += 16)
+	{
+		const __m128i Lo = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(Src + Idx)), 8);
+		const __m128i Hi = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(Src + Idx + 8)), 8);
+
+		_mm_storeu_si128((__m128i*)(Dest + Idx), _mm_packus_epi16(Lo, Hi));
+	}
+
+	Convert16To8_Scalar(Src + Idx, Dest + Idx, Count - Idx);
+}
+
+
+static bool IsOpaque_SSE2(const uint8* Src, SIZE_T PixelCount)
+{
+	const __m128i MaskRGB = _mm_set1_epi32(0x00ffffff);
+	const __m128i Ones = _mm_set1_epi32(-1);
+
+	SIZE_T Idx = 0;
+
+	for (; Idx + 16 <= PixelCount; Idx += 16)
+	{
+		const __m128i* Pixels = (const __m128i*)(Src + Idx * 4);
+
+		__m128i Acc = _mm_and_si128(_mm_loadu_si128(Pixels + 0), _mm_loadu_si128(Pixels + 1));
+		Acc = _mm_and_si128(Acc, _mm_and_si128(_mm_loadu_si128(Pixels + 2), _mm_loadu_si128(Pixels + 3)));
+		Acc = _mm_or_si128(Acc, MaskRGB);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(Acc, Ones)) != 0xffff)
+		{
+			return false;
+		}
+	}
+
+	return IsOpaque_Scalar(Src + Idx * 4, PixelCount - Idx);
+}
+
+
+static const FKernelTable GSSE2Kernels =
+{
+	&SwizzleRB_SSE2,
+	&InterleaveAlpha_SSE2,
+	&DeinterleaveAlpha_SSE2,
+	&Fill32_SSE2,
+	&Convert16To8_SSE2,
+	&IsOpaque_SSE2
+};
+
+#endif // SUBSTANCE_KERNELS_SSE2
+
+
+#if SUBSTANCE_KERNELS_AVX2
+
+// The upper halves of the ymm registers are cleared before the SSE2 tails,
+// to avoid the AVX-SSE transition penalty
+
+static void SwizzleRB_AVX2(const uint8* Src, uint8* Dest, SIZE_T PixelCount)
+{
+	const __m256i MaskAG = _mm256_set1_epi32((int32)0xff00ff00);
+	const __m256i MaskRB = _mm256_set1_epi32(0x00ff00ff);
+
+	SIZE_T Idx = 0;
+
+	for (; Idx + 8 <= PixelCount; Idx += 8)
+	{
+		const __m256i Pixels = _mm256_loadu_si256((const __m256i*)(Src + Idx * 4));
+		const __m256i RB = _mm256_and_si256(Pixels, MaskRB);
+		const __m256i BR = _mm256_or_si256(_mm256_slli_epi32(RB, 16), _mm256_srli_epi32(RB, 16));
+
+		_mm256_storeu_si256((__m256i*)(Dest + Idx * 4), _mm256_or_si256(_mm256_and_si256(Pixels, MaskAG), BR));
+	}
+
+	_mm256_zeroupper();
+	SwizzleRB_SSE2(Src + Idx * 4, Dest + Idx * 4, PixelCount - Idx);
+}
+
+
+static void InterleaveAlpha_AVX2(const uint8* Alpha, uint8* Dest, SIZE_T PixelCount)
+{
+	const __m256i MaskRGB = _mm256_set1_epi32(0x00ffffff);
+
+	SIZE_T Idx = 0;
+
+	for (; Idx + 8 <= PixelCount; Idx += 8)
+	{
+		const __m256i Alpha32 = _mm256_slli_epi32(
+			_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(Alpha + Idx))), 24);
+
+		__m256i* Pixels = (__m256i*)(Dest + Idx * 4);
+		const __m256i RGB = _mm256_and_si256(_mm256_loadu_si256(Pixels), MaskRGB);
+
+		_mm256_storeu_si256(Pixels, _mm256_or_si256(RGB, Alpha32));
+	}
+
+	_mm256_zeroupper();
+	InterleaveAlpha_SSE2(Alpha + Idx, Dest + Idx * 4, PixelCount - Idx);
+}
+
+
+static void DeinterleaveAlpha_AVX2(const uint8* Src, uint8* Alpha, SIZE_T PixelCount)
+{
+	// packs interleave the 128 bits lanes, put the 4 pixels groups back in order
+	const __m256i LaneOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	SIZE_T Idx = 0;
+
+	for (; Idx + 32 <= PixelCount; Idx += 32)
+	{
+		const __m256i* Pixels = (const __m256i*)(Src + Idx * 4);
+
+		const __m256i Alpha0 = _mm256_srli_epi32(_mm256_loadu_si256(Pixels + 0), 24);
+		const __m256i Alpha1 = _mm256_srli_epi32(_mm256_loadu_si256(Pixels + 1), 24);
+		const __m256i Alpha2 = _mm256_srli_epi32(_mm256_loadu_si256(Pixels + 2), 24);
+		const __m256i Alpha3 = _mm256_srli_epi32(_mm256_loadu_si256(Pixels + 3), 24);
+
+		const __m256i Alpha8 = _mm256_packus_epi16(
+			_mm256_packs_epi32(Alpha0, Alpha1),
+			_mm256_packs_epi32(Alpha2, Alpha3));
+
+		_mm256_storeu_si256((__m256i*)(Alpha + Idx), _mm256_permutevar8x32_epi32(Alpha8, LaneOrder));
+	}
+
+	_mm256_zeroupper();
+	DeinterleaveAlpha_SSE2(Src + Idx * 4, Alpha + Idx, PixelCount - Idx);
+}
+
+
+static void Fill32_AVX2(uint8* Dest, uint32 Value, SIZE_T PixelCount)
+{
+	const __m256i Values = _mm256_set1_epi32((int32)Value);
+
+	SIZE_T Idx = 0;
+
+	for (; Idx + 8 <= PixelCount; Idx += 8)
+	{
+		_mm256_storeu_si256((__m256i*)(Dest + Idx * 4), Values);
+	}
+
+	_mm256_zeroupper();
+	Fill32_SSE2(Dest + Idx * 4, Value, PixelCount - Idx);
+}
+
+
+static void Convert16To8_AVX2(const uint16* Src, uint8* Dest, SIZE_T Count)
+{
+	SIZE_T Idx = 0;
+
+	for (; Idx + 32 <= Count; Idx += 32)
+	{
+		const __m256i Lo = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(Src + Idx)), 8);
+		const __m256i Hi = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(Src + Idx + 16)), 8);
+
+		// pack interleaves the 128 bits lanes, put the 64 bits groups back in order
+		const __m256i Packed = _mm256_packus_epi16(Lo, Hi);
+
+		_mm256_storeu_si256((__m256i*)(Dest + Idx), _mm256_permute4x64_epi64(Packed, _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+
+	_mm256_zeroupper();
+	Convert16To8_SSE2(Src + Idx, Dest + Idx, Count - Idx);
+}
+
+
+static bool IsOpaque_AVX2(const uint8* Src, SIZE_T PixelCount)
+{
+	const __m256i MaskRGB = _mm256_set1_epi32(0x00ffffff);
+	const __m256i Ones = _mm256_set1_epi32(-1);
+
+	SIZE_T Idx = 0;
+	bool bOpaque = true;
+
+	for (; bOpaque && Idx + 32 <= PixelCount; Idx += 32)
+	{
+		const __m256i* Pixels = (const __m256i*)(Src + Idx * 4);
+
+		__m256i Acc = _mm256_and_si256(_mm256_loadu_si256(Pixels + 0), _mm256_loadu_si256(Pixels + 1));
+		Acc = _mm256_and_si256(Acc, _mm256_and_si256(_mm256_loadu_si256(Pixels + 2), _mm256_loadu_si256(Pixels + 3)));
+		Acc = _mm256_or_si256(Acc, MaskRGB);
+
+		bOpaque = _mm256_movemask_epi8(_mm256_cmpeq_epi8(Acc, Ones)) == -1;
+	}
+
+	_mm256_zeroupper();
+	return bOpaque && IsOpaque_SSE2(Src + Idx * 4, PixelCount - Idx);
+}
+
+
+static const FKernelTable GAVX2Kernels =
+{
+	&SwizzleRB_AVX2,
+	&InterleaveAlpha_AVX2,
+	&DeinterleaveAlpha_AVX2,
+	&Fill32_AVX2,
+	&Convert16To8_AVX2,
+	&IsOpaque_AVX2
+};
+
+
+//! @brief Return if the CPU and the OS support AVX2
+static bool IsAVX2Supported()
+{
+	int32 Info[4];
+
+	__cpuid(Info, 0);
+	if (Info[0] < 7)
+	{
+		return false;
+	}
+
+	// OSXSAVE and AVX
+	__cpuid(Info, 1);
+	if ((Info[2] & (1 << 27)) == 0 || (Info[2] & (1 << 28)) == 0)
+	{
+		return false;
+	}
+
+	// the OS saves the xmm and ymm registers
+	if ((_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+
+	__cpuidex(Info, 7, 0);
+	return (Info[1] & (1 << 5)) != 0;
+}
+
+#endif // SUBSTANCE_KERNELS_AVX2
+
+
+//! @brief Return the kernels of an instruction set, NULL if not built
+static const FKernelTable* GetKernelTable(EInstructionSet InstructionSet)
+{
+	switch (InstructionSet)
+	{
+	case IS_Scalar:
+		return &GScalarKernels;
+#if SUBSTANCE_KERNELS_SSE2
+	case IS_SSE2:
+		return &GSSE2Kernels;
+#endif
+#if SUBSTANCE_KERNELS_AVX2
+	case IS_AVX2:
+		return IsAVX2Supported() ? &GAVX2Kernels : NULL;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+
+//! @brief Return the best instruction set supported by the CPU
+static EInstructionSet GetBestInstructionSet()
+{
+	int32 Best = IS_Count - 1;
+
+	while (Best > IS_Scalar && GetKernelTable((EInstructionSet)Best) == NULL)
+	{
+		--Best;
+	}
+
+	return (EInstructionSet)Best;
+}
+
+
+static EInstructionSet GInstructionSet = GetBestInstructionSet();
+static const FKernelTable* GKernels = GetKernelTable(GInstructionSet);
+
+
+void SwizzleRB(const uint8* Src, uint8* Dest, SIZE_T PixelCount)
+{
+	GKernels->SwizzleRB(Src, Dest, PixelCount);
+}
+
+
+void InterleaveAlpha(const uint8* Alpha, uint8* Dest, SIZE_T PixelCount)
+{
+	GKernels->InterleaveAlpha(Alpha, Dest, PixelCount);
+}
+
+
+void DeinterleaveAlpha(const uint8* Src, uint8* Alpha, SIZE_T PixelCount)
+{
+	GKernels->DeinterleaveAlpha(Src, Alpha, PixelCount);
+}
+
+
+void Fill32(uint8* Dest, uint32 Value, SIZE_T PixelCount)
+{
+	GKernels->Fill32(Dest, Value, PixelCount);
+}
+
+
+void Convert16To8(const uint16* Src, uint8* Dest, SIZE_T Count)
+{
+	GKernels->Convert16To8(Src, Dest, Count);
+}
+
+
+bool IsOpaque(const uint8* Src, SIZE_T PixelCount)
+{
+	return GKernels->IsOpaque(Src, PixelCount);
+}
+
+
+EInstructionSet GetInstructionSet()
+{
+	return GInstructionSet;
+}
+
+
+bool IsSupported(EInstructionSet InstructionSet)
+{
+	return GetKernelTable(InstructionSet) != NULL;
+}
+
+
+bool SetInstructionSet(EInstructionSet InstructionSet)
+{
+	const FKernelTable* Kernels = GetKernelTable(InstructionSet);
+
+	if (Kernels == NULL)
+	{
+		return false;
+	}
+
+	GInstructionSet = InstructionSet;
+	GKernels = Kernels;
+
+	return true;
+}
+
+
+const TCHAR* GetInstructionSetName(EInstructionSet InstructionSet)
+{
+	switch (InstructionSet)
+	{
+	case IS_Scalar: return TEXT("Scalar");
+	case IS_SSE2: return TEXT("SSE2");
+	case IS_AVX2: return TEXT("AVX2");
+	default: return TEXT("Unknown");
+	}
+}
+
+
+//! @brief Run every kernel w/ each supported instruction set and log the throughput
+//! Bytes read and written are counted, buffers are larger than the caches.
+//! The kernels are called through their tables, the uploads in flight keep
+//! the instruction set in use.
+static void BenchmarkKernels()
+{
+	const SIZE_T PixelCount = 2048 * 2048;
+	const int32 Iterations = 8;
+
+	TArray<uint8> Pixels;
+	TArray<uint8> Alpha;
+	TArray<uint16> Channels;
+
+	Pixels.AddUninitialized(PixelCount * 4);
+	Alpha.AddUninitialized(PixelCount);
+	Channels.AddUninitialized(PixelCount);
+
+	// opaque pixels, Fill32 runs last before IsOpaque so that it reads them all
+	FMemory::Memset(Pixels.GetData(), 255, Pixels.Num());
+	FMemory::Memset(Alpha.GetData(), 255, Alpha.Num());
+	FMemory::Memset(Channels.GetData(), 0x80, Channels.Num() * sizeof(uint16));
+
+	const TCHAR* Names[] = {
+		TEXT("SwizzleRB"),
+		TEXT("InterleaveAlpha"),
+		TEXT("DeinterleaveAlpha"),
+		TEXT("Fill32"),
+		TEXT("Convert16To8"),
+		TEXT("IsOpaque") };
+
+	const SIZE_T BytesPerPixel[] = { 8, 9, 5, 4, 3, 4 };
+
+	double ScalarSeconds[ARRAY_COUNT(Names)] = { 0.0 };
+
+	for (int32 Set = IS_Scalar; Set < IS_Count; ++Set)
+	{
+		const FKernelTable* Kernels = GetKernelTable((EInstructionSet)Set);
+
+		if (Kernels == NULL)
+		{
+			continue;
+		}
+
+		for (int32 Kernel = 0; Kernel < ARRAY_COUNT(Names); ++Kernel)
+		{
+			bool bOpaque = true;
+
+			const double Start = FPlatformTime::Seconds();
+
+			for (int32 Idx = 0; Idx < Iterations; ++Idx)
+			{
+				switch (Kernel)
+				{
+				case 0: Kernels->SwizzleRB(Pixels.GetData(), Pixels.GetData(), PixelCount); break;
+				case 1: Kernels->InterleaveAlpha(Alpha.GetData(), Pixels.GetData(), PixelCount); break;
+				case 2: Kernels->DeinterleaveAlpha(Pixels.GetData(), Alpha.GetData(), PixelCount); break;
+				case 3: Kernels->Fill32(Pixels.GetData(), 0xffffffff, PixelCount); break;
+				case 4: Kernels->Convert16To8(Channels.GetData(), Alpha.GetData(), PixelCount); break;
+				case 5: bOpaque = Kernels->IsOpaque(Pixels.GetData(), PixelCount) && bOpaque; break;
+				}
+			}
+
+			const double Seconds = FMath::Max(FPlatformTime::Seconds() - Start, 1e-6);
+
+			ScalarSeconds[Kernel] = Set == IS_Scalar ? Seconds : ScalarSeconds[Kernel];
+
+			UE_LOG(LogSubstanceKernels, Log, TEXT("%s %s: %.2f GB/s, speedup %.2f%s"),
+				GetInstructionSetName((EInstructionSet)Set),
+				Names[Kernel],
+				(double)(PixelCount * BytesPerPixel[Kernel] * Iterations) / Seconds / 1e9,
+				ScalarSeconds[Kernel] / Seconds,
+				bOpaque ? TEXT("") : TEXT(" (not opaque)"));
+		}
+	}
+}
+
+static FAutoConsoleCommand SubstanceKernelsBenchmarkCommand(
+	TEXT("Substance.Kernels.Benchmark"),
+	TEXT("Runs the pixel conversion kernels w/ each instruction set supported and logs the throughput."),
+	FConsoleCommandDelegate::CreateStatic(&BenchmarkKernels));
+
+} // namespace Kernels
+} // namespace Substance
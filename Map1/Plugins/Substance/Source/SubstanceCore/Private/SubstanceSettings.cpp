@@ -8,7 +8,25 @@ USubstanceSettings::USubstanceSettings(const FObjectInitializer& PCIP)
 	: Super(PCIP)
 	, MemoryBudgetMb(256)
 	, CPUCores(2)
+	, RendererShardCount(1)
+	, bShardRenderingByPackage(true)
+	, RuntimeBatchTargetMs(200)
+	, OutputDeliveryBudgetMs(2)
+	, OutputDeliveryBudgetMb(32)
+	, OutputBacklogBudgetMb(256)
 	, AsyncLoadMipClip(3)
+	, DefaultOutputCompression(SOC_None)
+	, bMemoryMappedCacheReads(true)
+	, AsyncCacheReadBudgetMb(64)
+	, bPackedCache(false)
+	, bCompressedCache(false)
+	, bProgressiveCacheReads(false)
+	, ProgressiveCacheTailSize(128)
+	, ProgressiveCacheFrameBudgetMb(16)
+	, MemoryCacheBudgetMb(256)
+	, CacheBudgetMb(4096)
+	, LinkerCacheBudgetMb(32)
+	, bLinkerCacheOnDisk(true)
 {
 
 }
@@ -10,6 +10,7 @@
 #include "SubstanceGraphInstance.h"
 #include "SubstanceInput.h"
 #include "SubstanceCallbacks.h"
+#include "SubstanceCache.h"
 #include "SubstanceTexture2D.h"
 #include "framework/details/detailsrendertoken.h"
 #include "substance_public.h"
@@ -60,6 +61,8 @@ FOutputInstance::FOutputInstance():
 	OutputGuid(FGuid::NewGuid()),
 	bIsEnabled(false),
 	bIsDirty(true),
+	bIsRenderCanceled(false),
+	QueuedForUpload(0),
 	Texture(std::shared_ptr<USubstanceTexture2D*>(new USubstanceTexture2D*))
 {
 	*(Texture.get()) = NULL;
@@ -72,6 +75,8 @@ FOutputInstance::FOutputInstance(const FOutputInstance& Other)
 	Format = Other.Format;
 	OutputGuid = Other.OutputGuid;
 	bIsEnabled = Other.bIsEnabled;
+	bIsRenderCanceled = false;
+	QueuedForUpload = 0;
 	ParentInstance = Other.ParentInstance;
 	RenderTokens.clear();
 
@@ -154,6 +159,12 @@ void FOutputInstance::push(const Token& rtokenptr)
 bool FOutputInstance::queueRender()
 {
 	check(*Texture);
+
+	if (bIsRenderCanceled)
+	{
+		return false;
+	}
+
 	bool res = bIsDirty;
 	bIsDirty = false;
 	(*Texture)->OutputCopy->bIsDirty = true;
@@ -161,6 +172,56 @@ bool FOutputInstance::queueRender()
 }
 
 
+FString FOutputInstance::getCacheKey() const
+{
+	return Helpers::ShouldCacheOutput(this) ?
+		SubstanceCache::Get()->GetKeyForOutput(*this) :
+		FString();
+}
+
+
+bool FOutputInstance::cancelRender()
+{
+	bool bCanceled = false;
+
+	// computed results waiting for upload are released
+	for (auto ite = RenderTokens.itfront(); ite; ++ite)
+	{
+		if (!(*ite)->isRenderCanceled())
+		{
+			bCanceled = (*ite)->cancelRender() || bCanceled;
+		}
+	}
+
+	RenderCallbacks::clearComputedOutputs(this);
+
+	// computed again by the next render of the instance
+	bIsDirty = true;
+	bIsRenderCanceled = true;
+
+	return bCanceled;
+}
+
+
+float FOutputInstance::getRenderProgress() const
+{
+	// canceled tokens are filled w/o result, the texture is not updated
+	if (bIsRenderCanceled)
+	{
+		return 0.0f;
+	}
+
+	if (RenderTokens.size() == 0)
+	{
+		return 1.0f;
+	}
+
+	const Token& Latest = RenderTokens[RenderTokens.size() - 1];
+
+	return Latest->isRenderCanceled() ? 0.0f : Latest->getProgress();
+}
+
+
 //! @brief Internal use only
 void FOutputInstance::releaseTokensOwnedByEngine(uint32 engineUid)
 {
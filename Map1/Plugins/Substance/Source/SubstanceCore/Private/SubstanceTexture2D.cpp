@@ -12,6 +12,7 @@
 #include "SubstanceTexture2D.h"
 #include "SubstanceSettings.h"
 #include "SubstanceTexture2DDynamicResource.h"
+#include "SubstancePixelKernels.h"
 
 #if WITH_EDITOR
 #include "ObjectTools.h"
@@ -21,6 +22,101 @@
 
 DEFINE_LOG_CATEGORY_STATIC(LogSubstanceTexture, Warning, All);
 
+
+FSubstanceMipBuffer::FSubstanceMipBuffer(const SubstanceTexture& InResult, EPixelFormat InFormat, const TIndirectArray<FTexture2DMipMap>& Mips) :
+	Result(InResult),
+	Format(InFormat),
+	BufferSize(0)
+{
+	MipSizes.Empty(Mips.Num());
+	MipOffsets.Empty(Mips.Num());
+
+	for (int32 MipIndex = 0; MipIndex < Mips.Num(); ++MipIndex)
+	{
+		MipSizes.Add(FIntPoint(Mips[MipIndex].SizeX, Mips[MipIndex].SizeY));
+		MipOffsets.Add(BufferSize);
+		BufferSize += CalculateImageBytes(Mips[MipIndex].SizeX, Mips[MipIndex].SizeY, 0, Format);
+	}
+
+	// rgba8 results go to bgra8 textures: swizzled here, in row blocks on task
+	// threads, so that the rendering thread only copies them
+	if (Format == PF_B8G8R8A8)
+	{
+		for (int32 MipIndex = 0; MipIndex < MipSizes.Num(); ++MipIndex)
+		{
+			uint8* MipData = (uint8*)Result.buffer + MipOffsets[MipIndex];
+			const uint32 Pitch = MipSizes[MipIndex].X * 4;
+			const uint32 SizeX = MipSizes[MipIndex].X;
+
+			Substance::Helpers::ParallelForRows(MipSizes[MipIndex].Y, Pitch, [=](int32 FirstRow, int32 RowCount)
+			{
+				uint8* Rows = MipData + FirstRow * Pitch;
+				Substance::Kernels::SwizzleRB(Rows, Rows, (SIZE_T)SizeX * RowCount);
+			});
+		}
+	}
+}
+
+
+FSubstanceMipBuffer::~FSubstanceMipBuffer()
+{
+	// allocated through the engine malloc callback
+	FMemory::Free(Result.buffer);
+}
+
+
+void CopySubstanceMip(const void* Src, void* Dest, uint32 SizeX, uint32 SizeY, EPixelFormat Format, uint32 DestPitch)
+{
+	// for platforms that returned 0 pitch from Lock, we need to just use the bulk data directly, never do 
+	// runtime block size checking, conversion, or the like
+	if (DestPitch == 0)
+	{
+		FMemory::Memcpy(Dest, Src, CalculateImageBytes(SizeX, SizeY, 0, Format));
+	}
+	else
+	{
+		const uint32 BlockSizeX = GPixelFormats[Format].BlockSizeX;		// Block width in pixels
+		const uint32 BlockBytes = GPixelFormats[Format].BlockBytes;
+		uint32 NumColumns		= (SizeX + BlockSizeX - 1) / BlockSizeX;	// Num-of columns in the source data (in blocks)
+		if ( Format == PF_PVRTC2 || Format == PF_PVRTC4 )
+		{
+			// PVRTC has minimum 2 blocks width and height
+			NumColumns = FMath::Max<uint32>(NumColumns, 2);
+		}
+		const uint32 SrcPitch   = NumColumns * BlockBytes;						// Num-of bytes per row in the source data
+
+		// Copy the texture data.
+		CopyTextureData2D(Src,Dest,SizeY,Format,SrcPitch,DestPitch);
+	}
+}
+
+
+/** Copy the adopted mip buffer in the mips bulk data, to serialize them. */
+static void CopyMipBufferToBulkData(USubstanceTexture2D* Texture)
+{
+	const FSubstanceMipBuffer& Buffer = *Texture->MipBuffer;
+
+	Texture->MipsFence.Wait();
+
+	for (int32 MipIndex = 0; MipIndex < Texture->Mips.Num(); ++MipIndex)
+	{
+		FTexture2DMipMap& MipMap = Texture->Mips[MipIndex];
+		const SIZE_T ImageSize = CalculateImageBytes(MipMap.SizeX, MipMap.SizeY, 0, Texture->Format);
+
+		MipMap.BulkData = FByteBulkData();
+		MipMap.BulkData.Lock(LOCK_READ_WRITE);
+		void* TheMipDataPtr = MipMap.BulkData.Realloc(ImageSize);
+
+		// bulk data rows are packed
+		CopySubstanceMip(Buffer.GetMipData(MipIndex), TheMipDataPtr, MipMap.SizeX, MipMap.SizeY, Texture->Format, 0);
+
+		MipMap.BulkData.ClearBulkDataFlags(BULKDATA_SingleUse);
+		MipMap.BulkData.Unlock();
+	}
+
+	Texture->MipBuffer.Reset();
+}
+
 USubstanceTexture2D::USubstanceTexture2D(class FObjectInitializer const & PCIP) : Super(PCIP)
 {
 
@@ -35,6 +131,13 @@ FString USubstanceTexture2D::GetDesc()
 
 void USubstanceTexture2D::Serialize(FArchive& Ar)
 {
+	// only package saves need the mips in the bulk data, releasing the adopted
+	// buffer; transactions and other in-memory saves leave it uploading
+	if (Ar.IsSaving() && Ar.IsPersistent() && !Ar.IsTransacting() && MipBuffer.IsValid())
+	{
+		CopyMipBufferToBulkData(this);
+	}
+
 	Super::Serialize(Ar);
 
 	Ar << Format;
@@ -339,65 +442,85 @@ void USubstanceTexture2D::UpdateResource()
 	{
 		struct FUpdateSubstanceTexture
 		{
-			FTexture2DDynamicResource* Resource;
+			FSubstanceTexture2DDynamicResource* Resource;
 			USubstanceTexture2D* Owner;
+			FSubstanceMipBufferPtr MipBuffer;
 		};
 
 		FUpdateSubstanceTexture* SubstanceData = new FUpdateSubstanceTexture;
 
-		SubstanceData->Resource = (FTexture2DDynamicResource*)Resource;
+		SubstanceData->Resource = (FSubstanceTexture2DDynamicResource*)Resource;
 		SubstanceData->Owner = this;
 
+		// kept alive until uploaded, the next result may replace it meanwhile
+		SubstanceData->MipBuffer = MipBuffer;
+
 		ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
 			UpdateSubstanceTexture,
 			FUpdateSubstanceTexture*,SubstanceData,SubstanceData,
 		{
+			const FSubstanceMipBuffer* AdoptedBuffer = SubstanceData->MipBuffer.Get();
+			const int32 MipCount = AdoptedBuffer ? AdoptedBuffer->MipSizes.Num() : SubstanceData->Owner->Mips.Num();
+
 			// Read the resident mip-levels into the RHI texture.
-			for( int32 MipIndex=0; MipIndex<SubstanceData->Owner->Mips.Num(); MipIndex++ )
+			for( int32 MipIndex=0; MipIndex<MipCount; MipIndex++ )
 			{
 				uint32 DestPitch;
 				void* TheMipData = RHILockTexture2D( SubstanceData->Resource->GetTexture2DRHI(), MipIndex, RLM_WriteOnly, DestPitch, false );
 
-				FTexture2DMipMap& MipMap = SubstanceData->Owner->Mips[MipIndex];
-
-				// for platforms that returned 0 pitch from Lock, we need to just use the bulk data directly, never do 
-				// runtime block size checking, conversion, or the like
-				if (DestPitch == 0)
+				if (AdoptedBuffer)
 				{
-					FMemory::Memcpy(TheMipData, MipMap.BulkData.Lock(LOCK_READ_ONLY), MipMap.BulkData.GetBulkDataSize());
+					// the adopted render result is read in place
+					CopySubstanceMip(AdoptedBuffer->GetMipData(MipIndex), TheMipData,
+						AdoptedBuffer->MipSizes[MipIndex].X, AdoptedBuffer->MipSizes[MipIndex].Y,
+						AdoptedBuffer->Format, DestPitch);
 				}
 				else
 				{
-					EPixelFormat PixelFormat = SubstanceData->Owner->Format;
-					const uint32 BlockSizeX = GPixelFormats[PixelFormat].BlockSizeX;		// Block width in pixels
-					const uint32 BlockSizeY = GPixelFormats[PixelFormat].BlockSizeY;		// Block height in pixels
-					const uint32 BlockBytes = GPixelFormats[PixelFormat].BlockBytes;
-					uint32 NumColumns		= (MipMap.SizeX + BlockSizeX - 1) / BlockSizeX;	// Num-of columns in the source data (in blocks)
-					uint32 NumRows			= (MipMap.SizeY + BlockSizeY - 1) / BlockSizeY;	// Num-of rows in the source data (in blocks)
-					if ( PixelFormat == PF_PVRTC2 || PixelFormat == PF_PVRTC4 )
-					{
-						// PVRTC has minimum 2 blocks width and height
-						NumColumns = FMath::Max<uint32>(NumColumns, 2);
-						NumRows = FMath::Max<uint32>(NumRows, 2);
-					}
-					const uint32 SrcPitch   = NumColumns * BlockBytes;						// Num-of bytes per row in the source data
-					const uint32 EffectiveSize = BlockBytes*NumColumns*NumRows;
-
-					// Copy the texture data.
-					CopyTextureData2D(MipMap.BulkData.Lock(LOCK_READ_ONLY),TheMipData,MipMap.SizeY,PixelFormat,SrcPitch,DestPitch);
-				}
+					FTexture2DMipMap& MipMap = SubstanceData->Owner->Mips[MipIndex];
 
-				MipMap.BulkData.Unlock();
+					CopySubstanceMip(MipMap.BulkData.Lock(LOCK_READ_ONLY), TheMipData, MipMap.SizeX, MipMap.SizeY,
+						SubstanceData->Owner->Format, DestPitch);
+
+					MipMap.BulkData.Unlock();
+				}
 
 				RHIUnlockTexture2D( SubstanceData->Resource->GetTexture2DRHI(), MipIndex, false );
 			}
 
 			delete SubstanceData;
 		});
+
+		// the game thread waits for it before changing the mips
+		if (!MipBuffer.IsValid())
+		{
+			MipsFence.BeginFence();
+		}
 	}
 }
 
 
+void USubstanceTexture2D::UpdateMips()
+{
+	if (!Resource || !MipBuffer.IsValid())
+	{
+		UpdateResource();
+		return;
+	}
+
+	FSubstanceTexture2DDynamicResource* SubstanceResource = (FSubstanceTexture2DDynamicResource*)Resource;
+	FSubstanceMipBufferPtr StagedBuffer = MipBuffer;
+
+	ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(
+		UpdateSubstanceMips,
+		FSubstanceTexture2DDynamicResource*,SubstanceResource,SubstanceResource,
+		FSubstanceMipBufferPtr,StagedBuffer,StagedBuffer,
+	{
+		SubstanceResource->UpdateMips(*StagedBuffer);
+	});
+}
+
+
 /** Create RHI sampler states. */
 void FSubstanceTexture2DDynamicResource::CreateSamplerStates(float MipMapBias)
 {
@@ -459,8 +582,10 @@ void FSubstanceTexture2DDynamicResource::InitRHI()
 	{
 		Flags |= TexCreate_NoTiling;
 	}
+	CreateFlags = Flags;
+
 	FRHIResourceCreateInfo CreateInfo;
-	Texture2DRHI = RHICreateTexture2D(GetSizeX(), GetSizeY(), SubstanceOwner->Format, SubstanceOwner->NumMips, 1, Flags, CreateInfo);
+	Texture2DRHI = RHICreateTexture2D(GetSizeX(), GetSizeY(), Format, NumMips, 1, Flags, CreateInfo);
 	TextureRHI = Texture2DRHI;
 	RHIUpdateTextureReference(SubstanceOwner->TextureReference.TextureReferenceRHI, TextureRHI);
 }
@@ -481,3 +606,33 @@ FTexture2DRHIRef FSubstanceTexture2DDynamicResource::GetTexture2DRHI()
 	return Texture2DRHI;
 }
 
+
+/** Upload a result in a new RHI texture, swapped in once filled. */
+void FSubstanceTexture2DDynamicResource::UpdateMips(const FSubstanceMipBuffer& MipBuffer)
+{
+	SizeX = MipBuffer.MipSizes.Num() ? MipBuffer.MipSizes[0].X : 0;
+	SizeY = MipBuffer.MipSizes.Num() ? MipBuffer.MipSizes[0].Y : 0;
+	NumMips = MipBuffer.MipSizes.Num();
+	Format = MipBuffer.Format;
+	bGreyScaleFormat = (Format == PF_G8 || Format == PF_G16);
+
+	FRHIResourceCreateInfo CreateInfo;
+	FTexture2DRHIRef StagedTexture = RHICreateTexture2D(SizeX, SizeY, Format, NumMips, 1, CreateFlags, CreateInfo);
+
+	for (int32 MipIndex = 0; MipIndex < NumMips; ++MipIndex)
+	{
+		uint32 DestPitch;
+		void* TheMipData = RHILockTexture2D(StagedTexture, MipIndex, RLM_WriteOnly, DestPitch, false);
+
+		CopySubstanceMip(MipBuffer.GetMipData(MipIndex), TheMipData, MipBuffer.MipSizes[MipIndex].X, MipBuffer.MipSizes[MipIndex].Y,
+			Format, DestPitch);
+
+		RHIUnlockTexture2D(StagedTexture, MipIndex, false);
+	}
+
+	// the previous texture is released once the frames in flight are done with it
+	Texture2DRHI = StagedTexture;
+	TextureRHI = StagedTexture;
+	RHIUpdateTextureReference(SubstanceOwner->TextureReference.TextureReferenceRHI, TextureRHI);
+}
+
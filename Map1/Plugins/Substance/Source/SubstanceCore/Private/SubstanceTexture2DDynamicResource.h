@@ -7,13 +7,57 @@
 
 #include "TextureResource.h"
 
+#include "substance_public.h"
+
+/** A render result adopted as the mip storage of a texture, instead of copied in its mips bulk data.
+ *  Immutable once created, uploads read it from the rendering thread while the next result is staged. */
+struct FSubstanceMipBuffer
+{
+	/** Take ownership of the result buffer, allocated by the engine, swizzled to bgra8 for bgra8 textures. */
+	FSubstanceMipBuffer(const SubstanceTexture& InResult, EPixelFormat InFormat, const TIndirectArray<FTexture2DMipMap>& Mips);
+
+	/** Free the result buffer. */
+	~FSubstanceMipBuffer();
+
+	/** Returns the content of a mip. */
+	const uint8* GetMipData(int32 MipIndex) const
+	{
+		return (const uint8*)Result.buffer + MipOffsets[MipIndex];
+	}
+
+	/** The adopted result. */
+	SubstanceTexture Result;
+
+	/** Pixel format of the texture. */
+	EPixelFormat Format;
+
+	/** Dimensions of each mip. */
+	TArray<FIntPoint> MipSizes;
+
+	/** Offset of each mip in the result buffer. */
+	TArray<SIZE_T> MipOffsets;
+
+	/** Size of the result buffer. */
+	SIZE_T BufferSize;
+};
+
+typedef TSharedPtr<FSubstanceMipBuffer, ESPMode::ThreadSafe> FSubstanceMipBufferPtr;
+
+/** Copy a mip of a texture in a locked RHI texture, on the calling thread. */
+void CopySubstanceMip(const void* Src, void* Dest, uint32 SizeX, uint32 SizeY, EPixelFormat Format, uint32 DestPitch);
+
 /** A dynamic 2D texture resource. */
 class FSubstanceTexture2DDynamicResource : public FTextureResource
 {
 public:
 	/** Initialization constructor. */
 	FSubstanceTexture2DDynamicResource(class USubstanceTexture2D* InOwner) : 
-		SubstanceOwner(InOwner)
+		SubstanceOwner(InOwner),
+		SizeX(InOwner->Mips.Num() ? InOwner->Mips[0].SizeX : 0),
+		SizeY(InOwner->Mips.Num() ? InOwner->Mips[0].SizeY : 0),
+		NumMips(InOwner->NumMips),
+		Format(InOwner->Format),
+		CreateFlags(0)
 	{
 		if (SubstanceOwner->Format == PF_G8 || 
 			SubstanceOwner->Format == PF_G16)
@@ -25,23 +69,13 @@ public:
 	/** Returns the width of the texture in pixels. */
 	virtual uint32 GetSizeX() const override
 	{
-		if (SubstanceOwner && SubstanceOwner->Mips.Num())
-		{
-			return SubstanceOwner->Mips[0].SizeX;
-		}
-
-		return 0;
+		return SizeX;
 	}
 
 	/** Returns the height of the texture in pixels. */
 	virtual uint32 GetSizeY() const override
 	{
-		if (SubstanceOwner && SubstanceOwner->Mips.Num())
-		{
-			return SubstanceOwner->Mips[0].SizeY;
-		}
-
-		return 0;
+		return SizeY;
 	}
 
 	/** Create RHI sampler states. */
@@ -56,8 +90,21 @@ public:
 	/** Returns the Texture2DRHI, which can be used for locking/unlocking the mips. */
 	FTexture2DRHIRef GetTexture2DRHI();
 
+	/** Upload a result in a new RHI texture, swapped in once filled. The current RHI texture
+	 *  stays valid for the frames in flight. This is only called by the rendering thread. */
+	void UpdateMips(const FSubstanceMipBuffer& MipBuffer);
+
 private:
 	USubstanceTexture2D* SubstanceOwner;
 
 	FTexture2DRHIRef Texture2DRHI;
+
+	/** Dimensions and format of the RHI texture, the owner's mips change on the game thread. */
+	uint32 SizeX;
+	uint32 SizeY;
+	int32 NumMips;
+	EPixelFormat Format;
+
+	/** Creation flags of the RHI texture. */
+	uint32 CreateFlags;
 };
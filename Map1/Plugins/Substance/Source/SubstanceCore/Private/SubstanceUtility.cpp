@@ -248,3 +248,77 @@ void USubstanceUtility::AsyncRendering(USubstanceGraphInstance* GraphInstance)
 
 	Substance::Helpers::RenderAsync(GraphInstance->Instance);
 }
+
+
+//! @brief The output instance of a graph instance rendering this texture
+static output_inst_t* FindOutputInstance(USubstanceTexture2D* Texture)
+{
+	if (!Texture ||
+		!Texture->OutputCopy ||
+		!Texture->ParentInstance ||
+		!Texture->ParentInstance->Instance)
+	{
+		return NULL;
+	}
+
+	Substance::List<output_inst_t>::TIterator
+		ItOut(Texture->ParentInstance->Instance->Outputs.itfront());
+
+	for (; ItOut; ++ItOut)
+	{
+		if ((*ItOut).Uid == Texture->OutputCopy->Uid)
+		{
+			return &(*ItOut);
+		}
+	}
+
+	return NULL;
+}
+
+
+void USubstanceUtility::CancelRendering(USubstanceGraphInstance* GraphInstance)
+{
+	if (!GraphInstance || !GraphInstance->Instance)
+	{
+		return;
+	}
+
+	Substance::Helpers::CancelRender(GraphInstance->Instance);
+}
+
+
+void USubstanceUtility::CancelTextureRendering(USubstanceTexture2D* Texture)
+{
+	output_inst_t* OutputInstance = FindOutputInstance(Texture);
+
+	if (!OutputInstance)
+	{
+		return;
+	}
+
+	Substance::Helpers::CancelRender(OutputInstance);
+}
+
+
+float USubstanceUtility::GetRenderingProgress(USubstanceGraphInstance* GraphInstance)
+{
+	if (!GraphInstance || !GraphInstance->Instance)
+	{
+		return 1.0f;
+	}
+
+	return Substance::Helpers::GetRenderProgress(GraphInstance->Instance);
+}
+
+
+float USubstanceUtility::GetTextureRenderingProgress(USubstanceTexture2D* Texture)
+{
+	output_inst_t* OutputInstance = FindOutputInstance(Texture);
+
+	if (!OutputInstance)
+	{
+		return 1.0f;
+	}
+
+	return Substance::Helpers::GetRenderProgress(OutputInstance);
+}
@@ -16,6 +16,7 @@
 #include "framework/details/detailslinkgraphs.h"
 #include "framework/details/detailslinkcontext.h"
 #include "framework/details/detailslinkdata.h"
+#include "framework/details/detailslinkcache.h"
 #include "framework/details/detailsrendererimpl.h"
 #include "framework/renderresult.h"
 #include "framework/renderopt.h"
@@ -213,7 +214,8 @@ Substance::Details::Engine::Engine(const RenderOptions& renderOptions) :
 	mLinkerContext(NULL),
 	mLinkerHandle(NULL),
 	mCurrentLinkContext(NULL),
-	mPendingReleaseTextures(false)
+	mPendingReleaseTextures(false),
+	mHandleFromCache(false)
 {
 	fillHardResources(mHardResources,renderOptions);
 	createLinker();
@@ -298,12 +300,108 @@ bool Substance::Details::Engine::link(RenderJob* renderJobBegin)
 		linkgraphs.merge(renderJobBegin->getLinkGraphs());
 	}
 
+	size_t sbsbindataindex = mSbsbinDatas[0].empty() ? 0 : 1;
+	std::string &sbsbindata = mSbsbinDatas[sbsbindataindex];
+	check(mSbsbinDatas[0].empty()||mSbsbinDatas[1].empty());
+
+	// Reuse a previous link of the same graphs. Only w/o current handle: the
+	// cache transfer needs the linker mapping from the current SBSBIN.
+	const FSHAHash linkKey = LinkCache::computeKey(linkgraphs);
+	LinkCache::EntryPtr cached;
+	if (mHandle==NULL)
+	{
+		cached = LinkCache::get().find(linkKey);
+	}
+
+	if (cached.get()!=NULL && LinkCache::restoreUids(*cached,linkgraphs))
+	{
+		sbsbindata = cached->sbsbin;
+
+		// The linker mapping does not describe this SBSBIN but is kept: it
+		// is owned by the linker and only freed when passed back as previous
+		// mapping by the next real link (or on linker release). It is never
+		// used meanwhile, no transfer from a handle built from the cache.
+	}
+	else
+	{
+		cached.reset();
+		linkSbsbin(linkgraphs,sbsbindata,linkKey);
+	}
+	
+	// Create Substance context if necessary, done on render thread(required
+	//	by some impl.) 
+	if (mContextInstance.get() == NULL)
+	{
+		mContextInstance.reset(new Context(*this, callbacks));
+	}
+
+	// Create new handle
+	SubstanceHandle *newhandle = NULL;
+	res = SubstanceHandleInit(&newhandle,
+				mContextInstance->getContext(),
+				(unsigned char*)sbsbindata.data(),
+				sbsbindata.size(),
+				mHardResources,
+				(size_t)this);
+	check(res==0);
+	
+	// Switch handle
+	{
+		// Scoped modification
+		Sync::unique_lock slock(mMutexHandle);
+		
+		if (mHandle!=NULL)
+		{
+			// Transfer, unless the previous SBSBIN came from the link cache
+			if (!mHandleFromCache)
+			{
+				res = SubstanceHandleTransferCache(
+					newhandle,
+					mHandle,
+					mLinkerCacheData);
+				check(res==0);
+			}
+	
+			// Delete previous handle
+			res = SubstanceHandleRelease(mHandle);
+			check(res==0);
+			
+			// Erase previous sbsbin data
+			mSbsbinDatas[sbsbindataindex^1].resize(0);
+		}
+		
+		// Use new one
+		mHandle = newhandle;
+		mHandleFromCache = cached.get()!=NULL;
+	}
+	
+	// Fill Graph binary SBSBIN indices
+	fillIndices(linkgraphs);
+	
+	return true;
+}
+
+
+//! @brief Run the linker on graph states and record the result
+//! @param linkGraphs Graph states to link, translated UIDs filled
+//! @param sbsbinData Receive the linked SBSBIN
+//! @param linkKey Key of this link in the link cache
+void Substance::Details::Engine::linkSbsbin(
+	LinkGraphs& linkGraphs,
+	std::string& sbsbinData,
+	const FSHAHash& linkKey)
+{
+	uint32 res;
+	(void)res;
+
+	const double startTime = FPlatformTime::Seconds();
+
 	TArray<unsigned int> enabledIds;
 
 	// Push all states to link
 	SBS_VECTOR_FOREACH (
 		const LinkGraphs::GraphStatePtr& graphstateptr,
-		linkgraphs.graphStates)
+		linkGraphs.graphStates)
 	{
 		LinkContext linkContext(
 			mLinkerHandle,
@@ -333,9 +431,6 @@ bool Substance::Details::Engine::link(RenderJob* renderJobBegin)
 	}
 		
 	// Link, Grab assembly
-	size_t sbsbindataindex = mSbsbinDatas[0].empty() ? 0 : 1;
-	std::string &sbsbindata = mSbsbinDatas[sbsbindataindex];
-	check(mSbsbinDatas[0].empty()||mSbsbinDatas[1].empty());
 	{
 		const unsigned char* resultData = NULL;
 		size_t resultSize = 0;
@@ -345,7 +440,7 @@ bool Substance::Details::Engine::link(RenderJob* renderJobBegin)
 			&resultSize);
 		check(res==0);
 	
-		sbsbindata.assign((const char*)resultData,resultSize);
+		sbsbinData.assign((const char*)resultData,resultSize);
 	}
 
 	// Grab new cache data blob
@@ -354,54 +449,13 @@ bool Substance::Details::Engine::link(RenderJob* renderJobBegin)
 		&mLinkerCacheData,
 		mLinkerCacheData);
 	check(res==0);
-	
-	// Create Substance context if necessary, done on render thread(required
-	//	by some impl.) 
-	if (mContextInstance.get() == NULL)
-	{
-		mContextInstance.reset(new Context(*this, callbacks));
-	}
 
-	// Create new handle
-	SubstanceHandle *newhandle = NULL;
-	res = SubstanceHandleInit(&newhandle,
-				mContextInstance->getContext(),
-				(unsigned char*)sbsbindata.data(),
-				sbsbindata.size(),
-				mHardResources,
-				(size_t)this);
-	check(res==0);
-	
-	// Switch handle
-	{
-		// Scoped modification
-		Sync::unique_lock slock(mMutexHandle);
-		
-		if (mHandle!=NULL)
-		{
-			// Transfer
-			res = SubstanceHandleTransferCache(
-				newhandle,
-				mHandle,
-				mLinkerCacheData);
-			check(res==0);
-	
-			// Delete previous handle
-			res = SubstanceHandleRelease(mHandle);
-			check(res==0);
-			
-			// Erase previous sbsbin data
-			mSbsbinDatas[sbsbindataindex^1].resize(0);
-		}
-		
-		// Use new one
-		mHandle = newhandle;
-	}
-	
-	// Fill Graph binary SBSBIN indices
-	fillIndices(linkgraphs);
-	
-	return true;
+	// Memoize for next renderers linking the same graphs
+	std::shared_ptr<LinkCache::Entry> entry(new LinkCache::Entry);
+	entry->sbsbin = sbsbinData;
+	entry->linkSeconds = FPlatformTime::Seconds()-startTime;
+	LinkCache::grabUids(*entry,linkGraphs);
+	LinkCache::get().insert(linkKey,entry);
 }
 
 
@@ -494,6 +548,36 @@ void Substance::Details::Engine::clearCache()
 }
 
 
+//! @brief Release the handle and linked SBSBIN, w/ the engine cache
+//! Context and linker are kept, next link creates a new handle.
+//! @pre No render currently running, graph states already linked
+//!		released
+void Substance::Details::Engine::trim()
+{
+	{
+		Sync::unique_lock slock(mMutexHandle);
+
+		if (mHandle!=NULL)
+		{
+			unsigned int res = SubstanceHandleRelease(mHandle);
+			(void)res;
+			mHandle = NULL;
+			check(res==0);
+		}
+
+		// No handle to transfer the cache from at next link
+		mHandleFromCache = false;
+	}
+
+	// Release capacity too
+	std::string().swap(mSbsbinDatas[0]);
+	std::string().swap(mSbsbinDatas[1]);
+
+	// Release pending textures
+	releaseTextures();
+}
+
+
 void Substance::Details::Engine::fillHardResources(
 	SubstanceHardResources& hardRsc,
 	const RenderOptions& renderOptions)
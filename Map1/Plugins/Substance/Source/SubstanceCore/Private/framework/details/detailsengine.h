@@ -69,6 +69,12 @@ public:
 
 	//! @brief 
 	void clearCache();
+
+	//! @brief Release the handle and linked SBSBIN, w/ the engine cache
+	//! Context and linker are kept, next link creates a new handle.
+	//! @pre No render currently running, graph states already linked
+	//!		released
+	void trim();
 	
 	//! @brief Linker Collision UID callback implementation
 	//! @param collisionType Output or input collision flag
@@ -138,6 +144,8 @@ protected:
 	std::string mSbsbinDatas[2];
 	
 	//! @brief Linker cache data generated by linker
+	//! Owned by the linker, kept across link cache hits until the next link
+	//! releases it.
 	const unsigned char* mLinkerCacheData;
 	
 	//! @brief The current substance handle
@@ -171,11 +179,24 @@ protected:
 	//! @brief Pending textures to release into mToReleaseTextures
 	//! Can be set from any thread. Unset from render thread.
 	volatile bool mPendingReleaseTextures;
+
+	//! @brief Current handle SBSBIN comes from the link cache
+	//! Linker cache mapping unknown, no cache transfer at next link
+	bool mHandleFromCache;
 	
 	//! @brief Fill Graph binaries w/ new Engine handle SBSBIN indices
 	//! @param linkGraphs Contains Graph binaries to fill indices
 	void fillIndices(LinkGraphs& linkGraphs) const;
 
+	//! @brief Run the linker on graph states and record the result
+	//! @param linkGraphs Graph states to link, translated UIDs filled
+	//! @param sbsbinData Receive the linked SBSBIN
+	//! @param linkKey Key of this link in the link cache
+	void linkSbsbin(
+		LinkGraphs& linkGraphs,
+		std::string& sbsbinData,
+		const FSHAHash& linkKey);
+
 	//! @brief Create Linker handle and context
 	void createLinker();
 
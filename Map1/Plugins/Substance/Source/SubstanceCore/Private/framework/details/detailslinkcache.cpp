@@ -0,0 +1,390 @@
+//! @file detailslinkcache.cpp
+//! @brief Substance Framework linked SBSBIN cache implementation
+//! @copyright Allegorithmic. All rights reserved.
+//!
+
+#include "SubstanceCorePrivatePCH.h"
+
+#include "framework/details/detailslinkcache.h"
+#include "framework/details/detailslinkgraphs.h"
+#include "framework/details/detailsgraphstate.h"
+#include "framework/details/detailsgraphbinary.h"
+#include "framework/details/detailslinkdata.h"
+
+#include "SubstanceSettings.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogSubstanceLinkCache, Log, All);
+
+//! @brief Link cache file identifier
+static const uint32 gLinkCacheMagic = 0x4b4c4253u;
+
+//! @brief Link cache file version, bump when key or content changes
+static const uint32 gLinkCacheVersion = 1;
+
+
+//! @brief Accessor on the cache shared by all engines
+Substance::Details::LinkCache& Substance::Details::LinkCache::get()
+{
+	static LinkCache instance;
+	return instance;
+}
+
+
+//! @brief Constructor
+Substance::Details::LinkCache::LinkCache() :
+	mUseCounter(0)
+{
+	memset(&mStats,0,sizeof(Stats));
+}
+
+
+//! @brief Compute the key of a link
+//! @param linkGraphs Graph states to link, in link order
+FSHAHash Substance::Details::LinkCache::computeKey(const LinkGraphs& linkGraphs)
+{
+	FSHA1 sha;
+	sha.Update((const uint8*)&gLinkCacheVersion,sizeof(gLinkCacheVersion));
+
+	SBS_VECTOR_FOREACH (
+		const LinkGraphs::GraphStatePtr& graphstateptr,
+		linkGraphs.graphStates)
+	{
+		graphstateptr->getLinkData()->hashKey(sha);
+
+		// Enabled outputs and inputs count (translated UIDs layout)
+		const GraphBinary& binary = graphstateptr->getBinary();
+		const uint32 inputsCount = binary.inputs.size();
+		const uint32 outputsCount = binary.outputs.size();
+		sha.Update((const uint8*)&inputsCount,sizeof(inputsCount));
+		sha.Update((const uint8*)&outputsCount,sizeof(outputsCount));
+
+		SBS_VECTOR_FOREACH (const GraphBinary::Entry& entry,binary.outputs)
+		{
+			sha.Update((const uint8*)&entry.uidInitial,sizeof(entry.uidInitial));
+		}
+	}
+
+	sha.Final();
+
+	FSHAHash key;
+	sha.GetHash(key.Hash);
+	return key;
+}
+
+
+//! @brief Return the entry of a key from memory or disk, NULL if none
+//! @note Counts a hit if found
+Substance::Details::LinkCache::EntryPtr
+Substance::Details::LinkCache::find(const FSHAHash& key)
+{
+	const USubstanceSettings* settings = GetDefault<USubstanceSettings>();
+
+	if (settings->LinkerCacheBudgetMb<=0)
+	{
+		return EntryPtr();
+	}
+
+	const std::string keystr(TCHAR_TO_ANSI(*key.ToString()));
+
+	{
+		Sync::unique_lock slock(mMutex);
+
+		Items::iterator ite = mItems.find(keystr);
+		if (ite!=mItems.end())
+		{
+			ite->second.lastUse = ++mUseCounter;
+			++mStats.hits;
+			mStats.savedSeconds += ite->second.entry->linkSeconds;
+			return ite->second.entry;
+		}
+	}
+
+	if (!settings->bLinkerCacheOnDisk)
+	{
+		return EntryPtr();
+	}
+
+	// Read outside lock, other engines keep linking
+	EntryPtr entry = load(keystr);
+
+	if (entry.get()!=NULL)
+	{
+		Sync::unique_lock slock(mMutex);
+		add(keystr,entry);
+		++mStats.hits;
+		++mStats.diskHits;
+		mStats.savedSeconds += entry->linkSeconds;
+	}
+
+	return entry;
+}
+
+
+//! @brief Record a new linker result, counts a miss
+void Substance::Details::LinkCache::insert(
+	const FSHAHash& key,
+	const EntryPtr& entry)
+{
+	const USubstanceSettings* settings = GetDefault<USubstanceSettings>();
+	const std::string keystr(TCHAR_TO_ANSI(*key.ToString()));
+
+	{
+		Sync::unique_lock slock(mMutex);
+		++mStats.misses;
+		mStats.linkSeconds += entry->linkSeconds;
+
+		if (settings->LinkerCacheBudgetMb<=0)
+		{
+			return;
+		}
+
+		add(keystr,entry);
+	}
+
+	if (settings->bLinkerCacheOnDisk)
+	{
+		save(keystr,*entry);
+	}
+}
+
+
+//! @brief Add an entry in memory and evict to fit the budget
+//! @pre mMutex locked
+void Substance::Details::LinkCache::add(
+	const std::string& key,
+	const EntryPtr& entry)
+{
+	const size_t budget =
+		(size_t)GetDefault<USubstanceSettings>()->LinkerCacheBudgetMb*1024*1024;
+
+	Item& item = mItems[key];
+	if (item.entry.get()!=NULL)
+	{
+		mStats.memoryBytes -= item.entry->sbsbin.size();
+	}
+
+	item.entry = entry;
+	item.lastUse = ++mUseCounter;
+	mStats.memoryBytes += entry->sbsbin.size();
+
+	// Least recently used first, the new entry is always kept
+	while (mStats.memoryBytes>budget && mItems.size()>1)
+	{
+		Items::iterator oldest = mItems.end();
+		for (Items::iterator ite = mItems.begin();ite!=mItems.end();++ite)
+		{
+			if (ite->first!=key &&
+				(oldest==mItems.end() || ite->second.lastUse<oldest->second.lastUse))
+			{
+				oldest = ite;
+			}
+		}
+
+		mStats.memoryBytes -= oldest->second.entry->sbsbin.size();
+		mItems.erase(oldest);
+	}
+
+	mStats.entriesCount = mItems.size();
+}
+
+
+//! @brief Fill translated UIDs of graph binaries from an entry
+//! @return Return false if the entry does not match the graph states
+bool Substance::Details::LinkCache::restoreUids(
+	const Entry& entry,
+	LinkGraphs& linkGraphs)
+{
+	size_t count = 0;
+	SBS_VECTOR_FOREACH (
+		const LinkGraphs::GraphStatePtr& graphstateptr,
+		linkGraphs.graphStates)
+	{
+		const GraphBinary& binary = graphstateptr->getBinary();
+		count += binary.inputs.size()+binary.outputs.size();
+	}
+
+	if (count!=entry.translatedUids.size())
+	{
+		return false;
+	}
+
+	std::vector<uint32>::const_iterator uidite = entry.translatedUids.begin();
+
+	SBS_VECTOR_FOREACH (
+		const LinkGraphs::GraphStatePtr& graphstateptr,
+		linkGraphs.graphStates)
+	{
+		GraphBinary& binary = graphstateptr->getBinary();
+		binary.resetTranslatedUids();
+
+		SBS_VECTOR_FOREACH (GraphBinary::Entry& binentry,binary.inputs)
+		{
+			binentry.uidTranslated = *(uidite++);
+		}
+
+		SBS_VECTOR_FOREACH (GraphBinary::Entry& binentry,binary.outputs)
+		{
+			binentry.uidTranslated = *(uidite++);
+		}
+	}
+
+	return true;
+}
+
+
+//! @brief Grab translated UIDs of graph binaries after link
+void Substance::Details::LinkCache::grabUids(
+	Entry& entry,
+	const LinkGraphs& linkGraphs)
+{
+	entry.translatedUids.clear();
+
+	SBS_VECTOR_FOREACH (
+		const LinkGraphs::GraphStatePtr& graphstateptr,
+		linkGraphs.graphStates)
+	{
+		const GraphBinary& binary = graphstateptr->getBinary();
+
+		SBS_VECTOR_FOREACH (const GraphBinary::Entry& binentry,binary.inputs)
+		{
+			entry.translatedUids.push_back(binentry.uidTranslated);
+		}
+
+		SBS_VECTOR_FOREACH (const GraphBinary::Entry& binentry,binary.outputs)
+		{
+			entry.translatedUids.push_back(binentry.uidTranslated);
+		}
+	}
+}
+
+
+//! @brief Accessor on counters
+Substance::Details::LinkCache::Stats
+Substance::Details::LinkCache::getStats() const
+{
+	Sync::unique_lock slock(mMutex);
+	return mStats;
+}
+
+
+//! @brief Forget all entries in memory
+void Substance::Details::LinkCache::clear()
+{
+	Sync::unique_lock slock(mMutex);
+	mItems.clear();
+	mStats.memoryBytes = 0;
+	mStats.entriesCount = 0;
+}
+
+
+//! @brief Path of the file of a key
+FString Substance::Details::LinkCache::getPath(const std::string& key)
+{
+	return FString::Printf(TEXT("%s/Substance/Linker/%s.link"),
+		*FPaths::GameSavedDir(),
+		ANSI_TO_TCHAR(key.c_str()));
+}
+
+
+//! @brief Load an entry from disk, NULL if none or not valid
+Substance::Details::LinkCache::EntryPtr
+Substance::Details::LinkCache::load(const std::string& key)
+{
+	TArray<uint8> data;
+	if (!FFileHelper::LoadFileToArray(data,*getPath(key),FILEREAD_Silent))
+	{
+		return EntryPtr();
+	}
+
+	FMemoryReader reader(data);
+
+	uint32 magic = 0, version = 0, uidsCount = 0, sbsbinSize = 0;
+	double linkSeconds = 0.0;
+	reader << magic << version << uidsCount << sbsbinSize << linkSeconds;
+
+	const int64 expected = reader.Tell()+(int64)uidsCount*sizeof(uint32)+sbsbinSize;
+
+	if (reader.IsError() ||
+		magic!=gLinkCacheMagic ||
+		version!=gLinkCacheVersion ||
+		expected!=data.Num())
+	{
+		UE_LOG(LogSubstanceLinkCache, Warning, TEXT("Ignoring invalid linker cache file %s"), *getPath(key));
+		return EntryPtr();
+	}
+
+	std::shared_ptr<Entry> entry(new Entry);
+	entry->linkSeconds = linkSeconds;
+	entry->translatedUids.resize(uidsCount);
+	entry->sbsbin.resize(sbsbinSize);
+
+	if (uidsCount!=0)
+	{
+		reader.Serialize(&entry->translatedUids[0],uidsCount*sizeof(uint32));
+	}
+
+	if (sbsbinSize!=0)
+	{
+		reader.Serialize(&entry->sbsbin[0],sbsbinSize);
+	}
+
+	return entry;
+}
+
+
+//! @brief Save an entry on disk
+void Substance::Details::LinkCache::save(
+	const std::string& key,
+	const Entry& entry)
+{
+	TArray<uint8> data;
+	FMemoryWriter writer(data);
+
+	uint32 magic = gLinkCacheMagic;
+	uint32 version = gLinkCacheVersion;
+	uint32 uidsCount = entry.translatedUids.size();
+	uint32 sbsbinSize = entry.sbsbin.size();
+	double linkSeconds = entry.linkSeconds;
+	writer << magic << version << uidsCount << sbsbinSize << linkSeconds;
+
+	if (uidsCount!=0)
+	{
+		writer.Serialize((void*)&entry.translatedUids[0],uidsCount*sizeof(uint32));
+	}
+
+	if (sbsbinSize!=0)
+	{
+		writer.Serialize((void*)entry.sbsbin.data(),sbsbinSize);
+	}
+
+	// Other engines may link the same graphs, write aside then move
+	const FString path = getPath(key);
+	const FString tmppath = path+TEXT(".")+FGuid::NewGuid().ToString();
+
+	if (!FFileHelper::SaveArrayToFile(data,*tmppath) ||
+		!IFileManager::Get().Move(*path,*tmppath,true,true,false,true))
+	{
+		IFileManager::Get().Delete(*tmppath,false,false,true);
+		UE_LOG(LogSubstanceLinkCache, Warning, TEXT("Failed to write linker cache file %s"), *path);
+	}
+}
+
+
+//! @brief Log the linker cache counters
+static void logLinkCacheStats()
+{
+	const Substance::Details::LinkCache::Stats stats =
+		Substance::Details::LinkCache::get().getStats();
+	const uint64 total = stats.hits+stats.misses;
+
+	UE_LOG(LogSubstanceLinkCache, Log, TEXT("Substance linker cache: %llu hits (%llu from disk), %llu misses, hit rate %.1f%%"),
+		stats.hits, stats.diskHits, stats.misses,
+		total!=0 ? 100.0*stats.hits/total : 0.0);
+	UE_LOG(LogSubstanceLinkCache, Log, TEXT("Substance linker cache: %.3f s linking, %.3f s saved, %d entries, %llu bytes"),
+		stats.linkSeconds, stats.savedSeconds, (int32)stats.entriesCount, (uint64)stats.memoryBytes);
+}
+
+static FAutoConsoleCommand SubstanceLinkCacheStatsCommand(
+	TEXT("Substance.Linker.Stats"),
+	TEXT("Logs the Substance linker cache hit rate and the link time saved."),
+	FConsoleCommandDelegate::CreateStatic(&logLinkCacheStats));
@@ -0,0 +1,134 @@
+//! @file detailslinkcache.h
+//! @brief Substance Framework linked SBSBIN cache definition
+//! @copyright Allegorithmic. All rights reserved.
+//!
+
+#ifndef _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSLINKCACHE_H
+#define _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSLINKCACHE_H
+
+#include "framework/details/detailssync.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Substance
+{
+namespace Details
+{
+
+struct LinkGraphs;
+
+//! @brief Memoized linker results, shared by all engines
+//! An entry is keyed by the link data and outputs of the linked graph
+//! states, in link order. It holds the SBSBIN and the translated UIDs of
+//! the graph binaries so a hit skips the linker entirely. Entries are kept
+//! in memory up to the settings budget and optionally saved on disk.
+class LinkCache
+{
+public:
+	//! @brief Link result
+	struct Entry
+	{
+		//! @brief Linked SBSBIN data
+		std::string sbsbin;
+
+		//! @brief Translated UIDs, inputs then outputs of each graph state
+		std::vector<uint32> translatedUids;
+
+		//! @brief Time spent by the linker to produce this entry
+		double linkSeconds;
+	};  // struct Entry
+
+	//! @brief Pointer on immutable entry
+	typedef std::shared_ptr<const Entry> EntryPtr;
+
+	//! @brief Hit/miss counters
+	struct Stats
+	{
+		uint64 hits;              //!< Links skipped
+		uint64 diskHits;          //!< Links skipped w/ entry loaded from disk
+		uint64 misses;            //!< Links run
+		double linkSeconds;       //!< Time spent linking
+		double savedSeconds;      //!< Linker time of the skipped links
+		size_t memoryBytes;       //!< Size of the entries in memory
+		size_t entriesCount;      //!< Entries in memory
+	};  // struct Stats
+
+	//! @brief Accessor on the cache shared by all engines
+	static LinkCache& get();
+
+	//! @brief Compute the key of a link
+	//! @param linkGraphs Graph states to link, in link order
+	static FSHAHash computeKey(const LinkGraphs& linkGraphs);
+
+	//! @brief Return the entry of a key from memory or disk, NULL if none
+	//! @note Counts a hit if found
+	EntryPtr find(const FSHAHash& key);
+
+	//! @brief Record a new linker result, counts a miss
+	void insert(const FSHAHash& key,const EntryPtr& entry);
+
+	//! @brief Fill translated UIDs of graph binaries from an entry
+	//! @return Return false if the entry does not match the graph states
+	static bool restoreUids(const Entry& entry,LinkGraphs& linkGraphs);
+
+	//! @brief Grab translated UIDs of graph binaries after link
+	static void grabUids(Entry& entry,const LinkGraphs& linkGraphs);
+
+	//! @brief Accessor on counters
+	Stats getStats() const;
+
+	//! @brief Forget all entries in memory
+	void clear();
+
+protected:
+	//! @brief Entry in memory
+	struct Item
+	{
+		EntryPtr entry;           //!< Link result
+		uint64 lastUse;           //!< Value of mUseCounter when last used
+	};  // struct Item
+
+	//! @brief Entries per hexadecimal key
+	typedef std::map<std::string,Item> Items;
+
+	//! @brief Entries in memory
+	Items mItems;
+
+	//! @brief Use counter, for least recently used eviction
+	uint64 mUseCounter;
+
+	//! @brief Counters
+	Stats mStats;
+
+	//! @brief Mutex on members access
+	mutable Sync::mutex mMutex;
+
+	//! @brief Constructor
+	LinkCache();
+
+	//! @brief Add an entry in memory and evict to fit the budget
+	//! @pre mMutex locked
+	void add(const std::string& key,const EntryPtr& entry);
+
+	//! @brief Path of the file of a key
+	static FString getPath(const std::string& key);
+
+	//! @brief Load an entry from disk, NULL if none or not valid
+	static EntryPtr load(const std::string& key);
+
+	//! @brief Save an entry on disk
+	static void save(const std::string& key,const Entry& entry);
+
+private:
+	LinkCache(const LinkCache&);
+	const LinkCache& operator=(const LinkCache&);
+};  // class LinkCache
+
+
+} // namespace Details
+} // namespace Substance
+
+#endif // ifndef _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSLINKCACHE_H
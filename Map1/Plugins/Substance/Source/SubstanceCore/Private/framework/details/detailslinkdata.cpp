@@ -28,6 +28,7 @@ Substance::Details::LinkDataAssembly::LinkDataAssembly(
 		uint32 size) :
 	mAssembly((const char*)ptr,size)
 {
+	FSHA1::HashBuffer(ptr,size,mAssemblyHash.Hash);
 }
 
 
@@ -73,6 +74,23 @@ bool Substance::Details::LinkDataAssembly::push(LinkContext& cxt) const
 }
 	
 	
+//! @brief Feed the assembly hash and output formats
+void Substance::Details::LinkDataAssembly::hashKey(FSHA1& sha) const
+{
+	const uint8 tag = 'A';
+	sha.Update(&tag,sizeof(tag));
+	sha.Update(mAssemblyHash.Hash,sizeof(mAssemblyHash.Hash));
+
+	const uint32 count = mOutputFormats.size();
+	sha.Update((const uint8*)&count,sizeof(count));
+
+	if (count!=0)
+	{
+		sha.Update((const uint8*)&mOutputFormats[0],count*sizeof(OutputFormat));
+	}
+}
+	
+	
 //! @brief Force output format/mipmap
 //! @param uid Output uid
 //! @param format New output format
@@ -166,3 +184,60 @@ bool Substance::Details::LinkDataStacking::push(LinkContext& cxt) const
 	
 	return true;
 }
+
+
+//! @brief Feed UID pairs w/ their count
+static void hashUidPairs(
+	FSHA1& sha,
+	const std::vector<std::pair<uint32,uint32> >& pairs)
+{
+	const uint32 count = pairs.size();
+	sha.Update((const uint8*)&count,sizeof(count));
+	
+	SBS_VECTOR_FOREACH (auto p, pairs)
+	{
+		sha.Update((const uint8*)&p.first,sizeof(p.first));
+		sha.Update((const uint8*)&p.second,sizeof(p.second));
+	}
+}
+
+
+//! @brief Feed the pre and post link data and the connections
+void Substance::Details::LinkDataStacking::hashKey(FSHA1& sha) const
+{
+	const uint8 tag = 'S';
+	sha.Update(&tag,sizeof(tag));
+
+	const uint8 none = 0;
+
+	if (mPreLinkData.get()!=NULL)
+	{
+		mPreLinkData->hashKey(sha);
+	}
+	else
+	{
+		sha.Update(&none,sizeof(none));
+	}
+
+	if (mPostLinkData.get()!=NULL)
+	{
+		mPostLinkData->hashKey(sha);
+	}
+	else
+	{
+		sha.Update(&none,sizeof(none));
+	}
+
+	hashUidPairs(sha,mOptions.mConnections);
+	hashUidPairs(sha,mFuseInputs);
+	hashUidPairs(sha,mTrPostInputs);
+	hashUidPairs(sha,mTrPreOutputs);
+
+	const uint32 count = mDisabledOutputs.size();
+	sha.Update((const uint8*)&count,sizeof(count));
+
+	if (count!=0)
+	{
+		sha.Update((const uint8*)&mDisabledOutputs[0],count*sizeof(uint32));
+	}
+}
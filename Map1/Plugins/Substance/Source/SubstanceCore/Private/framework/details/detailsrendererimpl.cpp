@@ -12,6 +12,7 @@
 #include "framework/details/detailsrendererimpl.h"
 #include "framework/details/detailsrenderjob.h"
 #include "framework/details/detailsoutputsfilter.h"
+#include "framework/details/detailsrenderhandlestate.h"
 #include "framework/renderer.h"
 
 #include <algorithm>
@@ -26,12 +27,14 @@ Substance::Details::RendererImpl::RendererImpl(
 	mRenderState(RenderState_Idle),
 	mHold(false),
 	mCancelOccur(false),
+	mPreemptOccur(false),
 	mPendingHardRsc(false),
 	mExitRender(false),
 	mUserWaiting(false),
 	mEngineInitialized(false),
 	mRenderCallbacks(NULL),
-	mRenderJobUid(0)
+	mRenderJobUid(0),
+	mShardCount(renderOptions.mShardCount)
 {
 }
 
@@ -39,6 +42,17 @@ Substance::Details::RendererImpl::RendererImpl(
 //! @brief Destructor
 Substance::Details::RendererImpl::~RendererImpl()
 {
+	// Handles can no more cancel jobs of this renderer, including the
+	// jobs already deleted by cleanup()
+	SBS_VECTOR_FOREACH (const std::weak_ptr<RenderHandleState>& weakstate,mHandleStates)
+	{
+		std::shared_ptr<RenderHandleState> handlestate = weakstate.lock();
+		if (handlestate.get()!=NULL)
+		{
+			handlestate->forgetRenderer(this);
+		}
+	}
+
 	// Cancel all
 	cancel();
 
@@ -125,8 +139,11 @@ void Substance::Details::RendererImpl::waitRender()
 
 //! @brief Push graph instance current changes to render
 //! @param graphInstance The instance to push dirty outputs
+//! @param priority Priority class of the dirty outputs
 //! @return Return true if at least one dirty output
-bool Substance::Details::RendererImpl::push(FGraphInstance* graphInstance)
+bool Substance::Details::RendererImpl::push(
+	FGraphInstance* graphInstance,
+	Renderer::Priority priority)
 {
 	if (mRenderJobs.empty() || 
 		mRenderJobs.back()->getState()!=RenderJob::State_Setup)
@@ -135,15 +152,25 @@ bool Substance::Details::RendererImpl::push(FGraphInstance* graphInstance)
 		mRenderJobs.push_back(new RenderJob(++mRenderJobUid,mRenderCallbacks));
 	}
 
-	return mRenderJobs.back()->push(mStates[graphInstance],graphInstance);
+	RenderJob *job = mRenderJobs.back();
+	if (job->push(mStates[graphInstance],graphInstance,priority))
+	{
+		job->raisePriority(priority);
+		return true;
+	}
+	
+	return false;
 }
 
 
 //! @brief Launch computation
 //! @param options RunOptions flags combination
+//! @param handleState State of the RenderHandle to attach the new job
+//!		to, or NULL
 //! @return Return UID of render job or 0 if not pushed computation to run
 uint32 Substance::Details::RendererImpl::run(
-	unsigned int options)
+	unsigned int options,
+	const std::shared_ptr<RenderHandleState>& handleState)
 {
 	// Cleanup deprecated jobs
 	cleanup();
@@ -194,6 +221,39 @@ uint32 Substance::Details::RendererImpl::run(
 	
 	// Fill list of graphs to link
 	newjob->snapshotStates(mStates);
+
+	if (handleState.get()!=NULL)
+	{
+		newjob->setHandleState(handleState);
+		handleState->addRun(this,newjob->getUid());
+
+		// Drop the states of released handles
+		size_t keptcount = 0;
+		for (size_t i=0;i<mHandleStates.size();++i)
+		{
+			if (!mHandleStates[i].expired())
+			{
+				mHandleStates[keptcount++] = mHandleStates[i];
+			}
+		}
+		mHandleStates.resize(keptcount);
+		mHandleStates.push_back(handleState);
+	}
+
+	// Handles of the jobs canceled below stay open until the duplicates
+	// of their remaining outputs are attached
+	std::vector<std::shared_ptr<RenderHandleState> > openstates;
+	if ((options&(Renderer::Run_Replace|Renderer::Run_First))!=0)
+	{
+		for (RenderJob *rjob=curjob;rjob!=NULL;rjob=rjob->getNextJob())
+		{
+			if (rjob->getHandleState().get()!=NULL)
+			{
+				rjob->getHandleState()->attachJob();
+				openstates.push_back(rjob->getHandleState());
+			}
+		}
+	}
 		
 	if (curjob!=NULL && 
 		(options&(Renderer::Run_Replace|Renderer::Run_First))!=0 &&
@@ -275,6 +335,13 @@ uint32 Substance::Details::RendererImpl::run(
 			}	   
 		}
 		
+		// Duplicates hold the handles now
+		SBS_VECTOR_FOREACH (const std::shared_ptr<RenderHandleState>& openstate,openstates)
+		{
+			openstate->detachJob();
+		}
+		openstates.clear();
+		
 		// Push new job at the end except if First flag is set
 		if (!newfirst)
 		{
@@ -293,6 +360,12 @@ uint32 Substance::Details::RendererImpl::run(
 		}
 	}
 		
+	// Nothing canceled, nothing duplicated
+	SBS_VECTOR_FOREACH (const std::shared_ptr<RenderHandleState>& openstate,openstates)
+	{
+		openstate->detachJob();
+	}
+	
 	// Activate the first job (render thread can view and consume them)
 	// Active the first in LAST! Otherwise thread unsafe behavior
 	begjob->activate(lastjob);
@@ -309,6 +382,27 @@ uint32 Substance::Details::RendererImpl::run(
 			// Set as current job if no current computations
 			mCurrentJob = begjob;
 		}
+		else if (!mCancelOccur)
+		{
+			// Preempt less urgent outputs being computed: the engine stops
+			// after the output being computed, the render loop pulls the
+			// remaining outputs again w/ the new jobs in priority order
+			const double now = FPlatformTime::Seconds();
+			const int32 newpriority = newjob->getAgedPriority(now);
+			for (RenderJob *rjob=mCurrentJob;
+				rjob!=NULL && rjob!=begjob;
+				rjob=rjob->getNextJob())
+			{
+				if (rjob->getState()==RenderJob::State_Computing &&
+					!rjob->isCanceled() &&
+					rjob->getAgedPriority(now)>newpriority)
+				{
+					mPreemptOccur = true;
+					mEngine.stop();
+					break;
+				}
+			}
+		}
 		
 		mHold = mHold && !synchrun;
 		if (!mHold)
@@ -348,20 +442,33 @@ bool Substance::Details::RendererImpl::cancel(uint32 runUid)
 	{
 		if (runUid!=0)
 		{	
-			// Search for job to cancel
+			// Search for jobs to cancel, duplicates of a replaced job
+			// keep its UID
 			for (RenderJob *rjob=mCurrentJob;rjob!=NULL;rjob=rjob->getNextJob())
 			{
-				if (runUid==rjob->getUid())
+				if (runUid==rjob->getUid() && rjob->cancel())
 				{
 					// Cancel this job
-					hasCancel = rjob->cancel();
-					break;
+					hasCancel = true;
+
+					if (rjob->getHandleState().get()!=NULL)
+					{
+						rjob->getHandleState()->setCanceled();
+					}
 				}
 			}
 		}
 		else
 		{
 			// Cancel all
+			for (RenderJob *rjob=mCurrentJob;rjob!=NULL;rjob=rjob->getNextJob())
+			{
+				if (!rjob->isCanceled() && rjob->getHandleState().get()!=NULL)
+				{
+					rjob->getHandleState()->setCanceled();
+				}
+			}
+
 			hasCancel = mCurrentJob->cancel(true);
 		}
 		
@@ -386,6 +493,34 @@ void Substance::Details::RendererImpl::clearCache()
 }
 
 
+//! @brief Release engine memory between batches of render jobs
+//! Graph states, remaining render results and linked SBSBIN are
+//! released. Engine context, linker and render thread are kept.
+//! @return Return false if a job is pushed or pending, nothing released
+bool Substance::Details::RendererImpl::trim()
+{
+	// Consumed jobs reference the graph states
+	cleanup();
+
+	Sync::unique_lock slock(mMainMutex);
+
+	if (!mRenderJobs.empty() || mRenderState==RenderState_OnGoing)
+	{
+		return false;
+	}
+
+	// Clear all render results created w/ this engine instance
+	mStates.releaseRenderResults(mEngine.getInstanceUid());
+
+	// Next pushes create new states, linked w/o the previous ones
+	mStates.clear();
+
+	mEngine.trim();
+
+	return true;
+}
+
+
 //! @brief Return if a computation is pending
 //! @param runUid UID of the render job to retreive state (returned by run())
 bool Substance::Details::RendererImpl::isPending(uint32 runUid) const
@@ -603,8 +738,9 @@ void Substance::Details::RendererImpl::renderLoop(bool waitAndLoop)
 		mEngine.releaseTextures();
 		
 		// memory limitation for the handle, the RenderOptions object 
-		// is created using the values set in the settings
-		Substance::RenderOptions renderOptions; 
+		// is created using the values set in the settings, split between
+		// the renderers of a pool
+		Substance::RenderOptions renderOptions(mShardCount);
 		
 		// Update render options
 		mPendingHardRsc = mEngine.setOptions(renderOptions);
@@ -630,10 +766,11 @@ Substance::Details::RendererImpl::processJob(RenderJob *begjob)
 	// Check if not strict resume (jobs are already pulled, w\ cancel or addon)
 	// Check if link required
 	RenderJob* lastjob = begjob;
-	bool pullidentity = !mCancelOccur;
+	bool pullidentity = !mCancelOccur && !mPreemptOccur;
 	
-	// Cancel will be accounted for
+	// Cancel and preemption will be accounted for
 	mCancelOccur = false;
+	mPreemptOccur = false;
 	
 	{
 		bool linkRequired = false;
@@ -670,18 +807,19 @@ Substance::Details::RendererImpl::processJob(RenderJob *begjob)
 		// If pull is necessary (not strict resume)
 		if (!pullidentity)
 		{
-			// Push all I/O to engine
-			RenderJob* curjob = begjob;
-			do
+			// Push all I/O to engine, most urgent jobs first
+			std::vector<RenderJob*> order;
+			sortByPriority(begjob,lastjob,order);
+			
+			SBS_VECTOR_FOREACH (RenderJob *curjob,order)
 			{
 				// Push I/O
 				curjob->pull(computation);
 			}
-			while (curjob!=lastjob && (curjob=curjob->getNextJob())!=NULL);
 		}
 
-		// Run if no cancel occurs during push/link
-		if (!mCancelOccur) 
+		// Run if no cancel or preemption occurs during push/link
+		if (!mCancelOccur && !mPreemptOccur) 
 		{
 			computation.run();
 		}
@@ -700,3 +838,59 @@ Substance::Details::RendererImpl::processJob(RenderJob *begjob)
 
 	return curjob;
 }
+
+
+//! @brief Order the jobs of a render list for pulling
+//! @param begjob The first job of the list
+//! @param lastjob The last job of the list
+//! @param[out] order Jobs by aged priority, then activation order
+//! @note Jobs sharing a graph state keep their activation order
+void Substance::Details::RendererImpl::sortByPriority(
+	RenderJob *begjob,
+	RenderJob *lastjob,
+	std::vector<RenderJob*> &order)
+{
+	std::vector<RenderJob*> remaining;
+	RenderJob* curjob = begjob;
+	do
+	{
+		remaining.push_back(curjob);
+	}
+	while (curjob!=lastjob && (curjob=curjob->getNextJob())!=NULL);
+	
+	const double now = FPlatformTime::Seconds();
+	order.reserve(remaining.size());
+	
+	while (!remaining.empty())
+	{
+		// The first remaining job is always available: ties and
+		// dependencies resolve in activation order, the oldest first
+		size_t best = 0;
+		int32 bestpriority = remaining[0]->getAgedPriority(now);
+		
+		for (size_t i=1;i<remaining.size() && bestpriority>0;++i)
+		{
+			const int32 priority = remaining[i]->getAgedPriority(now);
+			if (priority>=bestpriority)
+			{
+				continue;
+			}
+			
+			// Must follow earlier jobs pushing the same graph states
+			bool available = true;
+			for (size_t j=0;j<i && available;++j)
+			{
+				available = !remaining[i]->sharesGraphStates(*remaining[j]);
+			}
+			
+			if (available)
+			{
+				best = i;
+				bestpriority = priority;
+			}
+		}
+		
+		order.push_back(remaining[best]);
+		remaining.erase(remaining.begin()+best);
+	}
+}
@@ -15,13 +15,19 @@
 #include "SubstanceFGraph.h"
 #include "Engine.h"
 
+#include "framework/renderer.h"
+
 #include <deque>
+#include <memory>
+#include <vector>
 
 namespace Substance
 {
 namespace Details
 {
 
+class RenderHandleState;
+
 //! @brief Concrete renderer implementation
 class RendererImpl
 {
@@ -35,22 +41,35 @@ public:
 	
 	//! @brief Push graph instance current changes to render
 	//! @param graphInstance The instance to push dirty outputs
+	//! @param priority Priority class of the dirty outputs
 	//! @return Return true if at least one dirty output
-	bool push(FGraphInstance* graphInstance);
+	bool push(FGraphInstance* graphInstance,Renderer::Priority priority);
 	
 	//! @brief Launch computation
 	//! @param options Renderer::RunOption flags combination
+	//! @param handleState State of the RenderHandle to attach the new job
+	//!		to, or NULL
 	//! @return Return UID of render job or 0 if not pushed computation to run
-	uint32 run(unsigned int options);
+	uint32 run(
+		unsigned int options,
+		const std::shared_ptr<RenderHandleState>& handleState =
+			std::shared_ptr<RenderHandleState>());
 	
 	//! @brief Cancel a computation or all computations
 	//! @param runUid UID of the render job to cancel (returned by run()), set
 	//!		to 0 to cancel ALL jobs.
 	//! @return Return true if the job is retrieved (pending)
+	//! @note The RenderHandle of a retrieved job is flagged as canceled
 	bool cancel(uint32 runUid = 0);
 
 	//! @brief Clear the substance cache
 	void clearCache();
+
+	//! @brief Release engine memory between batches of render jobs
+	//! Graph states, remaining render results and linked SBSBIN are
+	//! released. Engine context, linker and render thread are kept.
+	//! @return Return false if a job is pushed or pending, nothing released
+	bool trim();
 	
 	//! @brief Return if a computation is pending
 	//! @param runUid UID of the render job to retrieve state (returned by run())
@@ -98,6 +117,12 @@ protected:
 	//! @brief Render jobs list
 	//! @note Container modification are always done in user thread
 	RenderJobs mRenderJobs;
+
+	//! @brief Handle states recording runs of this renderer
+	//! Kept after their jobs are deleted: the handles outlive the jobs and
+	//! must forget this renderer once deleted.
+	//! @note Modified in user thread only
+	std::vector<std::weak_ptr<RenderHandleState> > mHandleStates;
 	
 	//! @brief First render job to proceed by render thread
 	//! R/W access thread safety ensure by mMainMutex.
@@ -116,6 +141,12 @@ protected:
 	//! Set from user thread (cancel action), unset when taken into account
 	//!	by render loop (render thread).
 	volatile bool mCancelOccur;
+
+	//! @brief More urgent job activated while less urgent outputs compute
+	//! Set from user thread (run action), unset when taken into account
+	//!	by render loop (render thread): remaining outputs are pulled again
+	//!	in priority order.
+	volatile bool mPreemptOccur;
 	
 	//! @brief Pending engine hard resources change
 	//! Can be set from any thread. Unset from render or user thread.
@@ -151,6 +182,9 @@ protected:
 
 	//! @brief Current Render job UID
 	uint32 mRenderJobUid;
+
+	//! @brief Number of renderers sharing the settings budget and cores
+	const size_t mShardCount;
 		
 	//! @brief Call process callback or create up render thread
 	//! @pre mMainMutex Must be NOT locked, render thread must be currently
@@ -203,6 +237,16 @@ protected:
 	//!		NOT completed.
 	RenderJob* processJob(RenderJob *begjob);
 
+	//! @brief Order the jobs of a render list for pulling
+	//! @param begjob The first job of the list
+	//! @param lastjob The last job of the list
+	//! @param[out] order Jobs by aged priority, then activation order
+	//! @note Jobs sharing a graph state keep their activation order
+	static void sortByPriority(
+		RenderJob *begjob,
+		RenderJob *lastjob,
+		std::vector<RenderJob*> &order);
+
 };
 
 
@@ -0,0 +1,245 @@
+//! @file detailsrenderhandlestate.cpp
+//! @brief Substance Framework asynchronous computation state implementation
+//! @copyright Allegorithmic. All rights reserved.
+//!
+
+#include "SubstanceCorePrivatePCH.h"
+
+#include "framework/details/detailsrenderhandlestate.h"
+#include "framework/details/detailsrendererimpl.h"
+
+
+//! @brief Task calling a continuation on its thread
+class FRenderContinuationTask
+{
+public:
+	FRenderContinuationTask(
+			const Substance::RenderHandle::Continuation& continuation,
+			bool computed,
+			ENamedThreads::Type thread) :
+		mContinuation(continuation),
+		mComputed(computed),
+		mThread(thread)
+	{
+	}
+
+	static const TCHAR* GetTaskName() { return TEXT("FRenderContinuationTask"); }
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FRenderContinuationTask, STATGROUP_TaskGraphTasks);
+	}
+
+	ENamedThreads::Type GetDesiredThread() { return mThread; }
+
+	static ESubsequentsMode::Type GetSubsequentsMode() { return ESubsequentsMode::FireAndForget; }
+
+	void DoTask(ENamedThreads::Type currentThread,const FGraphEventRef& completionEvent)
+	{
+		mContinuation(mComputed);
+	}
+
+protected:
+	Substance::RenderHandle::Continuation mContinuation;
+	bool mComputed;
+	ENamedThreads::Type mThread;
+};
+
+
+//! @brief Constructor, open
+Substance::Details::RenderHandleState::RenderHandleState() :
+	mReferences(1),
+	mOutputsCount(0),
+	mComputedCount(0),
+	mComplete(false),
+	mCanceled(false)
+{
+}
+
+
+//! @brief A render job more
+void Substance::Details::RenderHandleState::attachJob()
+{
+	Sync::unique_lock slock(mMutex);
+	++mReferences;
+}
+
+
+//! @brief A render job over
+void Substance::Details::RenderHandleState::detachJob()
+{
+	release();
+}
+
+
+//! @brief Release the creator reference
+void Substance::Details::RenderHandleState::close()
+{
+	release();
+}
+
+
+//! @brief Outputs to compute by the jobs of this computation
+void Substance::Details::RenderHandleState::addOutputs(size_t count)
+{
+	Sync::unique_lock slock(mMutex);
+	mOutputsCount += count;
+}
+
+
+//! @brief An output of the computation is computed
+//! @note Called from render thread
+void Substance::Details::RenderHandleState::outputComputed()
+{
+	Sync::unique_lock slock(mMutex);
+	++mComputedCount;
+}
+
+
+//! @brief Record a render job UID to cancel from the handle
+void Substance::Details::RenderHandleState::addRun(
+	RendererImpl* renderer,
+	uint32 runUid)
+{
+	Sync::unique_lock rlock(mRunsMutex);
+	mRuns.push_back(Run(renderer,runUid));
+}
+
+
+//! @brief Forget the jobs of a renderer being deleted
+//! @pre The renderer main mutex is not locked
+void Substance::Details::RenderHandleState::forgetRenderer(
+	RendererImpl* renderer)
+{
+	Sync::unique_lock rlock(mRunsMutex);
+
+	for (size_t i=0;i<mRuns.size();)
+	{
+		if (mRuns[i].first==renderer)
+		{
+			mRuns.erase(mRuns.begin()+i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+
+//! @brief Flag as canceled by the user
+void Substance::Details::RenderHandleState::setCanceled()
+{
+	Sync::unique_lock slock(mMutex);
+	mCanceled = mCanceled || !mComplete;
+}
+
+
+//! @brief Cancel the jobs of every renderer
+//! @return Return true if a render job was pending
+bool Substance::Details::RenderHandleState::cancel()
+{
+	Sync::unique_lock rlock(mRunsMutex);
+
+	// Renderers flag this state canceled if a job is retrieved
+	bool canceled = false;
+	SBS_VECTOR_FOREACH (const Run& run,mRuns)
+	{
+		canceled = run.first->cancel(run.second) || canceled;
+	}
+
+	return canceled;
+}
+
+
+//! @brief Return if the computation is over
+bool Substance::Details::RenderHandleState::isComplete() const
+{
+	Sync::unique_lock slock(mMutex);
+	return mComplete;
+}
+
+
+//! @brief Return if the computation was canceled
+bool Substance::Details::RenderHandleState::isCanceled() const
+{
+	Sync::unique_lock slock(mMutex);
+	return mCanceled;
+}
+
+
+//! @brief Return the computed outputs ratio, 1 once complete
+float Substance::Details::RenderHandleState::getProgress() const
+{
+	Sync::unique_lock slock(mMutex);
+
+	if (mComplete || mOutputsCount==0)
+	{
+		return mComplete ? 1.0f : 0.0f;
+	}
+
+	// Outputs of duplicated jobs may be computed twice
+	return FMath::Min((float)mComputedCount/(float)mOutputsCount,1.0f);
+}
+
+
+//! @brief Call a continuation once the computation is over
+void Substance::Details::RenderHandleState::then(
+	const RenderHandle::Continuation& continuation,
+	ENamedThreads::Type thread)
+{
+	bool computed = false;
+
+	{
+		Sync::unique_lock slock(mMutex);
+
+		if (!mComplete)
+		{
+			mContinuations.push_back(Continuation(continuation,thread));
+			return;
+		}
+
+		computed = !mCanceled;
+	}
+
+	dispatch(Continuation(continuation,thread),computed);
+}
+
+
+//! @brief Release a reference, complete if none left
+void Substance::Details::RenderHandleState::release()
+{
+	std::vector<Continuation> continuations;
+	bool computed = false;
+
+	{
+		Sync::unique_lock slock(mMutex);
+
+		check(mReferences>0);
+		if (--mReferences!=0 || mComplete)
+		{
+			return;
+		}
+
+		mComplete = true;
+		computed = !mCanceled;
+		continuations.swap(mContinuations);
+	}
+
+	SBS_VECTOR_FOREACH (const Continuation& continuation,continuations)
+	{
+		dispatch(continuation,computed);
+	}
+}
+
+
+//! @brief Dispatch a continuation to its thread
+void Substance::Details::RenderHandleState::dispatch(
+	const Continuation& continuation,
+	bool computed)
+{
+	TGraphTask<FRenderContinuationTask>::CreateTask().ConstructAndDispatchWhenReady(
+		continuation.first,
+		computed,
+		continuation.second);
+}
@@ -0,0 +1,124 @@
+//! @file detailsrenderhandlestate.h
+//! @brief Substance Framework asynchronous computation state definition
+//! @copyright Allegorithmic. All rights reserved.
+//!
+
+#ifndef _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSRENDERHANDLESTATE_H
+#define _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSRENDERHANDLESTATE_H
+
+#include "framework/details/detailssync.h"
+#include "framework/renderhandle.h"
+
+#include <utility>
+#include <vector>
+
+namespace Substance
+{
+namespace Details
+{
+
+class RendererImpl;
+
+//! @brief State shared by the copies of a RenderHandle
+//! Counts the render jobs of the computation, plus one reference for
+//! the creator until closed. Completes when the count falls to zero:
+//! jobs detach when marked Done by the render thread, or when deleted.
+class RenderHandleState
+{
+public:
+	//! @brief Constructor, open
+	RenderHandleState();
+
+	//! @brief A render job more
+	void attachJob();
+
+	//! @brief A render job over
+	void detachJob();
+
+	//! @brief Release the creator reference
+	void close();
+
+	//! @brief Outputs to compute by the jobs of this computation
+	void addOutputs(size_t count);
+
+	//! @brief An output of the computation is computed
+	//! @note Called from render thread
+	void outputComputed();
+
+	//! @brief Record a render job UID to cancel from the handle
+	void addRun(RendererImpl* renderer,uint32 runUid);
+
+	//! @brief Forget the jobs of a renderer being deleted
+	//! @pre The renderer main mutex is not locked
+	void forgetRenderer(RendererImpl* renderer);
+
+	//! @brief Flag as canceled by the user
+	void setCanceled();
+
+	//! @brief Cancel the jobs of every renderer
+	//! @return Return true if a render job was pending
+	bool cancel();
+
+	//! @brief Return if the computation is over
+	bool isComplete() const;
+
+	//! @brief Return if the computation was canceled
+	bool isCanceled() const;
+
+	//! @brief Return the computed outputs ratio, 1 once complete
+	float getProgress() const;
+
+	//! @brief Call a continuation once the computation is over
+	void then(
+		const RenderHandle::Continuation& continuation,
+		ENamedThreads::Type thread);
+
+protected:
+	//! @brief Continuation and the thread to call it from
+	typedef std::pair<RenderHandle::Continuation,ENamedThreads::Type> Continuation;
+
+	//! @brief Render job of a renderer
+	typedef std::pair<RendererImpl*,uint32> Run;
+
+	//! @brief Render jobs plus the creator reference
+	int32 mReferences;
+
+	//! @brief Outputs to compute, and computed
+	size_t mOutputsCount;
+	size_t mComputedCount;
+
+	//! @brief Computation over
+	bool mComplete;
+
+	//! @brief Canceled by the user
+	bool mCanceled;
+
+	//! @brief Continuations not called yet
+	std::vector<Continuation> mContinuations;
+
+	//! @brief Render jobs to cancel
+	std::vector<Run> mRuns;
+
+	//! @brief Mutex on members access, except mRuns
+	mutable Sync::mutex mMutex;
+
+	//! @brief Mutex on mRuns, kept while canceling
+	//! Lock order: mRunsMutex, renderer main mutex, mMutex
+	Sync::mutex mRunsMutex;
+
+	//! @brief Release a reference, complete if none left
+	void release();
+
+	//! @brief Dispatch a continuation to its thread
+	static void dispatch(const Continuation& continuation,bool computed);
+
+private:
+	RenderHandleState(const RenderHandleState&);
+	const RenderHandleState& operator=(const RenderHandleState&);
+};  // class RenderHandleState
+
+
+} // namespace Details
+} // namespace Substance
+
+#endif // ifndef _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSRENDERHANDLESTATE_H
@@ -16,10 +16,13 @@
 #include "framework/details/detailsstates.h"
 #include "framework/details/detailsengine.h"
 #include "framework/details/detailscomputation.h"
+#include "framework/details/detailsrenderhandlestate.h"
 
 #include <algorithm>
 
 
+const double Substance::Details::RenderJob::priorityAgingPeriod = 2.0;
+
 
 //! @brief Constructor
 //! @param callbacks User callbacks instance (or NULL if none)
@@ -31,7 +34,10 @@ Substance::Details::RenderJob::RenderJob(
 	mCanceled(false),
 	mNextJob(NULL),
 	mCallbacks(callbacks),
-	mEngine(NULL)
+	mEngine(NULL),
+	mPriority(Renderer::Priority_Background),
+	mCreationTime(FPlatformTime::Seconds()),
+	mHandleDetached(false)
 {
 }
 
@@ -55,9 +61,21 @@ Substance::Details::RenderJob::RenderJob(
 	mState(State_Setup),
 	mCanceled(false),
 	mNextJob(NULL),
+	mStateUsageCount(src.mStateUsageCount),
 	mLinkGraphs(dup.linkGraphs),
-	mCallbacks(callbacks)
+	mCallbacks(callbacks),
+	mEngine(NULL),
+	mPriority(src.mPriority),
+	mCreationTime(src.mCreationTime),
+	mHandleState(src.mHandleState),
+	mHandleDetached(false)
 {
+	// Remaining outputs of the canceled job complete its handle
+	if (mHandleState.get()!=NULL)
+	{
+		mHandleState->attachJob();
+	}
+
 	mRenderPushIOs.reserve(src.mRenderPushIOs.size());
 	
 	SBS_VECTOR_FOREACH (RenderPushIO *srcpushio,src.mRenderPushIOs)
@@ -81,6 +99,9 @@ Substance::Details::RenderJob::RenderJob(
 //! @brief Destructor
 Substance::Details::RenderJob::~RenderJob()
 {
+	// Not marked Done (renderer deleted or empty duplicate)
+	detachHandleState();
+
 	// Delete RenderPushIO elements
 	for (size_t i=0; i<mRenderPushIOs.size(); i++)
 	{
@@ -89,6 +110,50 @@ Substance::Details::RenderJob::~RenderJob()
 }
 
 
+//! @brief Mark as complete
+//! Called from render thread.
+//! @warning When called, can be immediatly destroyed by user thread
+//!		(complete jobs cleanup)
+void Substance::Details::RenderJob::setComplete()
+{
+	detachHandleState();             // before Done, job can be deleted
+	mState = State_Done;
+}
+
+
+//! @brief Attach this job to the state of a RenderHandle
+//! @pre Job must be in 'Setup' state, not attached yet
+//! @note Called from user thread
+void Substance::Details::RenderJob::setHandleState(
+	const std::shared_ptr<RenderHandleState>& handleState)
+{
+	check(State_Setup==mState);
+	check(mHandleState.get()==NULL);
+
+	mHandleState = handleState;
+	mHandleState->attachJob();
+
+	size_t outputsCount = 0;
+	SBS_VECTOR_FOREACH (const RenderPushIO *pushio,mRenderPushIOs)
+	{
+		outputsCount += pushio->getOutputsCount();
+	}
+
+	mHandleState->addOutputs(outputsCount);
+}
+
+
+//! @brief Release the handle state reference once
+void Substance::Details::RenderJob::detachHandleState()
+{
+	if (mHandleState.get()!=NULL && !mHandleDetached)
+	{
+		mHandleDetached = true;
+		mHandleState->detachJob();
+	}
+}
+
+
 //! @brief Take states snapshot (used by linker)
 //! @param states Used to take a snapshot states to use at link time
 //!
@@ -102,40 +167,119 @@ void Substance::Details::RenderJob::snapshotStates(const States &states)
 //! @brief Push I/O to render: from current state & current instance
 //! @param graphState The current graph state
 //! @param graphInstance The pushed graph instance (not kept)
+//! @param priority Priority class of the pushed outputs
 //! @pre Job must be in 'Setup' state
 //! @note Called from user thread 
 //! @return Return true if at least one dirty output
 //!
-//! Update states, create render tokens.
+//! Update states, create render tokens. Push I/O are kept sorted by class
+//! as far as the sequential order of each graph state allows: the instance
+//! goes in the first push I/O of its class after the last one pushing the
+//! same graph state.
 bool Substance::Details::RenderJob::push(
 	GraphState &graphState,
-	FGraphInstance* graphInstance)
+	FGraphInstance* graphInstance,
+	Renderer::Priority priority)
 {
 	check(State_Setup==mState);
 
-	// Get push IO index
-	uint32 pushioindex = mStateUsageCount[graphState.getUid()]++;
+	// First push IO index after the previous push of this graph state
+	const uint32 stateuid = graphState.getUid();
+	size_t pushioindex = mRenderPushIOs.size();
+	while (pushioindex>0 && 
+		!mRenderPushIOs[pushioindex-1]->hasGraphState(stateuid))
+	{
+		--pushioindex;
+	}
+	
+	// Skip more urgent push IOs
+	while (pushioindex<mRenderPushIOs.size() &&
+		mRenderPushIOs[pushioindex]->getPriority()<priority)
+	{
+		++pushioindex;
+	}
 	
-	check(pushioindex<=mRenderPushIOs.size());
-	const bool newpushio = mRenderPushIOs.size()==(size_t)pushioindex;
+	const bool newpushio = pushioindex==mRenderPushIOs.size() ||
+		mRenderPushIOs[pushioindex]->getPriority()!=priority;
 	if (newpushio)
 	{
-		// Create new push IO
-		mRenderPushIOs.push_back(new RenderPushIO(*this));
+		// Create new push IO, before the less urgent ones
+		mRenderPushIOs.insert(
+			mRenderPushIOs.begin()+pushioindex,
+			new RenderPushIO(*this,priority));
 	}
 	
 	// Push!
-	if (mRenderPushIOs.at(pushioindex)->push(graphState,graphInstance))
+	if (mRenderPushIOs[pushioindex]->push(graphState,graphInstance))
 	{
+		++mStateUsageCount[stateuid];
 		return true;
 	}
 	else if (newpushio)
 	{
 		// No dirty outputs: Remove just created, not necessary
-		delete mRenderPushIOs.back();
+		delete mRenderPushIOs[pushioindex];
 		
-		mRenderPushIOs.pop_back();
-		--mStateUsageCount[graphState.getUid()];
+		mRenderPushIOs.erase(mRenderPushIOs.begin()+pushioindex);
+	}
+	
+	return false;
+}
+
+
+//! @brief Raise the job priority class to the pushed one if more urgent
+//! @pre Job must be in 'Setup' state
+void Substance::Details::RenderJob::raisePriority(Renderer::Priority priority)
+{
+	check(State_Setup==mState);
+
+	if (priority<mPriority)
+	{
+		mPriority = priority;
+	}
+}
+
+
+//! @brief Return the priority class, promoted by one class each
+//!		priorityAgingPeriod seconds spent since the job creation
+//! @param now Current FPlatformTime::Seconds()
+int32 Substance::Details::RenderJob::getAgedPriority(double now) const
+{
+	const int32 promotion = (int32)((now-mCreationTime)/priorityAgingPeriod);
+
+	return std::max<int32>((int32)mPriority-promotion,0);
+}
+
+
+//! @brief Return if both jobs push I/O of a same graph state
+//! Such jobs must be pulled in activation order: the input deltas of
+//! one are relative to the state left by the other.
+bool Substance::Details::RenderJob::sharesGraphStates(
+	const RenderJob& other) const
+{
+	// Both maps are sorted by graph state UID
+	UidsMap::const_iterator ite = mStateUsageCount.begin();
+	UidsMap::const_iterator iteother = other.mStateUsageCount.begin();
+	while (ite!=mStateUsageCount.end() && 
+		iteother!=other.mStateUsageCount.end())
+	{
+		if (ite->first==iteother->first)
+		{
+			if (ite->second!=0 && iteother->second!=0)
+			{
+				return true;
+			}
+			++ite;
+			++iteother;
+		}
+		else if (ite->first<iteother->first)
+		{
+			++ite;
+		}
+		else
+		{
+			++iteother;
+		}
 	}
 	
 	return false;
@@ -261,10 +405,14 @@ bool Substance::Details::RenderJob::isComplete() const
 //! @return Return if at least one graph state need to be linked
 bool Substance::Details::RenderJob::isLinkNeeded() const
 {
-	if (!mRenderPushIOs.empty())
+	// Test all: the first push of a graph state may follow push IOs of
+	// more urgent classes
+	SBS_VECTOR_FOREACH (const RenderPushIO *pushio,mRenderPushIOs)
 	{
-		// Test only first one, others use graph state subset
-		return mRenderPushIOs.front()->isLinkNeeded();
+		if (pushio->isLinkNeeded())
+		{
+			return true;
+		}
 	}
 	
 	return false;
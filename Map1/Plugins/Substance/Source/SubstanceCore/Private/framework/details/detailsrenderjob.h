@@ -11,6 +11,9 @@
 #include "detailslinkgraphs.h"
 #include "detailsstates.h"
 
+#include "framework/renderer.h"
+
+#include <memory>
 #include <vector>
 #include <map>
 
@@ -28,6 +31,7 @@ struct DuplicateJob;
 class Engine;
 struct OutputsFilter;
 class RenderPushIO;
+class RenderHandleState;
 
 //! @brief Render job: set of push Input/Output to render
 //! One render job corresponds to all Renderer::push beetween two run 
@@ -72,12 +76,18 @@ public:
 	//! @brief Push I/O to render: from current state & current instance
 	//! @param graphState The current graph state
 	//! @param graphInstance The pushed graph instance (not keeped)
+	//! @param priority Priority class of the pushed outputs
 	//! @pre Job must be in 'Setup' state
 	//! @note Called from user thread 
 	//! @return Return true if at least one dirty output
 	//!
-	//! Update states, create render tokens.
-	bool push(GraphState &graphState, FGraphInstance* graphInstance);
+	//! Update states, create render tokens. The outputs are pulled after
+	//! the ones of more urgent classes pushed in this job, unless an earlier
+	//! push of the same graph state must be pulled first.
+	bool push(
+		GraphState &graphState,
+		FGraphInstance* graphInstance,
+		Renderer::Priority priority);
 	
 	//! @brief Put the job in render state, build the render chained list
 	//! @param previous Previous job in render list or NULL if first
@@ -118,6 +128,20 @@ public:
 	//! @brief Return if the current job is canceled
 	bool isCanceled() const { return mCanceled; }
 
+	//! @brief Raise the job priority class to the pushed one if more urgent
+	//! @pre Job must be in 'Setup' state
+	void raisePriority(Renderer::Priority priority);
+
+	//! @brief Return the priority class, promoted by one class each
+	//!		priorityAgingPeriod seconds spent since the job creation
+	//! @param now Current FPlatformTime::Seconds()
+	int32 getAgedPriority(double now) const;
+
+	//! @brief Return if both jobs push I/O of a same graph state
+	//! Such jobs must be pulled in activation order: the input deltas of
+	//! one are relative to the state left by the other.
+	bool sharesGraphStates(const RenderJob& other) const;
+
 	//! @brief Accessor on next job to process
 	//! @note Called from render thread 
 	RenderJob* getNextJob() const { return mNextJob; }
@@ -138,7 +162,16 @@ public:
 	//! Called from render thread.
 	//! @warning When called, can be immediatly destroyed by user thread
 	//!		(complete jobs cleanup)
-	void setComplete() { mState = State_Done; }
+	void setComplete();
+
+	//! @brief Attach this job to the state of a RenderHandle
+	//! @pre Job must be in 'Setup' state, not attached yet
+	//! @note Called from user thread
+	void setHandleState(const std::shared_ptr<RenderHandleState>& handleState);
+
+	//! @brief Accessor on the RenderHandle state (NULL if none)
+	//! Set before activation and kept until destruction
+	const std::shared_ptr<RenderHandleState>& getHandleState() const { return mHandleState; }
 	
 	//! @brief Push input and output in engine handle
 	void pull(Computation &computation);
@@ -173,10 +206,11 @@ protected:
 	RenderJob*volatile mNextJob;
 	
 	//! @brief Vector of push I/O (this instance ownership)
-	//! In sequential engine push order
+	//! In sequential engine push order, most urgent class first as far as
+	//! the order of the pushes of each graph state allows
 	RenderPushIOs mRenderPushIOs;
 	
-	//! @brief Per graph states UID usage count (used to determinate seq. index)
+	//! @brief Per graph states UID usage count
 	UidsMap mStateUsageCount;
 	
 	//! @brief All graph states valid at render job creation to use at link time
@@ -188,6 +222,24 @@ protected:
 
 	//! @brief Engine used for computation, filled when render job pulled
 	Engine* mEngine;
+
+	//! @brief Most urgent priority class of the pushes
+	Renderer::Priority mPriority;
+
+	//! @brief FPlatformTime::Seconds() at creation, kept by duplicates
+	double mCreationTime;
+
+	//! @brief State of the RenderHandle, shared w/ duplicates (or NULL)
+	std::shared_ptr<RenderHandleState> mHandleState;
+
+	//! @brief Handle state reference released
+	bool mHandleDetached;
+
+	//! @brief Release the handle state reference once
+	void detachHandleState();
+
+	//! @brief Seconds a job waits before being promoted by one class
+	static const double priorityAgingPeriod;
 		
 private:
 	RenderJob(const RenderJob&);
@@ -17,6 +17,7 @@
 #include "framework/details/detailsrenderjob.h"
 #include "framework/details/detailsrendertoken.h"
 #include "framework/details/detailsoutputsfilter.h"
+#include "framework/details/detailsrenderhandlestate.h"
 #include "framework/details/detailsstates.h"
 
 #include "SubstanceCallbacks.h"
@@ -29,10 +30,17 @@ using namespace Substance::Details;
 
 //! @brief Create from render job
 //! @param renderJob Parent render job that owns this instance
+//! @param priority Priority class of the instances pushed in it
 //! @note Called from user thread 
-Substance::Details::RenderPushIO::RenderPushIO(RenderJob &renderJob) :
+Substance::Details::RenderPushIO::RenderPushIO(
+		RenderJob &renderJob,
+		Renderer::Priority priority) :
 	mRenderJob(renderJob),
-	mState(State_None)
+	mPriority(priority),
+	mState(State_None),
+	mInputJobPendingCount(0),
+	mPulledOutputsCount(0),
+	mComputedOutputsCount(0)
 {
 }
 
@@ -51,7 +59,11 @@ Substance::Details::RenderPushIO::RenderPushIO(
 		const RenderPushIO& src,
 		DuplicateJob& dup) :
 	mRenderJob(renderJob),
-	mState(State_None)
+	mPriority(src.mPriority),
+	mState(State_None),
+	mInputJobPendingCount(0),
+	mPulledOutputsCount(0),
+	mComputedOutputsCount(0)
 {
 	OutputsFilter::Outputs foutsdummy;
 	
@@ -94,6 +106,7 @@ Substance::Details::RenderPushIO::RenderPushIO(
 			}
 		
 			if (!srcout.renderToken->isComputed() &&  // Skip if is computed
+				!srcout.renderToken->isRenderCanceled() &&  // Skip if canceled
 				(foutitecur==foutiteend || 
 					(*foutitecur)!=srcout.index))     // Skip if filtered
 			{
@@ -201,6 +214,8 @@ void Substance::Details::RenderPushIO::pull(
 		mDestOutputs.end(),
 		(const Output*)NULL);
 	mInputJobPendingCount = 0;
+	mPulledOutputsCount = 0;
+	mComputedOutputsCount = 0;
 	
 	// Output SBSBIN indices to push
 	std::vector<uint32> indicesout;
@@ -251,7 +266,12 @@ void Substance::Details::RenderPushIO::pull(
 			SBS_VECTOR_FOREACH (const Output& output,instance->outputs)
 			{
 				check(binary.outputs.size()>output.index);
-				if (!output.renderToken->isComputed())
+				if (output.renderToken->isRenderCanceled())
+				{
+					// Canceled output, removable from its OutputInstance
+					output.renderToken->fill(NULL);
+				}
+				else if (!output.renderToken->isComputed())
 				{
 					// Only if not already computed
 					const uint32 binindex = binary.outputs[output.index].index;
@@ -263,6 +283,7 @@ void Substance::Details::RenderPushIO::pull(
 						
 						// Has outputs pending
 						mState |= State_OutputsPending;
+						++mPulledOutputsCount;
 						
 						// Fill render token
 						if (mDestOutputs.size()<=binindex)
@@ -365,8 +386,24 @@ bool Substance::Details::RenderPushIO::isLinkNeeded() const
 }
 
 
+//! @brief Return if an instance of this graph state is pushed
+//! @param stateUid The graph state UID
+bool Substance::Details::RenderPushIO::hasGraphState(uint32 stateUid) const
+{
+	SBS_VECTOR_FOREACH (const Instance *instance,mInstances)
+	{
+		if (instance->graphState.getUid()==stateUid)
+		{
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
 //! @brief Accessor: At least one output to compute
-//! Check all render tokens if not already filled
+//! Check all render tokens if not already filled or canceled
 bool Substance::Details::RenderPushIO::hasOutputs() const
 {
 	SBS_VECTOR_FOREACH (const Instance *instance,mInstances)
@@ -381,6 +418,19 @@ bool Substance::Details::RenderPushIO::hasOutputs() const
 }
 
 
+//! @brief Accessor: Number of outputs pushed, computed or not
+size_t Substance::Details::RenderPushIO::getOutputsCount() const
+{
+	size_t count = 0;
+	SBS_VECTOR_FOREACH (const Instance *instance,mInstances)
+	{
+		count += instance->outputs.size();
+	}
+
+	return count;
+}
+
+
 //! @brief Return if the current Push I/O is completed
 //! @param inputOnly Only inputs are required
 //! @note Called from Render queue thread
@@ -438,16 +488,45 @@ void Substance::Details::RenderPushIO::callbackOutputComplete(
 	check(mDestOutputs[index]!=NULL);
 	
 	const Output& output = *mDestOutputs[index];
+
+	// described before the user thread can grab the result
+	SubstanceTexture resultTexture;
+	memset(&resultTexture,0,sizeof(resultTexture));
+	if (renderResult!=NULL)
+	{
+		resultTexture = renderResult->getTexture();
+		resultTexture.buffer = NULL;
+	}
+
 	output.renderToken->fill(renderResult);
 
-	// Emit callback if plugged
+	if (mRenderJob.getHandleState().get()!=NULL)
+	{
+		mRenderJob.getHandleState()->outputComputed();
+	}
+
+	// Outputs pulled together share their intermediate nodes
+	++mComputedOutputsCount;
+	const float progress = mPulledOutputsCount!=0 ?
+		(float)mComputedOutputsCount/(float)mPulledOutputsCount :
+		1.0f;
+	SBS_VECTOR_FOREACH (const Output* destoutput,mDestOutputs)
+	{
+		if (destoutput!=NULL)
+		{
+			destoutput->renderToken->setProgress(progress);
+		}
+	}
+
+	// Emit callback if plugged, canceled results were released
 	RenderCallbacks* callbacks = mRenderJob.getCallbacks();
-	if (callbacks!=NULL)
+	if (callbacks!=NULL && !output.renderToken->isRenderCanceled())
 	{
 		callbacks->outputComputed(
 			mRenderJob.getUid(),
 			output.graphInstance,
-			output.outputInstance);
+			output.outputInstance,
+			resultTexture);
 	}
 }
 
@@ -476,8 +555,8 @@ Substance::Details::RenderPushIO::Instance::Instance(
 			newout.outputInstance = &(*ItOut);
 			newout.graphInstance = graphInstance;
 			
-			// Create render token
-			newout.renderToken.reset(new RenderToken());
+			// Create render token, keyed w/ the inputs pushed below
+			newout.renderToken.reset(new RenderToken(ItOut->getCacheKey()));
 			ItOut->push(newout.renderToken);
 		}
 		++outindex;
@@ -504,12 +583,13 @@ Substance::Details::RenderPushIO::Instance::Instance(const Instance &src) :
 
 
 //! @brief Accessor: At least one output to compute
-//! Check all render tokens if not already filled
+//! Check all render tokens if not already filled or canceled
 bool Substance::Details::RenderPushIO::Instance::hasOutputs() const
 {
 	SBS_VECTOR_FOREACH (const Output& output,outputs)
 	{
-		if (!output.renderToken->isComputed())
+		if (!output.renderToken->isComputed() &&
+			!output.renderToken->isRenderCanceled())
 		{
 			return true;
 		}
@@ -36,8 +36,9 @@ public:
 
 	//! @brief Create from render job
 	//! @param renderJob Parent render job that owns this instance
+	//! @param priority Priority class of the instances pushed in it
 	//! @note Called from user thread 
-	RenderPushIO(RenderJob &renderJob);
+	RenderPushIO(RenderJob &renderJob,Renderer::Priority priority);
 	
 	//! @brief Constructor from push I/O to duplicate
 	//! @param renderJob Parent render job that owns this instance
@@ -46,8 +47,8 @@ public:
 	//! Build a push I/O from a canceled one and optionnaly filter outputs.
 	//! Push again SRC render tokens (of not filtered outputs).
 	//! @warning Resulting push I/O can be empty (hasOutputs()==false) if all
-	//!		outputs are filtered OR already computed. In this case this push IO 
-	//!		is no more usefull and can be removed.
+	//!		outputs are filtered, canceled OR already computed. In this case
+	//!		this push IO is no more usefull and can be removed.
 	//! @note Called from user thread
 	RenderPushIO(RenderJob &renderJob,const RenderPushIO& src,DuplicateJob& dup);
 	
@@ -70,6 +71,8 @@ public:
 
 	//! @brief Push input and output in engine handle
 	//! @param inputsOnly If true only inputs are pushed
+	//! Outputs canceled by RenderToken::cancelRender() are NULL filled
+	//! instead of pushed, the inputs are always pushed.
 	//! @post Push I/O state is reverted to correct State_xxxPending(s)
 	//! @note Called from Render queue thread
 	void pull(Computation &computation,bool inputsOnly);
@@ -88,6 +91,16 @@ public:
 	//! @brief Accessor: At least one output to compute
 	//! Check all render tokens if not already filled
 	bool hasOutputs() const;
+
+	//! @brief Accessor: Number of outputs pushed, computed or not
+	size_t getOutputsCount() const;
+
+	//! @brief Return if an instance of this graph state is pushed
+	//! @param stateUid The graph state UID
+	bool hasGraphState(uint32 stateUid) const;
+
+	//! @brief Accessor on the priority class of the pushed instances
+	Renderer::Priority getPriority() const { return mPriority; }
 	
 	//! @brief Return if the current Push I/O is completed
 	//! @param inputOnly Only inputs are required
@@ -103,6 +116,8 @@ public:
 	//! @param index Output SBSBIN index of completed output
 	//! @param renderResult The result texture, ownership transfered
 	//! @note Called by engine callback from Render queue thread
+	//! Progress of the outputs still computing is the computed ratio of
+	//! the outputs pulled together.
 	void callbackOutputComplete(uint32 index,RenderResult* renderResult);
 
 	//! @brief Accessor on parent job engine pointer filled when pulled
@@ -171,7 +186,7 @@ protected:
 		Outputs outputs;
 		
 		//! @brief Accessor: At least one output to compute
-		//! Check all render tokens if not already filled
+		//! Check all render tokens if not already filled or canceled
 		bool hasOutputs() const;
 		
 	};  // struct Instance
@@ -182,6 +197,10 @@ protected:
 	//! @brief Parent render job
 	RenderJob &mRenderJob;
 	
+	//! @brief Priority class of the pushed instances
+	//! Pulled after the push I/O of more urgent classes of the job
+	const Renderer::Priority mPriority;
+
 	//! @brief Current state
 	volatile uint32 mState;
 	
@@ -197,6 +216,11 @@ protected:
 	//! Decreased by callbackJobComplete, can be negative: last job is output
 	//! computation.
 	int mInputJobPendingCount;
+
+	//! @brief Number of outputs pushed into Engine, and computed
+	//! Filled when pushed into Engine, canceled outputs skipped
+	size_t mPulledOutputsCount;
+	size_t mComputedOutputsCount;
 	
 private:
 	RenderPushIO(const RenderPushIO&);
@@ -12,11 +12,14 @@
 
 
 //! @brief Constructor
-Substance::Details::RenderToken::RenderToken() :
+Substance::Details::RenderToken::RenderToken(const FString& cacheKey) :
 	mRenderResult(NULL),
 	mFilled(false),
+	mRenderCanceled(false),
+	mProgress(0.0f),
 	mPushCount(1),
-	mRenderCount(1)
+	mRenderCount(1),
+	mCacheKey(cacheKey)
 {
 }
 
@@ -35,6 +38,15 @@ Substance::Details::RenderToken::~RenderToken()
 //! @brief Fill render result (grab ownership)
 void Substance::Details::RenderToken::fill(RenderResult* renderResult)
 {
+	// Not atomic w/ the swap below: a later cancel releases the result
+	// through cancelRender() or grabResult()
+	if (mRenderCanceled && renderResult!=NULL)
+	{
+		// Computed before canceled, NULL filled: nothing to upload
+		delete renderResult;
+		renderResult = NULL;
+	}
+
 	RenderResult* prevrres = (RenderResult*)Sync::interlockedSwapPointer(
 		(void*volatile*)&mRenderResult,
 		renderResult);
@@ -82,7 +94,32 @@ bool Substance::Details::RenderToken::canRemove()
 }
 
 
+//! @brief Cancel this output only, the rest of the job goes on
+//! Not pushed to the engine if not pulled yet, result released otherwise.
+//! A result filled afterwards is released by grabResult().
+bool Substance::Details::RenderToken::cancelRender()
+{
+	mRenderCanceled = true;
+
+	if (!mFilled)
+	{
+		return true;
+	}
+
+	// Computed, waiting for upload
+	RenderResult* res = (RenderResult*)Sync::interlockedSwapPointer(
+		(void*volatile*)&mRenderResult,
+		NULL);
+
+	delete res;
+
+	return res!=NULL;
+}
+
+
 //! @brief Return render result or NULL if pending, transfer ownership
+//! The result gets the cache key of the push. Results of canceled tokens
+//! are released instead, NULL is returned.
 //! @post mRenderResult becomes NULL
 Substance::RenderResult* Substance::Details::RenderToken::grabResult()
 {
@@ -93,6 +130,18 @@ Substance::RenderResult* Substance::Details::RenderToken::grabResult()
 			(void*volatile*)&mRenderResult,
 			NULL);
 	}
+
+	// Filled while canceled, see cancelRender()
+	if (res!=NULL && mRenderCanceled)
+	{
+		delete res;
+		res = NULL;
+	}
+
+	if (res!=NULL)
+	{
+		res->setCacheKey(mCacheKey);
+	}
 	
 	return res;
 }
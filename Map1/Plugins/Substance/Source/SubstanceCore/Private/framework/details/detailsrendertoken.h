@@ -21,7 +21,8 @@ class RenderToken
 public:
 
 	//! @brief Constructor
-	RenderToken();
+	//! @param cacheKey Cache key of the pushed inputs, empty if not cached
+	explicit RenderToken(const FString& cacheKey);
 
 	//! @brief Destructor
 	//! Delete render result if present
@@ -43,8 +44,27 @@ public:
 	
 	//! @brief Return if already computed
 	bool isComputed() const { return mFilled; }
+
+	//! @brief Cancel this output only, the rest of the job goes on
+	//! Not pushed to the engine if not pulled yet, result released otherwise.
+	//! A result filled afterwards is released by grabResult().
+	//! @note Called from user thread
+	//! @return Return true if not computed yet or its result was not grabbed
+	bool cancelRender();
+
+	//! @brief Return if this output was canceled by cancelRender()
+	bool isRenderCanceled() const { return mRenderCanceled; }
+
+	//! @brief Set the computation progress, from engine callbacks
+	//! @note Called from render thread
+	void setProgress(float progress) { mProgress = progress; }
+
+	//! @brief Return the computation progress, 1 once computed
+	float getProgress() const { return mFilled ? 1.0f : mProgress; }
 	
 	//! @brief Return render result or NULL if pending, transfer ownership
+	//! The result gets the cache key of the push. Results of canceled
+	//! tokens are released instead, NULL is returned.
 	//! @post mRenderResult becomes NULL
 	RenderResult* grabResult();
 
@@ -60,6 +80,12 @@ protected:
 
 	//! @brief True if filled, can be removed in OutputInstance
 	volatile bool mFilled;
+
+	//! @brief True if canceled by cancelRender()
+	volatile bool mRenderCanceled;
+
+	//! @brief Computation progress while not filled
+	volatile float mProgress;
 	
 	//! @brief Pushed in OutputInstance count
 	size_t mPushCount;
@@ -67,6 +93,9 @@ protected:
 	//! @brief Render pending count (not canceled)
 	size_t mRenderCount;
 
+	//! @brief Cache key of the inputs pushed, empty if not cached
+	const FString mCacheKey;
+
 	//! @brief Delete render result
 	static void clearRenderResult(RenderResult* renderResult);
 
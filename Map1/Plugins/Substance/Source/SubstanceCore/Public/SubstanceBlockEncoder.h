@@ -0,0 +1,41 @@
+//! @file SubstanceBlockEncoder.h
+//! @brief BC1, BC3, BC4 and BC5 encoders of the uncompressed outputs
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+namespace Substance
+{
+	//! @brief Block compression of 8 bits images, on the CPU
+	namespace BlockEncoder
+	{
+		//! @brief Block compressed formats
+		enum EBlockFormat
+		{
+			BF_BC1,		//!< rgb, from rgba8 pixels
+			BF_BC3,		//!< rgba, from rgba8 pixels
+			BF_BC4,		//!< r, from 8 bits pixels
+			BF_BC5,		//!< rg, from rgba8 pixels
+		};
+
+		//! @brief Return the bytes of a 4x4 block
+		SUBSTANCECORE_API uint32 GetBlockBytes(EBlockFormat Format);
+
+		//! @brief Return the bytes of a source pixel
+		SUBSTANCECORE_API uint32 GetSourcePixelBytes(EBlockFormat Format);
+
+		//! @brief Encode the 4x4 blocks of an image
+		//! @param bHighQuality Fit the endpoints to the principal axis of the
+		//!		colors and refine them, instead of the bounding box
+		//! @param bParallel Encode rows of blocks on task threads, false when
+		//!		called from a task
+		//! @note Rows and columns beyond the image repeat the last ones
+		SUBSTANCECORE_API void EncodeImage(
+			const uint8* Src,
+			uint32 SizeX,
+			uint32 SizeY,
+			EBlockFormat Format,
+			bool bHighQuality,
+			uint8* Dest,
+			bool bParallel = true);
+	}
+}
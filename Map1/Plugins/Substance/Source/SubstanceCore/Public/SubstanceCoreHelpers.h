@@ -5,6 +5,8 @@
 
 #include "substance_public.h"
 
+#include <functional>
+
 class USubstanceInstanceFactory;
 class USubstanceGraphInstance;
 class USubstanceImageInput;
@@ -48,8 +50,50 @@ namespace Substance
 		//! @brief Render queued graph instances
 		void PerformDelayedRender();
 
+		//! @brief Log2 of the output size of an instance ($outputsize input)
+		void GetOutputSizeLog2(graph_inst_t* Graph, int32& SizeLog2X, int32& SizeLog2Y);
+
+		//! @brief Estimated bytes uploaded for a result
+		//! @note From the result size, format and mipmaps, its buffer is not read
+		int64 EstimateUploadBytes(const SubstanceTexture& ResultText);
+
+		//! @brief Dimensions of each mip of a result, in buffer order
+		void GetMipSizes(const SubstanceTexture& ResultText, TArray<FIntPoint>& Sizes);
+
+		//! @brief Dimensions of each mip of a result stored in another format
+		void GetMipSizes(const SubstanceTexture& ResultText, EPixelFormat Format, TArray<FIntPoint>& Sizes);
+
+		//! @brief Process rows in blocks on task threads, serially when small
+		//! @param Body Called w/ the first row and the rows count of each block
+		SUBSTANCECORE_API void ParallelForRows(int32 Rows, SIZE_T RowBytes, const std::function<void(int32, int32)>& Body);
+
+		//! @brief Copy a buffer in blocks on task threads, serially when small
+		SUBSTANCECORE_API void ParallelCopy(void* Dest, const void* Src, SIZE_T Size);
+
+		//! @brief Copy a result's mip chain as the texture's mip storage
+		//! @return Return false if the copy is block compressed on a task thread
+		//! first, when the output compression of the texture is set. The texture
+		//! keeps its mips until the next Tick following the encode.
+		bool UpdateSubstanceOutput(USubstanceTexture2D* Texture, const SubstanceTexture& ResultText);
+
+		//! @brief Bytes copied by UpdateSubstanceOutput since startup
+		int64 GetCopiedOutputBytes();
+
+		//! @brief Adopt a result's buffer as the texture's mip storage, without copy
+		//! @param Format Pixel format of the buffer, the one of the result if unknown
+		//! @pre The ownership of the result buffer is transferred to the texture
+		void AdoptSubstanceOutput(USubstanceTexture2D* Texture, const SubstanceTexture& ResultText, EPixelFormat Format = PF_Unknown);
+
 		//! @brief Update Texture Output
-		void UpdateTexture(const SubstanceTexture& result, output_inst_t* Output, bool bCacheResults = true);
+		void UpdateTexture(const SubstanceTexture& result, output_inst_t* Output);
+
+		//! @brief Update Texture Output from a render result
+		//! @note The result buffer is handed over to the cache writer when the
+		//!		result has a cache key
+		void UpdateTexture(RenderResult& Result, output_inst_t* Output);
+
+		//! @brief Tell if the results of this output go to the disk cache
+		bool ShouldCacheOutput(const output_inst_t* Output);
 
 		//! @brief Perform per frame Substance management
 		SUBSTANCECORE_API void Tick();
@@ -57,6 +101,25 @@ namespace Substance
 		//! @brief Cancel pending renders etc.
 		void CancelPendingActions();
 
+		//! @brief Cancel the renders of an instance, the other instances go on
+		//! Its outputs stay dirty until it is rendered again, their results
+		//! not uploaded yet are released.
+		//! @return Return true if a render or an upload was pending
+		SUBSTANCECORE_API bool CancelRender(graph_inst_t*);
+
+		//! @brief Cancel the renders of one output, the other outputs go on
+		//! The output is skipped until its instance is rendered again, its
+		//! results not uploaded or encoded yet are released.
+		//! @return Return true if a render or an upload was pending
+		SUBSTANCECORE_API bool CancelRender(output_inst_t*);
+
+		//! @brief Progress of the render of an output, in [0, 1]
+		//! @note Dirty outputs are 0 until computed, 1 if nothing is pending
+		SUBSTANCECORE_API float GetRenderProgress(output_inst_t*);
+
+		//! @brief Mean progress of the enabled outputs of an instance
+		SUBSTANCECORE_API float GetRenderProgress(graph_inst_t*);
+
 		//! @brief Create a texture 2D object using an output instance desc.
 		SUBSTANCECORE_API void CreateSubstanceTexture2D(FOutputInstance* OutputInstance, bool bTransient = false, FString Name = FString(), UObject* InOuter=NULL);
 
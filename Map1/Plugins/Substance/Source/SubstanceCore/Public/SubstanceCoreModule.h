@@ -45,6 +45,9 @@ private:
 
 	static void OnWorldInitialized(UWorld* World, const UWorld::InitializationValues IVS);
 
+	//! @brief Save the cache manifest of the world
+	static void OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources);
+
 	void LoadSubstanceLibraries();
 };
 
@@ -77,6 +77,23 @@ namespace Substance
 
 		bool isDirty() const { return bIsDirty; }
 
+		//! @brief Cancel the pending renders of this output only
+		//! Results computed but not uploaded yet are released. The output
+		//! stays dirty, and is skipped by the renders of its instance until
+		//! resumeRender().
+		//! @return Return true if a render or an upload was pending
+		SUBSTANCECORE_API bool cancelRender();
+
+		//! @brief Render this output again with its instance
+		void resumeRender() { bIsRenderCanceled = false; }
+
+		bool isRenderCanceled() const { return bIsRenderCanceled; }
+
+		//! @brief Progress of the latest render of this output
+		//! @return From 0 when queued to 1 once computed, 1 if none pending,
+		//!		0 if canceled
+		SUBSTANCECORE_API float getRenderProgress() const;
+
 		//! @brief Substance UID of the reference output desc
 		uint32		Uid;
 
@@ -91,6 +108,12 @@ namespace Substance
 
 		uint32	bIsDirty:1;
 
+		//! @brief Skipped by renders, see cancelRender()
+		uint32	bIsRenderCanceled:1;
+
+		//! @brief Non zero while waiting for upload in the output queue
+		volatile int32 QueuedForUpload;                         //!< Internal use only
+
 		//! @brief Actual texture class of the host engine
 		MS_ALIGN(16) std::shared_ptr<USubstanceTexture2D*> Texture;
 
@@ -102,6 +125,9 @@ namespace Substance
 
 		bool queueRender();                                     //!< Internal use only
 
+		//! @brief Cache key of the current inputs, empty if not cached
+		FString getCacheKey() const;                            //!< Internal use only
+
 	protected:
 		void releaseTokensOwnedByEngine(uint32 engineUid);
 
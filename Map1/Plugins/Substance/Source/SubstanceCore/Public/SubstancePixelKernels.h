@@ -0,0 +1,55 @@
+//! @file SubstancePixelKernels.h
+//! @brief Vectorized pixel conversion kernels of the output and input paths
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+namespace Substance
+{
+	//! @brief Pixel conversions, the best instruction set of the CPU is picked
+	//! at startup. Sources and destinations need no alignment.
+	namespace Kernels
+	{
+		//! @brief Instruction sets of the kernels, scalar is always available
+		enum EInstructionSet
+		{
+			IS_Scalar,
+			IS_SSE2,
+			IS_AVX2,
+			IS_Count
+		};
+
+		//! @brief Swap the red and blue channels of 8 bits rgba pixels
+		//! @note Src and Dest may be the same buffer
+		SUBSTANCECORE_API void SwizzleRB(const uint8* Src, uint8* Dest, SIZE_T PixelCount);
+
+		//! @brief Write an 8 bits channel as the alpha of 8 bits rgba pixels
+		SUBSTANCECORE_API void InterleaveAlpha(const uint8* Alpha, uint8* Dest, SIZE_T PixelCount);
+
+		//! @brief Read the alpha of 8 bits rgba pixels as an 8 bits channel
+		SUBSTANCECORE_API void DeinterleaveAlpha(const uint8* Src, uint8* Alpha, SIZE_T PixelCount);
+
+		//! @brief Fill 32 bits pixels with a value, stored in native byte order
+		SUBSTANCECORE_API void Fill32(uint8* Dest, uint32 Value, SIZE_T PixelCount);
+
+		//! @brief Convert 16 bits channels to 8 bits, keeping the high byte
+		SUBSTANCECORE_API void Convert16To8(const uint16* Src, uint8* Dest, SIZE_T Count);
+
+		//! @brief Return if every alpha of the 8 bits rgba pixels is 255
+		SUBSTANCECORE_API bool IsOpaque(const uint8* Src, SIZE_T PixelCount);
+
+		//! @brief Return the instruction set in use
+		SUBSTANCECORE_API EInstructionSet GetInstructionSet();
+
+		//! @brief Return if the CPU supports an instruction set
+		SUBSTANCECORE_API bool IsSupported(EInstructionSet InstructionSet);
+
+		//! @brief Use another instruction set, if supported
+		//! @pre No kernel runs, the switch is not synchronized w/ the
+		//!		rendering and task threads: call it before any output is updated
+		//! @return Return false if the CPU does not support it
+		SUBSTANCECORE_API bool SetInstructionSet(EInstructionSet InstructionSet);
+
+		//! @brief Return the name of an instruction set
+		SUBSTANCECORE_API const TCHAR* GetInstructionSetName(EInstructionSet InstructionSet);
+	}
+}
@@ -7,6 +7,7 @@
 #define _SUBSTANCE_FRAMEWORK_CALLBACKS_H
 
 #include "SubstanceCoreTypedefs.h"
+#include "substance_public.h"
 
 namespace Substance
 {
@@ -32,13 +33,16 @@ struct Callbacks
 	//! @brief graphInstance Pointer on output parent graph instance
 	//! @param outputInstance Pointer on computed output instance w/ new render
 	//!		result just available (use OutputInstance::grabResult() to grab it).
+	//! @param resultTexture Size, format and mipmaps of the new render result,
+	//!		its buffer is NULL: the result may already be grabbed.
 	//! @note This callback must be implemented in concrete Callbacks structures.
 	//!
 	//! Called each time an new render result is just available.
 	virtual void outputComputed(
 		uint32 runUid,
 		const FGraphInstance* graphInstance,
-		FOutputInstance* outputInstance) = 0;
+		FOutputInstance* outputInstance,
+		const SubstanceTexture& resultTexture) = 0;
 
 	//! @brief Render process execution callback
 	//! @param renderFunction Pointer to function to call.
@@ -38,6 +38,10 @@ public:
 	//! @param cxt Used to push link data
 	virtual bool push(LinkContext& cxt) const = 0;
 
+	//! @brief Feed everything that changes the link result
+	//! @param sha Hash of the link key (@see LinkCache)
+	virtual void hashKey(FSHA1& sha) const = 0;
+
 private:
 	LinkData(const LinkData&);
 	const LinkData& operator=(const LinkData&);
@@ -59,6 +63,9 @@ public:
 	//! @brief Push data to link
 	//! @param cxt Used to push link data
 	bool push(LinkContext& cxt) const;
+
+	//! @brief Feed the assembly hash and output formats
+	void hashKey(FSHA1& sha) const;
 	
 	//! @brief Force output format/mipmap
 	//! @param uid Output uid
@@ -100,6 +107,9 @@ protected:
 
 	//! @brief Assembly data
 	std::string mAssembly;
+
+	//! @brief SHA1 of the assembly data, computed at construction
+	FSHAHash mAssemblyHash;
 	
 	//! @brief Output formats override
 	OutputFormats mOutputFormats;
@@ -126,6 +136,9 @@ public:
 	//! @brief Push data to link
 	//! @param cxt Used to push link data
 	bool push(LinkContext& cxt) const;
+
+	//! @brief Feed the pre and post link data and the connections
+	void hashKey(FSHA1& sha) const;
 	
 	//! @brief Connections options.
 	ConnectionsOptions mOptions;
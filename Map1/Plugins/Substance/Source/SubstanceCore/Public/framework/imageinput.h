@@ -83,6 +83,11 @@ public:
 	//!		Use shared pointer mechanism instead.
 	~ImageInput();
 
+	//! @brief SHA1 of the texture description and content
+	//! Computed on the first call following a ScopedAccess, used to key
+	//! cached outputs.
+	const FSHAHash& getContentHash() const;
+
 	bool resolveDirty();                            //!< Internal use only
 	Details::ImageInputToken* getToken() const;     //!< Internal use only
 
@@ -91,6 +96,10 @@ protected:
 	bool mDirty;
 	std::shared_ptr<Details::ImageInputToken> mImageInputToken;
 
+	//! @brief Content hash, invalidated by ScopedAccess
+	mutable FSHAHash mContentHash;
+	mutable bool mContentHashed;
+
 	ImageInput(std::shared_ptr<Details::ImageInputToken>);
 
 private:
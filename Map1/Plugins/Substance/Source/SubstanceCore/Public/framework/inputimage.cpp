@@ -22,6 +22,7 @@ Substance::ImageInput::ScopedAccess::ScopedAccess(
 	check(mInputImage);
 	mInputImage->mImageInputToken->lock();
 	mInputImage->mDirty = true;
+	mInputImage->mContentHashed = false;
 }
 
 
@@ -78,11 +79,47 @@ Substance::Details::ImageInputToken*
 Substance::ImageInput::ImageInput(
 	std::shared_ptr<Details::ImageInputToken> token) :
 	mDirty(true),
-	mImageInputToken(token)
+	mImageInputToken(token),
+	mContentHashed(false)
 {
 }
 
 
+//! @brief SHA1 of the texture description and content
+//! Computed on the first call following a ScopedAccess
+const FSHAHash& Substance::ImageInput::getContentHash() const
+{
+	if (!mContentHashed)
+	{
+		Details::ImageInputToken*const tknblend = mImageInputToken.get();
+		tknblend->lock();
+
+		const SubstanceTextureInput& texinp = tknblend->texture;
+		const int32 desc[] = {
+			(int32)texinp.level0Width,
+			(int32)texinp.level0Height,
+			(int32)texinp.pixelFormat,
+			(int32)texinp.mipmapCount };
+
+		FSHA1 sha;
+		sha.Update((const uint8*)desc,sizeof(desc));
+		if (texinp.mTexture.buffer!=NULL)
+		{
+			sha.Update(
+				(const uint8*)texinp.mTexture.buffer,
+				tknblend->bufferSize);
+		}
+		sha.Final();
+		sha.GetHash(mContentHash.Hash);
+
+		mContentHashed = true;
+		tknblend->unlock();
+	}
+
+	return mContentHash;
+}
+
+
 //! @brief Internal use only
 bool Substance::ImageInput::resolveDirty()
 {
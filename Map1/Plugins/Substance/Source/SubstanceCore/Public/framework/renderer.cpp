@@ -27,7 +27,7 @@ Substance::Renderer::~Renderer()
 }
 
 
-void Substance::Renderer::push(Substance::FGraphInstance* graph)
+void Substance::Renderer::push(Substance::FGraphInstance* graph, Priority priority)
 {
 	Details::LinkDataAssembly *linkdata =
 		(Details::LinkDataAssembly *)graph->Desc->Parent->getLinkData().get();
@@ -39,18 +39,18 @@ void Substance::Renderer::push(Substance::FGraphInstance* graph)
 		return;
 	}
 	
-	mRendererImpl->push(graph);
+	mRendererImpl->push(graph, priority);
 }
 
 
-void Substance::Renderer::push(Substance::List<Substance::FGraphInstance*>& graphs)
+void Substance::Renderer::push(Substance::List<Substance::FGraphInstance*>& graphs, Priority priority)
 {
 	Substance::List<Substance::FGraphInstance*>::TIterator
 		ItGraph(graphs.itfront());
 
 	for (;ItGraph;++ItGraph)
 	{
-		push(*ItGraph);
+		push(*ItGraph, priority);
 	}
 }
 
@@ -61,6 +61,22 @@ int32 Substance::Renderer::run(uint32 runOptions)
 }
 
 
+Substance::RenderHandle Substance::Renderer::runAsync(uint32 runOptions, const RenderHandle& handle)
+{
+	RenderHandle result = handle.isValid() ? handle : RenderHandle::create();
+
+	mRendererImpl->run(runOptions | Run_Asynchronous, result.getState());
+
+	// the caller closes the handles it opened
+	if (!handle.isValid())
+	{
+		result.close();
+	}
+
+	return result;
+}
+
+
 bool Substance::Renderer::cancel(uint32 runUid)
 {
 	return mRendererImpl->cancel(runUid);
@@ -85,6 +101,12 @@ void Substance::Renderer::clearCache()
 }
 
 
+bool Substance::Renderer::trim()
+{
+	return mRendererImpl->trim();
+}
+
+
 bool Substance::Renderer::isPending(uint32 runUid) const
 {
 	return mRendererImpl->isPending(runUid);
@@ -9,6 +9,7 @@
 #include "SubstanceFGraph.h"
 #include "SubstanceCallbacks.h"
 #include "renderopt.h"
+#include "renderhandle.h"
 
 #include <map>
 
@@ -36,6 +37,18 @@ public:
 		Run_PreserveRun  = 8   //!< In any case, preserve currently running job 
 	};
 
+	//! @brief Priority classes enumeration used as argument by push() method
+	//! Pending outputs are computed by class, most urgent first. Waiting
+	//! jobs are promoted over time so that no class is starved. Outputs of
+	//! less urgent jobs already computing are preempted at output
+	//! granularity: the engine stops after the output being computed.
+	enum Priority
+	{
+		Priority_Visible    = 0,  //!< Needed on screen now
+		Priority_Nearby     = 1,  //!< Likely needed soon
+		Priority_Background = 2   //!< Prefetch, no visible impact
+	};
+
 	//! @brief Default constructor
 	//! @param renderOptions Optional render options. Allows to set initial
 	//!		memory consumption budget.
@@ -54,10 +67,12 @@ public:
 	//! considered dirty (and therefore are computed later).
 	//! @note Note that the rendering process is not started by this command but
 	//! with the run() method.
-	void push(FGraphInstance*);
+	//! @param priority Class of the pushed outputs, a render job takes the
+	//!		most urgent class of its pushes and pulls them by class.
+	void push(FGraphInstance*, Priority priority = Priority_Visible);
 
 	//! @brief Helper: Push graph instance arrays to render
-	void push(Substance::List<Substance::FGraphInstance*>&);
+	void push(Substance::List<Substance::FGraphInstance*>&, Priority priority = Priority_Visible);
 
 	//! @brief Launch synchronous/asynchronous computation
 	//! @param runOptions Combination of RunOption flags
@@ -69,6 +84,19 @@ public:
 	//! Returns after computation end in synchronous mode, otherwise
 	//! returns immediatly.
 	int32 run(uint32 runOptions = Run_Default);
+
+	//! @brief Launch asynchronous computation, w/ a handle on it
+	//! @param runOptions Combination of RunOption flags, Run_Asynchronous
+	//!		is implied
+	//! @param handle Open handle to add the computation to (see
+	//!		RenderHandle::create()), or invalid handle for a new one
+	//! @return Return the handle, complete if no pushed computation to run
+	//!
+	//! Completion, progress and cancellation are read from the handle
+	//! instead of polling isPending().
+	RenderHandle runAsync(
+		uint32 runOptions = Run_Asynchronous,
+		const RenderHandle& handle = RenderHandle());
 	
 	//! @brief Cancel a computation
 	//! @param runUid UID of the computation to cancel (returned by run())
@@ -81,6 +109,12 @@ public:
 	//! @brief Clear the substance cache
 	void clearCache();
 
+	//! @brief Release engine memory once all computations are over
+	//! Keeps the engine context, linker and render thread, unlike
+	//!	recreating the renderer. Next run relinks the pushed instances.
+	//! @return Return false if a computation is pushed or pending
+	bool trim();
+
 	//! @brief Flush computation, wait for all render jobs to be complete
 	void flush();
 	
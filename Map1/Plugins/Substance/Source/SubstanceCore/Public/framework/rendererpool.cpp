@@ -0,0 +1,405 @@
+//! @file rendererpool.cpp
+//! @brief Implementation of the renderers sharing the rendering of graph instances
+//! @copyright Allegorithmic. All rights reserved.
+
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceFGraph.h"
+#include "SubstanceSettings.h"
+
+#include "framework/rendererpool.h"
+
+
+Substance::RendererPool::RendererPool() :
+	mPlacement(GetDefault<USubstanceSettings>()->bShardRenderingByPackage ?
+		Placement_Package :
+		Placement_Load),
+	mRunUid(0),
+	mHeld(false)
+{
+	init(GetDefault<USubstanceSettings>()->RendererShardCount);
+}
+
+
+Substance::RendererPool::RendererPool(uint32 shardCount, Placement placement) :
+	mPlacement(placement),
+	mRunUid(0),
+	mHeld(false)
+{
+	init(shardCount);
+}
+
+
+Substance::RendererPool::~RendererPool()
+{
+	for (size_t i = 0; i < mShards.size(); ++i)
+	{
+		delete mShards[i];
+	}
+}
+
+
+void Substance::RendererPool::init(uint32 shardCount)
+{
+	shardCount = FMath::Max<uint32>(shardCount, 1);
+
+	const RenderOptions renderOptions(shardCount);
+
+	mShards.reserve(shardCount);
+	for (uint32 i = 0; i < shardCount; ++i)
+	{
+		mShards.push_back(new Renderer(renderOptions));
+	}
+
+	mPushedCount.resize(shardCount, 0);
+}
+
+
+void Substance::RendererPool::push(Substance::FGraphInstance* graph, Renderer::Priority priority)
+{
+	const uint32 shard = getShard(graph);
+
+	mShards[shard]->push(graph, priority);
+	++mPushedCount[shard];
+}
+
+
+void Substance::RendererPool::push(Substance::List<Substance::FGraphInstance*>& graphs, Renderer::Priority priority)
+{
+	Substance::List<Substance::FGraphInstance*>::TIterator
+		ItGraph(graphs.itfront());
+
+	for (;ItGraph;++ItGraph)
+	{
+		push(*ItGraph, priority);
+	}
+}
+
+
+uint32 Substance::RendererPool::run(uint32 runOptions)
+{
+	cleanup();
+
+	const bool bSynchronous = (runOptions & Renderer::Run_Asynchronous) == 0;
+
+	ShardRuns shardRuns;
+
+	// every shard is run, they may have hard resources to update
+	for (uint32 shard = 0; shard < mShards.size(); ++shard)
+	{
+		const uint32 runUid = mShards[shard]->run(runOptions | Renderer::Run_Asynchronous);
+
+		if (runUid != 0)
+		{
+			ShardRun shardRun;
+			shardRun.shard = shard;
+			shardRun.runUid = runUid;
+			shardRun.instancesCount = mPushedCount[shard];
+			shardRuns.push_back(shardRun);
+		}
+
+		mPushedCount[shard] = 0;
+	}
+
+	if (bSynchronous)
+	{
+		for (size_t i = 0; i < shardRuns.size(); ++i)
+		{
+			mShards[shardRuns[i].shard]->flush();
+		}
+
+		// flushing resumed the shards
+		if (mHeld)
+		{
+			hold();
+		}
+	}
+
+	if (shardRuns.empty())
+	{
+		return 0;
+	}
+
+	return addRun(shardRuns);
+}
+
+
+Substance::RenderHandle Substance::RendererPool::runAsync(uint32 runOptions)
+{
+	cleanup();
+
+	// open until every shard added its job
+	RenderHandle handle = RenderHandle::create();
+
+	ShardRuns shardRuns;
+
+	for (uint32 shard = 0; shard < mShards.size(); ++shard)
+	{
+		mShards[shard]->runAsync(runOptions, handle);
+
+		// the pool handle tells when the instances leave the shard load
+		if (mPushedCount[shard] != 0)
+		{
+			ShardRun shardRun;
+			shardRun.shard = shard;
+			shardRun.runUid = 0;
+			shardRun.instancesCount = mPushedCount[shard];
+			shardRun.handle = handle;
+			shardRuns.push_back(shardRun);
+		}
+
+		mPushedCount[shard] = 0;
+	}
+
+	handle.close();
+
+	if (!shardRuns.empty())
+	{
+		addRun(shardRuns);
+	}
+
+	return handle;
+}
+
+
+bool Substance::RendererPool::cancel(uint32 runUid)
+{
+	Runs::const_iterator ite = mRuns.find(runUid);
+
+	if (ite == mRuns.end())
+	{
+		return false;
+	}
+
+	bool bCanceled = false;
+
+	for (size_t i = 0; i < ite->second.size(); ++i)
+	{
+		const ShardRun& shardRun = ite->second[i];
+
+		// 0 would cancel every job of the shard
+		if (shardRun.runUid != 0)
+		{
+			bCanceled = mShards[shardRun.shard]->cancel(shardRun.runUid) || bCanceled;
+		}
+	}
+
+	return bCanceled;
+}
+
+
+void Substance::RendererPool::cancelAll()
+{
+	for (size_t i = 0; i < mShards.size(); ++i)
+	{
+		mShards[i]->cancelAll();
+	}
+}
+
+
+void Substance::RendererPool::clearCache()
+{
+	for (size_t i = 0; i < mShards.size(); ++i)
+	{
+		mShards[i]->clearCache();
+	}
+}
+
+
+bool Substance::RendererPool::trim()
+{
+	bool bTrimmed = true;
+
+	for (size_t i = 0; i < mShards.size(); ++i)
+	{
+		bTrimmed = mShards[i]->trim() && bTrimmed;
+	}
+
+	// shards forgot the graph states, instances can move
+	if (bTrimmed)
+	{
+		mInstanceShards.Empty();
+		mPackageShards.Empty();
+	}
+
+	return bTrimmed;
+}
+
+
+void Substance::RendererPool::flush()
+{
+	for (size_t i = 0; i < mShards.size(); ++i)
+	{
+		mShards[i]->flush();
+	}
+
+	// flushing resumed the shards
+	if (mHeld)
+	{
+		hold();
+	}
+
+	cleanup();
+}
+
+
+bool Substance::RendererPool::isPending(uint32 runUid) const
+{
+	Runs::const_iterator ite = mRuns.find(runUid);
+
+	if (ite == mRuns.end())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < ite->second.size(); ++i)
+	{
+		if (isPending(ite->second[i]))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void Substance::RendererPool::hold()
+{
+	mHeld = true;
+
+	for (size_t i = 0; i < mShards.size(); ++i)
+	{
+		mShards[i]->hold();
+	}
+}
+
+
+void Substance::RendererPool::resume()
+{
+	mHeld = false;
+
+	for (size_t i = 0; i < mShards.size(); ++i)
+	{
+		mShards[i]->resume();
+	}
+}
+
+
+void Substance::RendererPool::setRenderCallbacks(RenderCallbacks* callbacks)
+{
+	for (size_t i = 0; i < mShards.size(); ++i)
+	{
+		mShards[i]->setRenderCallbacks(callbacks);
+	}
+}
+
+
+void Substance::RendererPool::releaseInstance(const Substance::FGraphInstance* graph)
+{
+	mInstanceShards.Remove(graph->InstanceGuid);
+}
+
+
+uint32 Substance::RendererPool::getShard(Substance::FGraphInstance* graph)
+{
+	if (mShards.size() == 1)
+	{
+		return 0;
+	}
+
+	// the graph state of the instance lives in this shard
+	const uint32* instanceShard = mInstanceShards.Find(graph->InstanceGuid);
+	if (instanceShard)
+	{
+		return *instanceShard;
+	}
+
+	uint32 shard = 0;
+
+	const package_t* package = graph->Desc ? graph->Desc->Parent : NULL;
+
+	if (mPlacement == Placement_Package && package)
+	{
+		const uint32* packageShard = mPackageShards.Find(package);
+		shard = packageShard ? *packageShard : getLeastLoadedShard();
+
+		mPackageShards.Add(package, shard);
+	}
+	else
+	{
+		shard = getLeastLoadedShard();
+	}
+
+	mInstanceShards.Add(graph->InstanceGuid, shard);
+
+	return shard;
+}
+
+
+uint32 Substance::RendererPool::getLeastLoadedShard()
+{
+	cleanup();
+
+	std::vector<uint32> loads(mPushedCount);
+
+	for (Runs::const_iterator ite = mRuns.begin(); ite != mRuns.end(); ++ite)
+	{
+		for (size_t i = 0; i < ite->second.size(); ++i)
+		{
+			const ShardRun& shardRun = ite->second[i];
+
+			if (isPending(shardRun))
+			{
+				loads[shardRun.shard] += shardRun.instancesCount;
+			}
+		}
+	}
+
+	uint32 shard = 0;
+
+	for (uint32 i = 1; i < loads.size(); ++i)
+	{
+		if (loads[i] < loads[shard])
+		{
+			shard = i;
+		}
+	}
+
+	return shard;
+}
+
+
+bool Substance::RendererPool::isPending(const ShardRun& shardRun) const
+{
+	return shardRun.runUid != 0 ?
+		mShards[shardRun.shard]->isPending(shardRun.runUid) :
+		!shardRun.handle.isComplete();
+}
+
+
+uint32 Substance::RendererPool::addRun(const ShardRuns& shardRuns)
+{
+	// 0 stands for no run
+	++mRunUid;
+	mRunUid = mRunUid != 0 ? mRunUid : 1;
+
+	mRuns[mRunUid] = shardRuns;
+
+	return mRunUid;
+}
+
+
+void Substance::RendererPool::cleanup()
+{
+	for (Runs::iterator ite = mRuns.begin(); ite != mRuns.end();)
+	{
+		if (isPending(ite->first))
+		{
+			++ite;
+		}
+		else
+		{
+			mRuns.erase(ite++);
+		}
+	}
+}
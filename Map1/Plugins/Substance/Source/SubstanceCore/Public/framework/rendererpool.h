@@ -0,0 +1,170 @@
+//! @file rendererpool.h
+//! @brief Renderers sharing the rendering of graph instances
+//! @copyright Allegorithmic. All rights reserved.
+
+#ifndef _SUBSTANCE_FRAMEWORK_RENDERERPOOL_H
+#define _SUBSTANCE_FRAMEWORK_RENDERERPOOL_H
+
+#include "renderer.h"
+
+#include <map>
+#include <vector>
+
+namespace Substance
+{
+
+//! @brief Spreads graph instances across several renderers, each one with
+//!	its own engine and render thread
+//! The memory budget and cores of the settings are split evenly between
+//! the renderers (shards). An instance always goes to the same shard, which
+//! holds its graph state. Same interface as Renderer: a run UID covers the
+//! jobs the run created on every shard.
+class RendererPool
+{
+public:
+	//! @brief Placement policy of new graph instances
+	enum Placement
+	{
+		Placement_Package,  //!< Shard of the other instances of the package, link data is shared
+		Placement_Load      //!< Least loaded shard
+	};
+
+	//! @brief Constructor from the settings shard count and placement
+	RendererPool();
+
+	//! @brief Constructor
+	//! @param shardCount Number of renderers, at least one
+	//! @param placement Placement policy of new graph instances
+	RendererPool(uint32 shardCount, Placement placement);
+
+	//! @brief Destructor
+	~RendererPool();
+
+	//! @brief Push graph instance current changes to the renderer of its shard
+	void push(FGraphInstance*, Renderer::Priority priority = Renderer::Priority_Visible);
+
+	//! @brief Helper: Push graph instance arrays to render
+	void push(Substance::List<Substance::FGraphInstance*>&, Renderer::Priority priority = Renderer::Priority_Visible);
+
+	//! @brief Launch computation on every shard
+	//! @param runOptions Combination of Renderer::RunOption flags
+	//! @return Return UID of the pool run or 0 if no computation to run.
+	//!
+	//! Shards always run asynchronously, a synchronous run waits for all of
+	//! them afterwards.
+	uint32 run(uint32 runOptions = Renderer::Run_Default);
+
+	//! @brief Launch asynchronous computation on every shard, w/ a handle
+	//! @param runOptions Combination of Renderer::RunOption flags
+	//! @return Return a handle covering the jobs of every shard, complete
+	//!		if no computation to run
+	RenderHandle runAsync(uint32 runOptions = Renderer::Run_Asynchronous);
+
+	//! @brief Cancel a computation
+	//! @param runUid UID of the computation to cancel (returned by run())
+	//! @return Return true if the job is retrieved (pending) on a shard
+	bool cancel(uint32 runUid);
+
+	//! @brief Cancel all active/pending computations
+	void cancelAll();
+
+	//! @brief Clear the substance cache of every shard
+	void clearCache();
+
+	//! @brief Release engine memory of every shard, see Renderer::trim()
+	//! @return Return false if a computation is pushed or pending
+	bool trim();
+
+	//! @brief Flush computation, wait for all render jobs to be complete
+	void flush();
+
+	//! @brief Return if a computation is pending on a shard
+	//! @param runUid UID of the pool run (returned by run())
+	bool isPending(uint32 runUid) const;
+
+	//! @brief Hold rendering
+	//! Kept by the pool: held again after a synchronous run or a flush,
+	//! which resume the shards to wait for them.
+	void hold();
+
+	//! @brief Continue held rendering
+	void resume();
+
+	//! @brief Return if the rendering is held
+	bool isHeld() const { return mHeld; }
+
+	//! @brief Set per-renderer user callbacks of every shard
+	void setRenderCallbacks(RenderCallbacks* callbacks);
+
+	//! @brief Forget the shard of a graph instance about to be deleted
+	void releaseInstance(const FGraphInstance* graph);
+
+	//! @brief Accessor on the number of shards
+	uint32 getShardCount() const { return (uint32)mShards.size(); }
+
+protected:
+	//! @brief Job created by a run on one shard
+	struct ShardRun
+	{
+		uint32 shard;
+		uint32 runUid;             //!< 0 if launched by runAsync()
+		uint32 instancesCount;
+		RenderHandle handle;       //!< Handle of runAsync() runs
+	};
+
+	//! @brief Jobs of one pool run
+	typedef std::vector<ShardRun> ShardRuns;
+
+	//! @brief Pool runs by UID
+	typedef std::map<uint32,ShardRuns> Runs;
+
+	//! @brief Renderers (this instance ownership)
+	std::vector<Renderer*> mShards;
+
+	//! @brief Placement policy of new graph instances
+	const Placement mPlacement;
+
+	//! @brief Shard of each instance pushed, until released or trimmed
+	TMap<substanceGuid_t, uint32> mInstanceShards;
+
+	//! @brief Shard of each package, Placement_Package only
+	TMap<const package_t*, uint32> mPackageShards;
+
+	//! @brief Instances pushed per shard since last run
+	std::vector<uint32> mPushedCount;
+
+	//! @brief Runs not known to be over
+	Runs mRuns;
+
+	//! @brief Last pool run UID
+	uint32 mRunUid;
+
+	//! @brief Rendering held by hold(), until resume()
+	bool mHeld;
+
+	//! @brief Create the shards
+	void init(uint32 shardCount);
+
+	//! @brief Return the shard of an instance, placing it if new
+	uint32 getShard(FGraphInstance* graph);
+
+	//! @brief Return the shard w/ the fewest instances pushed or pending
+	uint32 getLeastLoadedShard();
+
+	//! @brief Return if the job of a run on a shard is pending
+	bool isPending(const ShardRun& shardRun) const;
+
+	//! @brief Record the jobs of a run, return its pool run UID
+	uint32 addRun(const ShardRuns& shardRuns);
+
+	//! @brief Forget the runs whose jobs are over on every shard
+	void cleanup();
+
+private:
+	RendererPool(const RendererPool&);
+	const RendererPool& operator=(const RendererPool&);
+};
+
+} // namespace Substance
+
+#endif // _SUBSTANCE_FRAMEWORK_RENDERERPOOL_H
@@ -0,0 +1,70 @@
+//! @file renderhandle.cpp
+//! @brief Implementation of the handle on an asynchronous computation
+//! @copyright Allegorithmic. All rights reserved.
+
+#include "SubstanceCorePrivatePCH.h"
+
+#include "framework/renderhandle.h"
+#include "framework/details/detailsrenderhandlestate.h"
+
+
+Substance::RenderHandle::RenderHandle()
+{
+}
+
+
+Substance::RenderHandle Substance::RenderHandle::create()
+{
+	RenderHandle handle;
+	handle.mState.reset(new Details::RenderHandleState);
+	return handle;
+}
+
+
+void Substance::RenderHandle::close()
+{
+	if (mState.get())
+	{
+		mState->close();
+	}
+}
+
+
+bool Substance::RenderHandle::isComplete() const
+{
+	return mState.get() ? mState->isComplete() : true;
+}
+
+
+bool Substance::RenderHandle::isCanceled() const
+{
+	return mState.get() ? mState->isCanceled() : false;
+}
+
+
+float Substance::RenderHandle::getProgress() const
+{
+	return mState.get() ? mState->getProgress() : 1.0f;
+}
+
+
+bool Substance::RenderHandle::cancel()
+{
+	return mState.get() ? mState->cancel() : false;
+}
+
+
+void Substance::RenderHandle::then(const Continuation& continuation, ENamedThreads::Type thread)
+{
+	if (mState.get())
+	{
+		mState->then(continuation, thread);
+	}
+	else
+	{
+		// nothing to wait for, same thread as a pending computation
+		RenderHandle handle = create();
+		handle.close();
+		handle.then(continuation, thread);
+	}
+}
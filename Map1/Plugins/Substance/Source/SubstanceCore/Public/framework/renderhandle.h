@@ -0,0 +1,75 @@
+//! @file renderhandle.h
+//! @brief Handle on an asynchronous computation
+//! @copyright Allegorithmic. All rights reserved.
+
+#ifndef _SUBSTANCE_FRAMEWORK_RENDERHANDLE_H
+#define _SUBSTANCE_FRAMEWORK_RENDERHANDLE_H
+
+#include <functional>
+#include <memory>
+
+namespace Substance
+{
+
+namespace Details
+{
+	class RenderHandleState;
+}
+
+//! @brief Handle on an asynchronous computation, returned by runAsync()
+//! Copies share the same computation. The handle follows its render jobs
+//! through Run_Replace/Run_First: the outputs not deprecated by the newer
+//! run are computed again and the handle completes after them.
+class RenderHandle
+{
+public:
+	//! @brief Continuation called once the computation is over
+	//! @param computed False if the computation was canceled
+	typedef std::function<void(bool computed)> Continuation;
+
+	//! @brief Default constructor, invalid handle (complete)
+	RenderHandle();
+
+	//! @brief Create an open handle, runs are added to it until close()
+	//! @note Internal use, runAsync() returns closed handles
+	static RenderHandle create();
+
+	//! @brief Stop adding runs, the handle completes once they are over
+	//! @note Internal use
+	void close();
+
+	//! @brief Return if the handle refers to a computation
+	bool isValid() const { return mState.get()!=NULL; }
+
+	//! @brief Return if the computation is over (computed or canceled)
+	bool isComplete() const;
+
+	//! @brief Return if the computation was canceled
+	bool isCanceled() const;
+
+	//! @brief Return the computed outputs ratio, 1 once complete
+	float getProgress() const;
+
+	//! @brief Cancel the computation
+	//! @return Return true if a render job was pending
+	bool cancel();
+
+	//! @brief Call a continuation once the computation is over
+	//! @param continuation Function to call, w/ false if canceled
+	//! @param thread Task graph thread to call it from, called as soon
+	//!		as possible if the computation is already over
+	void then(
+		const Continuation& continuation,
+		ENamedThreads::Type thread = ENamedThreads::GameThread);
+
+	//! @brief Internal use
+	const std::shared_ptr<Details::RenderHandleState>& getState() const { return mState; }
+
+protected:
+	//! @brief Shared computation state
+	std::shared_ptr<Details::RenderHandleState> mState;
+};
+
+} // namespace Substance
+
+#endif // _SUBSTANCE_FRAMEWORK_RENDERHANDLE_H
@@ -22,14 +22,20 @@ struct RenderOptions
 
 	size_t mCoresCount;
 
+	//! @brief Number of renderers sharing the memory budget and cores
+	size_t mShardCount;
+
 	//! @brief Default constructor
-	RenderOptions()
+	//! @param shardCount The settings budget and cores are split evenly
+	//!		between that many renderers.
+	RenderOptions(size_t shardCount = 1)
 	{
 		int32 BudgetMb = FMath::Clamp(GetDefault<USubstanceSettings>()->MemoryBudgetMb, SBS_MIN_MEM_BUDGET, SBS_MAX_MEM_BUDGET);
 		int32 CPUCores = FMath::Clamp(GetDefault<USubstanceSettings>()->CPUCores, (int32)1, FPlatformMisc::NumberOfCores());
 
-		mMemoryBudget = BudgetMb * 1024 * 1024;
-		mCoresCount = CPUCores;
+		mShardCount = FMath::Max<size_t>(shardCount, 1);
+		mMemoryBudget = (size_t)BudgetMb * 1024 * 1024 / mShardCount;
+		mCoresCount = FMath::Max<size_t>(CPUCores / mShardCount, 1);
 	}
 };
 
@@ -56,6 +56,14 @@ struct RenderResult
 	//! @brief Return if the render result still have ownership on content
 	bool haveOwnership() const { return mHaveOwnership; }
 
+	//! @brief Accessor on the cache key of the pushed inputs
+	//! @return Return the key computed when the output was pushed, empty if
+	//!		the result does not go to the cache
+	const FString& getCacheKey() const { return mCacheKey; }
+
+	//! @brief Internal use
+	void setCacheKey(const FString& cacheKey) { mCacheKey = cacheKey; }
+
 	//! @brief Internal use
 	Details::Engine* getEngine() const { return mEngine; }
 	
@@ -66,6 +74,8 @@ protected:
 
 	Details::Engine* mEngine;
 
+	FString mCacheKey;
+
 private:
 	RenderResult(const RenderResult&);
 	const RenderResult& operator=(const RenderResult&);
@@ -7,6 +7,7 @@
 
 #include "SubstanceCoreTypedefs.h"
 #include "SubstanceCoreHelpers.h"
+#include "SubstancePixelKernels.h"
 #include "SubstanceCoreClasses.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogSubstanceEditorImgInputFactories, Log, All);
@@ -18,22 +19,9 @@ void Split_RGBA_8bpp(
 	uint8* DecompressedImageRGBA, const int32 TextureDataSizeRGBA, 
 	uint8* DecompressedImageA=NULL, const int32 TextureDataSizeA=0)
 {
-	uint8 Pixel[4] = {0,0,0,0};
-
 	if (DecompressedImageA)
 	{
-		uint8* ImagePtrRGBA = DecompressedImageRGBA + 3;
-		uint8* ImagePtrA = DecompressedImageA;
-
-		for(int32 Y = 0; Y < Height; Y++)
-		{
-			for(int32 X = 0;X < Width;X++)
-			{	
-				Pixel[0] = *ImagePtrRGBA;
-				ImagePtrRGBA+=4;
-				*ImagePtrA++ = Pixel[0];
-			}
-		}
+		Substance::Kernels::DeinterleaveAlpha(DecompressedImageRGBA, DecompressedImageA, Width * Height);
 	}
 }
 
@@ -280,31 +268,9 @@ USubstanceImageInput* USubstanceImageInputFactory::FactoryCreateBinaryFromTextur
 	int32 Height = ContextTexture->GetSizeY();
 	int32 DecompressedImageRGBA_Size = BGRA_BufferEnd - BGRA_Buffer;
 
-	bool bTextureHasAlpha = false;
-
-	for (int32 Y = Height - 1 ; Y >= 0 ; --Y)
-	{
-		const uint8* Color = &DecompressedImage_RGBA[Y * Width * 4];
-		for (int32 X = Width ; X > 0; --X)
-		{
-			// Skip color info
-			Color+=3;
-
-			// Get Alpha value then increment the pointer past it for the next pixel
-			uint8 Alpha = *Color++;
-			if (Alpha != 255)
-			{
-				// When a texture is imported with no alpha, the alpha bits are set to 255
-				// So if the texture has non 255 alpha values, the texture is a valid alpha channel
-				bTextureHasAlpha = true;
-				break;
-			}
-		}
-		if (bTextureHasAlpha)
-		{
-			break;
-		}
-	}
+	// When a texture is imported with no alpha, the alpha bits are set to 255
+	// So if the texture has non 255 alpha values, the texture is a valid alpha channel
+	const bool bTextureHasAlpha = !Substance::Kernels::IsOpaque(DecompressedImage_RGBA, Width * Height);
 
 	uint8* DecompressedImageRGB = NULL;
 	int32 SizeDecompressedImageRGB = Width * Height * 3;